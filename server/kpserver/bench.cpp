@@ -0,0 +1,652 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "net_packet.h"
+#include "net_schema.h"
+#include "net_session.h"
+#include "net_client.h"
+#include "lz.h"
+#include "movement_validator.h"
+#include "transform_codec.h"
+#include "spatial_grid.h"
+#include "trace.h"
+
+// keeps the compiler from removing the benchmarked work
+static volatile uint64_t bench_sink = 0;
+
+Bench_timer::Bench_timer(const char* name, uint64_t iterations, uint64_t bytes) : _name(name), _iterations(iterations), _bytes(bytes) {
+    _start = std::chrono::high_resolution_clock::now();
+}
+
+Bench_timer::~Bench_timer() {
+    auto end = std::chrono::high_resolution_clock::now();
+    double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - _start).count();
+
+    if (_bytes == 0) {
+        TRACE("   | %-40s %8.2f ns\n", _name, ns / (double)_iterations);
+        return;
+    }
+
+    // bytes per ns is GB/s
+    TRACE("   | %-40s %8.2f ns %8.1f MB/s\n", _name, ns / (double)_iterations, (double)(_bytes * _iterations) / ns * 1000.0);
+}
+
+/// <summary>
+/// The schema codecs against the memcpy of the packed structs they replace
+/// </summary>
+void bench_wire_schema() {
+    TRACE("--- Wire schema (%d iterations)\n", BENCH_ITERATIONS);
+
+    std::vector<uint8_t> data(4096);
+    uint64_t sum = 0;
+
+    Net_datagram_header header;
+    header.ack_bits = 0xffff0000;
+    header.timestamp = 1234;
+
+    Net_slave_health_snapshot health(0.5f, 0.1f, 12, 0.0f, 40);
+
+    // spread the writes over the buffer so the stores arent folded into one
+    const uint32_t mask = 4096 / 32 - 1;
+
+    {
+        Bench_timer timer("encode datagram header memcpy", BENCH_ITERATIONS);
+
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            header.sequence = (uint16_t)i;
+            memcpy(&data[(i & mask) * 32], &header, sizeof(Net_datagram_header));
+        }
+    }
+
+    {
+        Bench_timer timer("encode datagram header schema", BENCH_ITERATIONS);
+
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            header.sequence = (uint16_t)i;
+            wire_encode(header, &data[(i & mask) * 32]);
+        }
+    }
+
+    {
+        Bench_timer timer("encode health snapshot memcpy", BENCH_ITERATIONS);
+
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            health.num_connected_players = (uint16_t)i;
+            memcpy(&data[(i & mask) * 32], &health, sizeof(Net_slave_health_snapshot));
+        }
+    }
+
+    {
+        Bench_timer timer("encode health snapshot schema", BENCH_ITERATIONS);
+
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            health.num_connected_players = (uint16_t)i;
+            wire_encode(health, &data[(i & mask) * 32]);
+        }
+    }
+
+    {
+        Bench_timer timer("decode datagram header memcpy", BENCH_ITERATIONS);
+
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            Net_datagram_header h;
+            memcpy(&h, &data[(i & mask) * 32], sizeof(Net_datagram_header));
+            sum += h.sequence + h.ack_bits;
+        }
+    }
+
+    {
+        Bench_timer timer("decode datagram header schema", BENCH_ITERATIONS);
+
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            Packet_reader reader(&data[(i & mask) * 32], 32);
+            Net_datagram_header h;
+
+            wire_decode(reader, h);
+            sum += h.sequence + h.ack_bits;
+        }
+    }
+
+    {
+        Bench_timer timer("view datagram header schema", BENCH_ITERATIONS);
+
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            Packet_reader reader(&data[(i & mask) * 32], 32);
+            Net_datagram_header storage;
+
+            const Net_datagram_header* h = wire_view(reader, storage);
+            sum += h->sequence + h->ack_bits;
+        }
+    }
+
+    {
+        Bench_timer timer("decode health snapshot memcpy", BENCH_ITERATIONS);
+
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            Net_slave_health_snapshot h;
+            memcpy(&h, &data[(i & mask) * 32], sizeof(Net_slave_health_snapshot));
+            sum += h.num_connected_players + h.avg_tick_idle_time;
+        }
+    }
+
+    {
+        Bench_timer timer("decode health snapshot schema", BENCH_ITERATIONS);
+
+        for (uint32_t i = 0; i < BENCH_ITERATIONS; ++i) {
+            Packet_reader reader(&data[(i & mask) * 32], 32);
+            Net_slave_health_snapshot h = health;
+
+            wire_decode(reader, h);
+            sum += h.num_connected_players + h.avg_tick_idle_time;
+        }
+    }
+
+    bench_sink = bench_sink + sum + data[7];
+}
+
+template<typename T>
+static void bench_add_message(std::vector<uint8_t>& data, const T& msg) {
+    wire_encode(msg, data, (uint32_t)data.size(), NET_PROTOCOL_VERSION);
+}
+
+// what a player gets from the master and the slave between connecting and being in a session
+static void bench_lobby_mix(std::vector<uint8_t>& data) {
+    bench_add_message(data, Net_success(NetSuccessType::Authentication));
+
+    char ip[64] = "10.20.0.17";
+    bench_add_message(data, Net_player_slave_node_response(3, ip, 27015, 27016));
+
+    Net_player_slave_list_sessions_response list;
+    char name[32];
+
+    for (uint32_t i = 0; i < 40; ++i) {
+        memset(name, 0, 32);
+        snprintf(name, 32, "Public game %d", i);
+        list.sessions.push_back(Net_slave_session_item(1000 + i * 7, name, (uint8_t)(i % 8), 8));
+    }
+
+    list.num_sessions = (uint8_t)list.sessions.size();
+    wire_encode(list, data, (uint32_t)data.size(), NET_PROTOCOL_VERSION);
+}
+
+// the roster and config sent when a player joins a session
+static void bench_roster_mix(std::vector<uint8_t>& data) {
+    char username[64];
+
+    for (uint32_t i = 0; i < 16; ++i) {
+        memset(username, 0, 64);
+        snprintf(username, 64, "player_%d", 100 + i);
+
+        Net_player_has_joined_session joined((uint8_t)i, 4711, username);
+        joined.avatar[0] = (uint16_t)(i % 3);
+        joined.avatar[1] = 12;
+        joined.avatar[2] = (uint16_t)(i % 5);
+
+        bench_add_message(data, joined);
+    }
+
+    Net_game_config config;
+    config.rules.resize(4 * (int)GameRule::MaxRules);
+    config.rules[GameRule::PlayerMovementSpeed] = 1000;
+    config.rules[GameRule::GameSeconds] = 60;
+    config.num_rules = (uint16_t)config.rules.size();
+
+    wire_encode(config, data, (uint32_t)data.size(), NET_PROTOCOL_VERSION);
+}
+
+// a scene of 1024 items, a few kinds of items in a few states
+static void bench_world_init_mix(std::vector<uint8_t>& data) {
+    Net_session_world_init init;
+
+    for (uint32_t i = 0; i < 1024; ++i) {
+        Net_session_world_init_item item;
+        item.id = (uint16_t)i;
+        item.types = (uint8_t)(1 << (i % 3));
+        item.states = (uint8_t)((i % 11) == 0 ? 1 : 0);
+
+        init.items.push_back(item);
+    }
+
+    init.num_items = (uint16_t)init.items.size();
+
+    data.clear();
+    wire_encode(init, data, 0, NET_PROTOCOL_VERSION);
+}
+
+// the frame a client with compression gets when the parts are queued in one tick
+static uint64_t bench_tcp_frame(const char* name, const std::vector<uint8_t>** parts, uint32_t num_parts, uint32_t iterations) {
+    Net_client client(Net_client_info(), 0);
+    client.enable_tcp_compression(NET_COMPRESSION_LZ);
+    client.clear_tcp_data();
+
+    uint32_t raw_len = 0;
+
+    for (uint32_t i = 0; i < num_parts; ++i) {
+        client.add_tcp_data((void*)&(*parts[i])[0], (uint32_t)parts[i]->size());
+        raw_len += (uint32_t)parts[i]->size();
+    }
+
+    uint32_t len = 0;
+    client.get_tcp_frame(len);
+
+    TRACE("   | %-10s %6d -> %6d bytes on the wire\n", name, raw_len, len);
+
+    char timer_name[64];
+    snprintf(timer_name, 64, "frame %s", name);
+
+    uint64_t sum = 0;
+
+    Bench_timer timer(timer_name, iterations, raw_len);
+
+    for (uint32_t i = 0; i < iterations; ++i) {
+        sum += client.get_tcp_frame(len)[i % len];
+    }
+
+    return sum;
+}
+
+/// <summary>
+/// Compression ratio and speed of the TCP frame compression on the lobby and join traffic,
+/// then the frames of a player joining over TCP, the roster and the world init in one tick
+/// </summary>
+void bench_lz() {
+    const uint32_t iterations = 100000;
+
+    TRACE("--- LZ compression (%d iterations)\n", iterations);
+
+    const char* names[] = { "lobby", "roster", "world init" };
+    std::vector<uint8_t> mixes[3];
+
+    bench_lobby_mix(mixes[0]);
+    bench_roster_mix(mixes[1]);
+    bench_world_init_mix(mixes[2]);
+
+    uint64_t sum = 0;
+    char name[64];
+
+    for (uint32_t m = 0; m < 3; ++m) {
+        std::vector<uint8_t>& raw = mixes[m];
+        uint32_t raw_len = (uint32_t)raw.size();
+
+        std::vector<uint8_t> compressed(lz_compress_bound(raw_len));
+        std::vector<uint8_t> decompressed(raw_len);
+
+        uint32_t len = lz_compress(&raw[0], raw_len, &compressed[0]);
+
+        if (!lz_decompress(&compressed[0], len, &decompressed[0], raw_len) || memcmp(&raw[0], &decompressed[0], raw_len) != 0) {
+            TRACE("   | %s does not round trip\n", names[m]);
+            continue;
+        }
+
+        TRACE("   | %-10s %6d -> %6d bytes, ratio %.2f\n", names[m], raw_len, len, (float)raw_len / (float)len);
+
+        {
+            snprintf(name, 64, "compress %s", names[m]);
+            Bench_timer timer(name, iterations, raw_len);
+
+            for (uint32_t i = 0; i < iterations; ++i) {
+                raw[0] = (uint8_t)i;
+                sum += lz_compress(&raw[0], raw_len, &compressed[0]);
+            }
+        }
+
+        {
+            snprintf(name, 64, "decompress %s", names[m]);
+            Bench_timer timer(name, iterations, raw_len);
+
+            for (uint32_t i = 0; i < iterations; ++i) {
+                sum += lz_decompress(&compressed[0], len, &decompressed[0], raw_len) ? decompressed[i % raw_len] : 0;
+            }
+        }
+    }
+
+    // the loops above wrote over the message types
+    std::vector<uint8_t> roster;
+    std::vector<uint8_t> world_init;
+
+    bench_roster_mix(roster);
+    bench_world_init_mix(world_init);
+
+    std::vector<uint8_t> join = roster;
+    join.insert(join.end(), world_init.begin(), world_init.end());
+
+    uint32_t join_len = (uint32_t)join.size();
+
+    {
+        std::vector<uint8_t> compressed(lz_compress_bound(join_len));
+        uint32_t len = lz_compress(&join[0], join_len, &compressed[0]);
+
+        TRACE("   | %-10s %6d -> %6d bytes, everything compressed\n", "join", join_len, len);
+
+        Bench_timer timer("compress join, everything", iterations, join_len);
+
+        for (uint32_t i = 0; i < iterations; ++i) {
+            join[0] = (uint8_t)i;
+            sum += lz_compress(&join[0], join_len, &compressed[0]);
+        }
+    }
+
+    // the world init is sent as it is, only the roster is compressed
+    const std::vector<uint8_t>* join_parts[] = { &roster, &world_init };
+    sum += bench_tcp_frame("join", join_parts, 2, iterations);
+
+    std::vector<uint8_t> lobby;
+    bench_lobby_mix(lobby);
+
+    const std::vector<uint8_t>* lobby_parts[] = { &lobby };
+    sum += bench_tcp_frame("lobby", lobby_parts, 1, iterations);
+
+    bench_sink = bench_sink + sum;
+}
+
+/// <summary>
+/// The movement check of a tick, every player sent a position and one in eight moved too far
+/// </summary>
+void bench_movement() {
+    const uint32_t ticks = 100000;
+    const uint32_t sizes[] = { 16, 64, 250 };
+
+    TRACE("--- Movement validation (%d ticks)\n", ticks);
+
+    uint64_t sum = 0;
+    char name[64];
+
+    for (uint32_t size : sizes) {
+        Movement_validator validator;
+        validator.reset(size);
+
+        {
+            snprintf(name, 64, "validate %d players, per player", size);
+            Bench_timer timer(name, (uint64_t)ticks * size);
+
+            for (uint32_t tick = 0; tick < ticks; ++tick) {
+                uint32_t timestamp = tick * 33;
+
+                for (uint32_t i = 0; i < size; ++i) {
+                    float step = (i + tick) % 8 == 0 ? 0.5f : 0.02f;
+
+                    validator.push((uint8_t)i, glm::vec3(tick * step, 0.0f, (float)i), timestamp);
+                }
+
+                validator.validate(1.0f);
+                validator.clear();
+            }
+        }
+
+        sum += validator.counters.clamped + validator.counters.rejected;
+    }
+
+    bench_sink = bench_sink + sum;
+}
+
+/// <summary>
+/// Smallest three quaternion compression, one at a time against the batch functions
+/// the batch output has to be bit exact with the scalar output, false if it isnt
+/// </summary>
+bool bench_quat() {
+    const uint32_t sizes[] = { 1000, 10000, 100000 };
+    const uint32_t bits = 9;
+
+    TRACE("--- Quaternion compression (%d bits)\n", bits);
+
+    uint64_t sum = 0;
+    char name[64];
+
+    for (uint32_t size : sizes) {
+        std::vector<glm::quat> rotations(size);
+        std::vector<glm::quat> decoded(size);
+        std::vector<uint8_t> index(size);
+        std::vector<uint16_t> data(size * 3);
+
+        for (uint32_t i = 0; i < size; ++i) {
+            rotations[i] = glm::angleAxis(i * 0.01f, glm::normalize(glm::vec3(1.0f, (float)(i % 7), (float)(i % 3) - 1.0f)));
+        }
+
+        // the scalar and the batch output are compared word for word before anything is timed
+        std::vector<uint8_t> batch_index(size);
+        std::vector<uint16_t> batch_data(size * 3);
+        std::vector<glm::quat> batch_decoded(size);
+
+        quat_compress_batch(&rotations[0], size, bits, &batch_index[0], &batch_data[0]);
+        quat_decompress_batch(&batch_index[0], &batch_data[0], size, bits, &batch_decoded[0]);
+
+        for (uint32_t i = 0; i < size; ++i) {
+            quat_compress(rotations[i], bits, index[i], &data[i * 3]);
+            decoded[i] = quat_decompress(index[i], &data[i * 3], bits);
+
+            if (index[i] != batch_index[i] || memcmp(&data[i * 3], &batch_data[i * 3], 3 * sizeof(uint16_t)) != 0) {
+                TRACE("   | ERROR: compress batch %d does not match the scalar output at rotation %d\n", size, i);
+                return false;
+            }
+
+            if (memcmp(&decoded[i], &batch_decoded[i], sizeof(glm::quat)) != 0) {
+                TRACE("   | ERROR: decompress batch %d does not match the scalar output at rotation %d\n", size, i);
+                return false;
+            }
+        }
+
+        TRACE("   | batch %d is bit exact with the scalar functions\n", size);
+
+        uint32_t iterations = 10000000 / size;
+
+        {
+            snprintf(name, 64, "compress %d, per rotation", size);
+            Bench_timer timer(name, (uint64_t)iterations * size);
+
+            for (uint32_t it = 0; it < iterations; ++it) {
+                for (uint32_t i = 0; i < size; ++i) {
+                    quat_compress(rotations[i], bits, index[i], &data[i * 3]);
+                }
+
+                sum += data[it % size];
+            }
+        }
+
+        {
+            snprintf(name, 64, "compress batch %d, per rotation", size);
+            Bench_timer timer(name, (uint64_t)iterations * size);
+
+            for (uint32_t it = 0; it < iterations; ++it) {
+                quat_compress_batch(&rotations[0], size, bits, &index[0], &data[0]);
+                sum += data[it % size];
+            }
+        }
+
+        {
+            snprintf(name, 64, "decompress %d, per rotation", size);
+            Bench_timer timer(name, (uint64_t)iterations * size);
+
+            for (uint32_t it = 0; it < iterations; ++it) {
+                for (uint32_t i = 0; i < size; ++i) {
+                    decoded[i] = quat_decompress(index[i], &data[i * 3], bits);
+                }
+
+                sum += (uint64_t)(decoded[it % size].w * 1000.0f);
+            }
+        }
+
+        {
+            snprintf(name, 64, "decompress batch %d, per rotation", size);
+            Bench_timer timer(name, (uint64_t)iterations * size);
+
+            for (uint32_t it = 0; it < iterations; ++it) {
+                quat_decompress_batch(&index[0], &data[0], size, bits, &decoded[0]);
+                sum += (uint64_t)(decoded[it % size].w * 1000.0f);
+            }
+        }
+    }
+
+    bench_sink = bench_sink + sum;
+
+    return true;
+}
+
+/// <summary>
+/// The spatial grid, players moving about a 200 m level with 4096 items in it
+/// </summary>
+void bench_spatial() {
+    const uint32_t ticks = 10000;
+    const uint32_t num_items = 4096;
+    const uint32_t sizes[] = { 16, 64, 250 };
+
+    TRACE("--- Spatial grid (%d items)\n", num_items);
+
+    uint64_t sum = 0;
+    char name[64];
+
+    Spatial_grid items;
+    items.reset(num_items);
+
+    for (uint32_t i = 0; i < num_items; ++i) {
+        items.update((uint16_t)i, glm::vec3((float)(i % 64) * 3.1f - 100.0f, (float)(i % 3) * 4.0f, (float)(i / 64) * 3.1f - 100.0f));
+    }
+
+    std::vector<uint16_t> found;
+
+    for (uint32_t size : sizes) {
+        Spatial_grid players;
+        players.reset(size);
+
+        std::vector<glm::vec3> pos(size);
+        std::vector<uint16_t> nearest(size * 4);
+
+        {
+            snprintf(name, 64, "update %d players, per player", size);
+            Bench_timer timer(name, (uint64_t)ticks * size);
+
+            for (uint32_t tick = 0; tick < ticks; ++tick) {
+                for (uint32_t i = 0; i < size; ++i) {
+                    pos[i] = glm::vec3((float)((i * 37 + tick / 4) % 200) - 100.0f, 0.0f, (float)((i * 91) % 200) - 100.0f);
+                    players.update((uint16_t)i, pos[i]);
+                }
+            }
+        }
+
+        {
+            snprintf(name, 64, "items within 4 m of %d players, per player", size);
+            Bench_timer timer(name, (uint64_t)ticks * size);
+
+            for (uint32_t tick = 0; tick < ticks; ++tick) {
+                for (uint32_t i = 0; i < size; ++i) {
+                    found.clear();
+                    items.query_radius(pos[i], 4.0f, found);
+                    sum += found.size();
+                }
+            }
+        }
+
+        {
+            snprintf(name, 64, "4 nearest items of %d players, per player", size);
+            Bench_timer timer(name, (uint64_t)ticks * size);
+
+            for (uint32_t tick = 0; tick < ticks; ++tick) {
+                items.nearest(&pos[0], size, 4, 8.0f, &nearest[0]);
+                sum += nearest[tick % nearest.size()];
+            }
+        }
+    }
+
+    bench_sink = bench_sink + sum;
+}
+
+/// <summary>
+/// The range checked item state requests, a player next to the item, one too far away
+/// and one without a position, then 250 players asking for the same item
+/// </summary>
+bool bench_interaction() {
+    const uint32_t iterations = 1000000;
+    const uint32_t num_players = 250;
+
+    TRACE("--- Item interactions (range %.1f m)\n", ITEM_INTERACT_RANGE);
+
+    auto level = std::make_shared<Level>();
+
+    Level_item switch_item = Level_item::from_prefab(ItemPrefab::PulleySwitch, 1);
+    switch_item.pos[0] = 10.0f;
+
+    level->add_item(switch_item);
+    level->build();
+
+    World_instance world;
+    world.set_level(level);
+
+    for (uint32_t i = 0; i < num_players; ++i) {
+        world.add_player((uint16_t)(i + 1));
+    }
+
+    world.start();
+
+    // player 0 is 1 m from the switch, player 1 is 20 m away, player 2 has no position yet
+    world.player_grid.update(0, glm::vec3(11.0f, 0.0f, 0.0f));
+    world.player_grid.update(1, glm::vec3(-10.0f, 0.0f, 0.0f));
+
+    Net_player_set_item_state_request request;
+    request.id = 1;
+    request.state = 2; // Activated
+    request.on = 1;
+
+    Net_player_set_item_state_response resp;
+
+    const uint8_t expected[3] = { 1, 0, 0 };
+
+    for (uint8_t player = 0; player < 3; ++player) {
+        world.set_item_state(player, request, resp);
+
+        if (resp.success != expected[player] || resp.id != request.id) {
+            TRACE("ERROR: item state request of player %d, success %d, expected %d\n", player, resp.success, expected[player]);
+            return false;
+        }
+    }
+
+    if (world.interactions_rejected != 2) {
+        TRACE("ERROR: %llu interactions rejected, expected 2\n", (unsigned long long)world.interactions_rejected);
+        return false;
+    }
+
+    for (uint32_t i = 3; i < num_players; ++i) {
+        world.player_grid.update((uint8_t)i, glm::vec3((float)(i % 20), 0.0f, 0.0f));
+    }
+
+    uint64_t sum = 0;
+
+    {
+        Bench_timer timer("set_item_state, per request", iterations);
+
+        for (uint32_t i = 0; i < iterations; ++i) {
+            request.on = (uint8_t)(i & 1);
+            world.set_item_state((uint8_t)(i % num_players), request, resp);
+            sum += resp.success;
+        }
+    }
+
+    TRACE("   | %-40s %8.1f %%\n", "accepted", (double)sum * 100.0 / (double)iterations);
+
+    bench_sink = bench_sink + sum;
+
+    return true;
+}
+
+int run_benchmarks() {
+    TRACE("KPSERVER benchmarks\n");
+
+    bench_wire_schema();
+    bench_lz();
+    bench_movement();
+
+    if (!bench_quat()) {
+        TRACE("ERROR: the batch quaternion functions are not bit exact with the scalar ones\n");
+        return 1;
+    }
+
+    bench_spatial();
+
+    if (!bench_interaction()) {
+        TRACE("ERROR: the item state requests arent range checked\n");
+        return 1;
+    }
+
+    return 0;
+}
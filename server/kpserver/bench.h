@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+
+#define BENCH_ITERATIONS 10000000
+
+/// <summary>
+/// Measures a block of work, prints the time per iteration when it goes out of scope
+/// and the throughput when the bytes each iteration handles are given
+/// </summary>
+struct Bench_timer {
+    Bench_timer(const char* name, uint64_t iterations, uint64_t bytes = 0);
+    ~Bench_timer();
+
+private:
+    const char*     _name;
+    uint64_t        _iterations;
+    uint64_t        _bytes;
+
+    std::chrono::time_point<std::chrono::high_resolution_clock> _start;
+};
+
+/// <summary>
+/// Micro benchmarks of the hot paths, run with ./kpserver -bench
+/// </summary>
+void bench_wire_schema();
+void bench_lz();
+void bench_movement();
+bool bench_quat(); // false if the batch and the scalar output differ
+void bench_spatial();
+bool bench_interaction(); // false if an item state request out of range is accepted
+
+int run_benchmarks();
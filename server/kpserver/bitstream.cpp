@@ -0,0 +1,123 @@
+#include "bitstream.h"
+
+Bit_writer::Bit_writer(std::vector<uint8_t>& data, uint32_t offset)
+    :   _data(data),
+        _offset(offset),
+        _pos(offset),
+        _scratch(0),
+        _scratch_bits(0),
+        _bits_written(0) {
+
+}
+
+void Bit_writer::write_bits(uint32_t value, uint32_t bits) {
+    if (bits < 32) {
+        value &= (1u << bits) - 1;
+    }
+
+    _scratch |= (uint64_t)value << _scratch_bits;
+    _scratch_bits += bits;
+    _bits_written += bits;
+
+    if (_scratch_bits >= 32) {
+        if (_data.size() < _pos + 4) {
+            _data.resize(_pos + 64);
+        }
+
+        _data[_pos] = (uint8_t)(_scratch);
+        _data[_pos + 1] = (uint8_t)(_scratch >> 8);
+        _data[_pos + 2] = (uint8_t)(_scratch >> 16);
+        _data[_pos + 3] = (uint8_t)(_scratch >> 24);
+
+        _pos += 4;
+        _scratch >>= 32;
+        _scratch_bits -= 32;
+    }
+}
+
+void Bit_writer::write_bool(bool value) {
+    write_bits(value ? 1 : 0, 1);
+}
+
+uint32_t Bit_writer::flush() {
+    while (_scratch_bits > 0) {
+        if (_data.size() < _pos + 1) {
+            _data.resize(_pos + 64);
+        }
+
+        _data[_pos++] = (uint8_t)_scratch;
+        _scratch >>= 8;
+        _scratch_bits = _scratch_bits > 8 ? _scratch_bits - 8 : 0;
+    }
+
+    _scratch = 0;
+
+    return _pos - _offset;
+}
+
+uint32_t Bit_writer::bits_written() const {
+    return _bits_written;
+}
+
+Bit_reader::Bit_reader(const uint8_t* data, uint32_t len)
+    :   _data(data),
+        _len(len),
+        _pos(0),
+        _scratch(0),
+        _scratch_bits(0),
+        _bits_read(0),
+        _overflowed(false) {
+
+}
+
+bool Bit_reader::read_bits(uint32_t bits, uint32_t& value) {
+    if (_overflowed || _bits_read + bits > _len * 8) {
+        _overflowed = true;
+        value = 0;
+        return false;
+    }
+
+    // refill a byte at a time, never reads past _len
+    while (_scratch_bits < bits) {
+        _scratch |= (uint64_t)_data[_pos++] << _scratch_bits;
+        _scratch_bits += 8;
+    }
+
+    value = (uint32_t)(bits < 32 ? (_scratch & ((1ull << bits) - 1)) : _scratch);
+
+    _scratch >>= bits;
+    _scratch_bits -= bits;
+    _bits_read += bits;
+
+    return true;
+}
+
+bool Bit_reader::read_bool(bool& value) {
+    uint32_t v = 0;
+
+    if (!read_bits(1, v)) {
+        return false;
+    }
+
+    value = v == 1;
+
+    return true;
+}
+
+uint32_t Bit_reader::bytes_read() const {
+    return (_bits_read + 7) / 8;
+}
+
+bool Bit_reader::overflowed() const {
+    return _overflowed;
+}
+
+uint32_t bits_required(uint32_t max_value) {
+    uint32_t bits = 0;
+
+    while (bits < 32 && (max_value >> bits) != 0) {
+        bits++;
+    }
+
+    return bits == 0 ? 1 : bits;
+}
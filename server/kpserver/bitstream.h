@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+/// <summary>
+/// Writes values with an arbitrary number of bits into a byte buffer
+/// Bits are packed LSB first, a 64 bit scratch word is flushed to the
+/// buffer 32 bits at a time. The buffer grows if needed
+/// </summary>
+struct Bit_writer {
+    Bit_writer(std::vector<uint8_t>& data, uint32_t offset);
+
+    // bits must be 1-32
+    void write_bits(uint32_t value, uint32_t bits);
+
+    void write_bool(bool value);
+
+    // writes out what is left in the scratch word, returns the number of bytes written since offset
+    uint32_t flush();
+
+    uint32_t bits_written() const;
+
+private:
+    std::vector<uint8_t>&   _data;
+
+    uint32_t                _offset;
+    uint32_t                _pos;
+    uint64_t                _scratch;
+    uint32_t                _scratch_bits;
+    uint32_t                _bits_written;
+};
+
+/// <summary>
+/// Reads bit packed values written by Bit_writer
+/// All reads are bounds checked, reading past the buffer sets overflowed
+/// and returns false, we never touch memory outside [data, data + len)
+/// </summary>
+struct Bit_reader {
+    Bit_reader(const uint8_t* data, uint32_t len);
+
+    bool read_bits(uint32_t bits, uint32_t& value);
+
+    bool read_bool(bool& value);
+
+    // bytes consumed, rounded up to a whole byte
+    uint32_t bytes_read() const;
+
+    bool overflowed() const;
+
+private:
+    const uint8_t*  _data;
+
+    uint32_t        _len;
+    uint32_t        _pos;
+    uint64_t        _scratch;
+    uint32_t        _scratch_bits;
+    uint32_t        _bits_read;
+    bool            _overflowed;
+};
+
+// number of bits needed to store values in [0, max_value]
+uint32_t bits_required(uint32_t max_value);
@@ -0,0 +1,398 @@
+#include "circuit.h"
+
+#include <algorithm>
+
+#include "trace.h"
+
+#define CIRCUIT_BIT(state) (1u << (uint8_t)(state))
+
+Circuit_graph::Circuit_graph() :
+    num_items(0),
+    num_levels(0),
+    num_loop_items(0),
+    types(nullptr),
+    gates(nullptr),
+    levels(nullptr),
+    out_start(nullptr),
+    out(nullptr),
+    in_start(nullptr),
+    in(nullptr),
+    loop_items(nullptr) {
+
+}
+
+void Circuit_builder::begin(uint32_t num_items) {
+    types.assign(num_items, 0);
+    states.assign(num_items, 0);
+    gates.assign(num_items, (uint8_t)CircuitGate::None);
+    levels.assign(num_items, 0);
+
+    out_start.clear();
+    out.clear();
+    in_start.clear();
+    in.clear();
+    loop_items.clear();
+    _edges.clear();
+}
+
+void Circuit_builder::add_item(uint16_t index, uint8_t item_types, uint8_t item_states) {
+    if (index >= states.size()) {
+        return;
+    }
+
+    types[index] = item_types;
+    states[index] = item_states;
+}
+
+void Circuit_builder::add_edge(uint16_t from, uint16_t to) {
+    if (from >= states.size() || to >= states.size() || from == to) {
+        return;
+    }
+
+    _edges.push_back(((uint32_t)from << 16) | to);
+}
+
+void Circuit_builder::build(Circuit_graph& graph) {
+    uint32_t num_items = (uint32_t)states.size();
+
+    std::sort(_edges.begin(), _edges.end());
+    _edges.erase(std::unique(_edges.begin(), _edges.end()), _edges.end());
+
+    // counting sort of the edges into the outgoing and incoming lists
+    out_start.assign(num_items + 1, 0);
+    in_start.assign(num_items + 1, 0);
+
+    for (uint32_t edge : _edges) {
+        out_start[(edge >> 16) + 1]++;
+        in_start[(edge & 0xffff) + 1]++;
+    }
+
+    for (uint32_t i = 0; i < num_items; ++i) {
+        out_start[i + 1] += out_start[i];
+        in_start[i + 1] += in_start[i];
+    }
+
+    out.resize(_edges.size());
+    in.resize(_edges.size());
+
+    std::vector<uint32_t> out_pos(out_start.begin(), out_start.end() - 1);
+    std::vector<uint32_t> in_pos(in_start.begin(), in_start.end() - 1);
+
+    for (uint32_t edge : _edges) {
+        uint16_t from = (uint16_t)(edge >> 16);
+        uint16_t to = (uint16_t)(edge & 0xffff);
+
+        out[out_pos[from]++] = to;
+        in[in_pos[to]++] = from;
+    }
+
+    // the OR flag is bit 8 and doesnt fit in the states, so every gate that isnt AND is OR
+    for (uint32_t i = 0; i < num_items; ++i) {
+        if (in_start[i + 1] == in_start[i]) {
+            gates[i] = (uint8_t)CircuitGate::None;
+        }
+        else {
+            gates[i] = (uint8_t)((states[i] & CIRCUIT_BIT(ItemState::Switch_AND)) ? CircuitGate::And : CircuitGate::Or);
+        }
+    }
+
+    // topological levels, Kahn's algorithm
+    std::vector<uint32_t> waiting(num_items);
+    std::vector<uint16_t> ready;
+
+    for (uint32_t i = 0; i < num_items; ++i) {
+        waiting[i] = in_start[i + 1] - in_start[i];
+        levels[i] = 0;
+
+        if (waiting[i] == 0) {
+            ready.push_back((uint16_t)i);
+        }
+    }
+
+    uint32_t num_levels = num_items > 0 ? 1 : 0;
+
+    for (uint32_t r = 0; r < ready.size(); ++r) {
+        uint16_t item = ready[r];
+
+        for (uint32_t e = out_start[item]; e < out_start[item + 1]; ++e) {
+            uint16_t to = out[e];
+
+            levels[to] = std::max<uint16_t>(levels[to], levels[item] + 1);
+
+            if (--waiting[to] == 0) {
+                ready.push_back(to);
+                num_levels = std::max<uint32_t>(num_levels, levels[to] + 1u);
+            }
+        }
+    }
+
+    // the items in a loop, and everything they feed, never got ready, they share the last level
+    // nothing at a lower level is fed by them so the queue never goes back a level
+    if (ready.size() < num_items) {
+        for (uint32_t i = 0; i < num_items; ++i) {
+            if (waiting[i] != 0) {
+                levels[i] = (uint16_t)num_levels;
+                loop_items.push_back((uint16_t)i);
+            }
+        }
+
+        num_levels++;
+    }
+
+    graph.num_items = num_items;
+    graph.num_levels = num_levels;
+    graph.num_loop_items = (uint32_t)loop_items.size();
+    graph.types = types.data();
+    graph.gates = gates.data();
+    graph.levels = levels.data();
+    graph.out_start = out_start.data();
+    graph.out = out.data();
+    graph.in_start = in_start.data();
+    graph.in = in.data();
+    graph.loop_items = loop_items.data();
+}
+
+Circuit::Circuit() : _graph(nullptr), _lowest_queued(0) {
+
+}
+
+void Circuit::reset(const Circuit_graph* graph, const uint8_t* states) {
+    uint32_t num_items = graph->num_items;
+
+    _graph = graph;
+    _states.assign(states, states + num_items);
+    _signal.resize(num_items);
+
+    for (uint32_t i = 0; i < num_items; ++i) {
+        _signal[i] = emits_signal((uint16_t)i);
+    }
+
+    _head.assign(graph->num_levels, CIRCUIT_NO_ITEM);
+    _next.resize(num_items);
+    _queued.assign(num_items, 0);
+    _lowest_queued = graph->num_levels;
+
+    _changes.clear();
+    _changed.assign(num_items, 0);
+
+    _loop_states.resize(graph->num_loop_items);
+    _loop_changed.resize(graph->num_loop_items);
+}
+
+void Circuit::settle() {
+    for (uint32_t i = 0; i < _states.size(); ++i) {
+        queue((uint16_t)i);
+    }
+
+    propagate();
+    clear_changes();
+}
+
+bool Circuit::set_state(uint16_t index, uint8_t state, uint8_t on) {
+    if (index >= _states.size() || state > 7) {
+        return false;
+    }
+
+    uint8_t states = on ? (uint8_t)(_states[index] | (1u << state)) : (uint8_t)(_states[index] & ~(1u << state));
+
+    if (states == _states[index]) {
+        return true;
+    }
+
+    _states[index] = states;
+    on_changed(index);
+
+    uint8_t signal = emits_signal(index);
+
+    if (signal != _signal[index]) {
+        _signal[index] = signal;
+        queue_outputs(index);
+    }
+
+    return true;
+}
+
+void Circuit::propagate() {
+    uint32_t num_levels = (uint32_t)_head.size();
+
+    for (uint32_t level = _lowest_queued; level < num_levels; ++level) {
+        if (_head[level] == CIRCUIT_NO_ITEM) {
+            continue;
+        }
+
+        if (_graph->num_loop_items > 0 && level == num_levels - 1) {
+            settle_loops();
+            continue;
+        }
+
+        // everything an item feeds is on a higher level, so each item is evaluated once
+        for (uint16_t item = pop(level); item != CIRCUIT_NO_ITEM; item = pop(level)) {
+            if (evaluate(item)) {
+                queue_outputs(item);
+            }
+        }
+    }
+
+    _lowest_queued = num_levels;
+}
+
+void Circuit::settle_loops() {
+    uint32_t level = (uint32_t)_head.size() - 1;
+
+    while (pop(level) != CIRCUIT_NO_ITEM) {
+    }
+
+    // a loop can hold on to a signal that nothing feeds any more, so every signal in the
+    // level starts out off and is turned on only by what comes from outside the loops,
+    // a signal only goes from off to on here so this ends
+    const uint16_t* loop_items = _graph->loop_items;
+
+    for (uint32_t i = 0; i < _graph->num_loop_items; ++i) {
+        uint16_t item = loop_items[i];
+
+        _loop_states[i] = _states[item];
+        _loop_changed[i] = _changed[item];
+        _signal[item] = 0;
+    }
+
+    for (uint32_t i = 0; i < _graph->num_loop_items; ++i) {
+        if (evaluate(loop_items[i])) {
+            queue_outputs(loop_items[i]);
+        }
+    }
+
+    for (uint16_t item = pop(level); item != CIRCUIT_NO_ITEM; item = pop(level)) {
+        if (evaluate(item)) {
+            queue_outputs(item);
+        }
+    }
+
+    // the power of an item can go off and on again on the way up
+    bool unchanged = false;
+
+    for (uint32_t i = 0; i < _graph->num_loop_items; ++i) {
+        uint16_t item = loop_items[i];
+
+        if (!_loop_changed[i] && _changed[item] && _states[item] == _loop_states[i]) {
+            _changed[item] = 0;
+            unchanged = true;
+        }
+    }
+
+    if (unchanged) {
+        uint32_t count = 0;
+
+        for (uint16_t index : _changes) {
+            if (_changed[index]) {
+                _changes[count++] = index;
+            }
+        }
+
+        _changes.resize(count);
+    }
+}
+
+void Circuit::clear_changes() {
+    for (uint16_t index : _changes) {
+        _changed[index] = 0;
+    }
+
+    _changes.clear();
+}
+
+bool Circuit::emits_signal(uint16_t index) const {
+    uint8_t states = _states[index];
+    uint8_t types = _graph->types[index];
+
+    bool powered = (states & CIRCUIT_BIT(ItemState::Power)) != 0;
+    bool activated = (states & CIRCUIT_BIT(ItemState::Activated)) != 0;
+
+    if (activated && (powered || !(types & (uint8_t)ItemType::MustBePoweredForActivate))) {
+        return true;
+    }
+
+    return powered && (types & (uint8_t)ItemType::Junction);
+}
+
+bool Circuit::evaluate(uint16_t index) {
+    CircuitGate gate = (CircuitGate)_graph->gates[index];
+
+    if (gate != CircuitGate::None) {
+        const uint16_t* in = _graph->in;
+        uint32_t start = _graph->in_start[index];
+        uint32_t end = _graph->in_start[index + 1];
+        bool powered;
+
+        if (gate == CircuitGate::And) {
+            powered = true;
+
+            for (uint32_t e = start; e < end && powered; ++e) {
+                powered = _signal[in[e]] != 0;
+            }
+        }
+        else {
+            powered = false;
+
+            for (uint32_t e = start; e < end && !powered; ++e) {
+                powered = _signal[in[e]] != 0;
+            }
+        }
+
+        uint8_t states = powered ? (uint8_t)(_states[index] | CIRCUIT_BIT(ItemState::Power)) : (uint8_t)(_states[index] & ~CIRCUIT_BIT(ItemState::Power));
+
+        if (states != _states[index]) {
+            _states[index] = states;
+            on_changed(index);
+        }
+    }
+
+    uint8_t signal = emits_signal(index);
+
+    if (signal == _signal[index]) {
+        return false;
+    }
+
+    _signal[index] = signal;
+
+    return true;
+}
+
+void Circuit::on_changed(uint16_t index) {
+    if (!_changed[index]) {
+        _changed[index] = 1;
+        _changes.push_back(index);
+    }
+}
+
+void Circuit::queue(uint16_t index) {
+    if (_queued[index]) {
+        return;
+    }
+
+    uint16_t level = _graph->levels[index];
+
+    _queued[index] = 1;
+    _next[index] = _head[level];
+    _head[level] = index;
+
+    if (level < _lowest_queued) {
+        _lowest_queued = level;
+    }
+}
+
+void Circuit::queue_outputs(uint16_t index) {
+    for (uint32_t e = _graph->out_start[index]; e < _graph->out_start[index + 1]; ++e) {
+        queue(_graph->out[e]);
+    }
+}
+
+uint16_t Circuit::pop(uint32_t level) {
+    uint16_t index = _head[level];
+
+    if (index != CIRCUIT_NO_ITEM) {
+        _head[level] = _next[index];
+        _queued[index] = 0;
+    }
+
+    return index;
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+enum class ItemType {
+    Junction = 1,
+    Switch = 2,
+    Openable = 4,
+    Hackable = 8,
+    Breakable = 16,
+    MustBePoweredForActivate = 32
+};
+
+// the values are bit positions in the item states
+enum class ItemState {
+    Power = 1,
+    Activated = 2,
+    Switch_AND = 4,
+    Switch_OR = 8, // require all incoming to be Activated to emit signal
+};
+
+enum class CircuitGate : uint8_t {
+    None = 0,   // no incoming items, the power is whatever was set on the item
+    And,        // powered when every incoming item emits a signal
+    Or          // powered when any incoming item emits a signal
+};
+
+#define CIRCUIT_NO_ITEM 0xffff
+
+/// <summary>
+/// The compiled item network of a level, read only and shared by every session on the level
+/// The arrays are indexed by the dense item index, the edges of item i are
+/// out[out_start[i] .. out_start[i + 1]], the same for in
+/// Every item is on its topological level, the items in a loop and everything they feed
+/// share the last level and are listed in loop_items
+/// </summary>
+struct Circuit_graph {
+    uint32_t        num_items;
+    uint32_t        num_levels;
+    uint32_t        num_loop_items;
+
+    const uint8_t*  types;
+    const uint8_t*  gates;
+    const uint16_t* levels;
+
+    const uint32_t* out_start;
+    const uint16_t* out;
+    const uint32_t* in_start;
+    const uint16_t* in;
+
+    const uint16_t* loop_items;
+
+    Circuit_graph();
+};
+
+/// <summary>
+/// Compiles the items and their connections into a Circuit_graph that points into the builder
+/// + begin(), add_item() for every item, add_edge() for every connection, then build()
+/// </summary>
+struct Circuit_builder {
+    void begin(uint32_t num_items);
+
+    void add_item(uint16_t index, uint8_t types, uint8_t states);
+
+    // duplicate edges are ignored
+    void add_edge(uint16_t from, uint16_t to);
+
+    void build(Circuit_graph& graph);
+
+    std::vector<uint8_t>    types;
+    std::vector<uint8_t>    states; // as the items were added, the gates are taken from them
+    std::vector<uint8_t>    gates;
+    std::vector<uint16_t>   levels;
+
+    std::vector<uint32_t>   out_start;
+    std::vector<uint16_t>   out;
+    std::vector<uint32_t>   in_start;
+    std::vector<uint16_t>   in;
+
+    std::vector<uint16_t>   loop_items;
+
+private:
+    // the edges as added, sorted into the CSR lists by build()
+    std::vector<uint32_t>   _edges;
+};
+
+/// <summary>
+/// The item states of a session on top of a shared Circuit_graph
+/// + reset() with the states the items start in, settle() if they dont come from a settled circuit
+/// + set_state() changes a state bit of an item, the items it feeds are queued
+/// + propagate() once per tick runs the queue through the whole network,
+///   changes() is every item whose states changed since clear_changes(), each item once
+///
+/// An item emits a signal when it is Activated (and powered, if it must be to activate)
+/// or when it is a powered Junction. The queue is worked off level by level so an item is
+/// evaluated after everything that feeds it. The loop level is settled from no signal up,
+/// so a loop of junctions doesnt keep itself powered
+/// Nothing here is shared, it is a few bytes per item and a list head per level
+/// </summary>
+struct Circuit {
+    Circuit();
+
+    // the graph has to outlive the circuit
+    void reset(const Circuit_graph* graph, const uint8_t* states);
+
+    // evaluates every item, there are no changes afterwards
+    void settle();
+
+    bool set_state(uint16_t index, uint8_t state, uint8_t on);
+
+    void propagate();
+
+    const std::vector<uint16_t>& changes() const { return _changes; }
+
+    void clear_changes();
+
+    uint8_t get_states(uint16_t index) const { return _states[index]; }
+    bool get_signal(uint16_t index) const { return _signal[index] != 0; }
+
+    // every item, indexed by the item index
+    const uint8_t* states() const { return _states.data(); }
+
+    uint32_t num_items() const { return (uint32_t)_states.size(); }
+    uint32_t num_levels() const { return (uint32_t)_head.size(); }
+
+private:
+    bool emits_signal(uint16_t index) const;
+
+    // evaluates the gate of the item, returns true if its signal changed
+    bool evaluate(uint16_t index);
+
+    void on_changed(uint16_t index);
+
+    void queue(uint16_t index);
+
+    void queue_outputs(uint16_t index);
+
+    // takes an item off the queue of the level, CIRCUIT_NO_ITEM when it is empty
+    uint16_t pop(uint32_t level);
+
+    void settle_loops();
+
+    const Circuit_graph*    _graph;
+
+    std::vector<uint8_t>    _states;
+    std::vector<uint8_t>    _signal;
+
+    // the queued items of a level are a list from _head through _next, _queued so an item is only in it once
+    std::vector<uint16_t>   _head;
+    std::vector<uint16_t>   _next;
+    std::vector<uint8_t>    _queued;
+    uint32_t                _lowest_queued;
+
+    std::vector<uint16_t>   _changes;
+    std::vector<uint8_t>    _changed;
+
+    // before settle_loops(), so items that end up as they were arent changes
+    std::vector<uint8_t>    _loop_states;
+    std::vector<uint8_t>    _loop_changed;
+};
@@ -0,0 +1,47 @@
+#include "dead_reckoning.h"
+
+#include <cmath>
+
+Dead_reckoning::Dead_reckoning() {
+    set_thresholds(DEAD_RECKONING_POSITION_THRESHOLD, DEAD_RECKONING_ROTATION_THRESHOLD, DEAD_RECKONING_MAX_INTERVAL_MS);
+}
+
+void Dead_reckoning::set_thresholds(float position, float rotation, uint32_t max_interval_ms) {
+    _position_sq = position * position;
+    _rotation_cos = std::cos(rotation * 0.5f);
+    _max_interval = max_interval_ms;
+}
+
+bool Dead_reckoning::needs_update(const Net_game_transforms_snapshot& snapshot, const Snapshot_baseline* baseline, uint8_t entity, const Transform_codec& codec) const {
+    if (baseline == NULL || baseline->num_players != snapshot.num_players || !baseline->known[entity]) {
+        return true;
+    }
+
+    const Transform_q& cur = snapshot.player_transforms[entity];
+    const Transform_q& base = baseline->player_transforms[entity];
+
+    uint32_t elapsed = snapshot.session_timestamp - baseline->timestamps[entity];
+
+    if (elapsed >= _max_interval) {
+        return true;
+    }
+
+    // the quantized values are what both sides have, so the prediction is the same as the client makes
+    glm::vec3 predicted = codec.position(base);
+
+    if (codec.velocity_enabled && base.has_velocity) {
+        predicted += codec.velocity(base) * (elapsed / 1000.0f);
+    }
+
+    glm::vec3 error = codec.position(cur) - predicted;
+
+    if (glm::dot(error, error) > _position_sq) {
+        return true;
+    }
+
+    if (!cur.rot_equals(base) && std::fabs(glm::dot(codec.rotation(cur), codec.rotation(base))) < _rotation_cos) {
+        return true;
+    }
+
+    return false;
+}
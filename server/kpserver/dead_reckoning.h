@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "net_packet.h"
+#include "snapshot_delta.h"
+
+#define DEAD_RECKONING_POSITION_THRESHOLD   0.05f   // meters, default, set from the ini
+#define DEAD_RECKONING_ROTATION_THRESHOLD   0.05f   // radians
+#define DEAD_RECKONING_MAX_INTERVAL_MS      1000    // default, set from the ini
+
+/// <summary>
+/// Decides which entities a client needs an update for
+/// The client extrapolates every entity from the last transform it got, the position moves
+/// with the velocity from the session timestamp of the snapshot the entity was in and
+/// the rotation is held. We run the same prediction on the acked baseline of the client
+/// and only send an entity when
+/// + the client doesnt know it yet
+/// + the predicted position or rotation is off by more than the threshold
+/// + it hasnt been sent for the max interval, so a lost update doesnt leave the client wrong for long
+/// Entities standing still or moving in a straight line arent sent at all once the client has acked them
+/// </summary>
+struct Dead_reckoning {
+    Dead_reckoning();
+
+    void set_thresholds(float position, float rotation, uint32_t max_interval_ms);
+
+    bool needs_update(const Net_game_transforms_snapshot& snapshot, const Snapshot_baseline* baseline, uint8_t entity, const Transform_codec& codec) const;
+
+private:
+    float       _position_sq;
+    float       _rotation_cos; // of half the threshold angle, compared against the quaternion dot product
+    uint32_t    _max_interval;
+};
@@ -0,0 +1,120 @@
+#include "file_mapping.h"
+
+#ifdef WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN 1
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "trace.h"
+
+File_mapping::File_mapping() : _data(nullptr), _size(0) {
+#ifdef WIN32
+    _file = INVALID_HANDLE_VALUE;
+    _mapping = NULL;
+#endif
+}
+
+File_mapping::~File_mapping() {
+    close();
+}
+
+bool File_mapping::open(const std::string& path) {
+    close();
+
+#ifdef WIN32
+    _file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (_file == INVALID_HANDLE_VALUE) {
+        TRACE("[FILE_MAPPING][OPEN][ERROR] Unable to open %s\n", path.c_str());
+        return false;
+    }
+
+    LARGE_INTEGER size;
+
+    if (!GetFileSizeEx(_file, &size) || size.QuadPart == 0 || size.QuadPart > 0xffffffffLL) {
+        TRACE("[FILE_MAPPING][OPEN][ERROR] Invalid size of %s\n", path.c_str());
+        close();
+        return false;
+    }
+
+    _mapping = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+    if (_mapping == NULL) {
+        TRACE("[FILE_MAPPING][OPEN][ERROR] Unable to map %s\n", path.c_str());
+        close();
+        return false;
+    }
+
+    _data = (const uint8_t*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+
+    if (_data == nullptr) {
+        TRACE("[FILE_MAPPING][OPEN][ERROR] Unable to map %s\n", path.c_str());
+        close();
+        return false;
+    }
+
+    _size = (uint32_t)size.QuadPart;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+
+    if (fd < 0) {
+        TRACE("[FILE_MAPPING][OPEN][ERROR] Unable to open %s\n", path.c_str());
+        return false;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || st.st_size == 0 || st.st_size > 0xffffffffLL) {
+        TRACE("[FILE_MAPPING][OPEN][ERROR] Invalid size of %s\n", path.c_str());
+        ::close(fd);
+        return false;
+    }
+
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+    // the mapping keeps the file open
+    ::close(fd);
+
+    if (data == MAP_FAILED) {
+        TRACE("[FILE_MAPPING][OPEN][ERROR] Unable to map %s\n", path.c_str());
+        return false;
+    }
+
+    _data = (const uint8_t*)data;
+    _size = (uint32_t)st.st_size;
+#endif
+
+    return true;
+}
+
+void File_mapping::close() {
+#ifdef WIN32
+    if (_data != nullptr) {
+        UnmapViewOfFile(_data);
+    }
+
+    if (_mapping != NULL) {
+        CloseHandle(_mapping);
+    }
+
+    if (_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(_file);
+    }
+
+    _file = INVALID_HANDLE_VALUE;
+    _mapping = NULL;
+#else
+    if (_data != nullptr) {
+        munmap((void*)_data, _size);
+    }
+#endif
+
+    _data = nullptr;
+    _size = 0;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+/// <summary>
+/// A file mapped read only into memory, the pages are loaded as they are touched
+/// and shared with every other process that maps the same file
+/// </summary>
+struct File_mapping {
+    File_mapping();
+    ~File_mapping();
+
+    bool open(const std::string& path);
+
+    void close();
+
+    const uint8_t* data() const { return _data; }
+    uint32_t size() const { return _size; }
+
+private:
+    File_mapping(const File_mapping&);
+    File_mapping& operator=(const File_mapping&);
+
+    const uint8_t*  _data;
+    uint32_t        _size;
+
+#ifdef WIN32
+    void*           _file;
+    void*           _mapping;
+#endif
+};
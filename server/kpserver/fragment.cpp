@@ -0,0 +1,114 @@
+#include "fragment.h"
+
+#include <string.h>
+
+#include "trace.h"
+
+uint32_t fragment_count(uint32_t len) {
+    uint32_t count = (len + (uint32_t)FRAGMENT_SIZE - 1) / (uint32_t)FRAGMENT_SIZE;
+
+    return count > FRAGMENT_MAX_COUNT ? 0 : count;
+}
+
+Fragment_reassembly::Fragment_reassembly() {
+    _slots.resize(FRAGMENT_REASSEMBLY_SLOTS);
+
+    reset();
+}
+
+void Fragment_reassembly::reset() {
+    for (auto& slot : _slots) {
+        slot.used = false;
+    }
+}
+
+Fragment_reassembly::Slot* Fragment_reassembly::find_slot(uint16_t group_id, std::chrono::time_point<std::chrono::high_resolution_clock>& now) {
+    Slot* free_slot = NULL;
+    Slot* oldest = &_slots[0];
+
+    for (auto& slot : _slots) {
+        if (slot.used && now - slot.started > std::chrono::seconds(FRAGMENT_TIMEOUT_SECONDS)) {
+            TRACE("[FRAGMENT][TIMEOUT][group: %d][%d/%d]\n", slot.group_id, slot.num_received, slot.num_fragments);
+            slot.used = false;
+        }
+
+        if (slot.used && slot.group_id == group_id) {
+            return &slot;
+        }
+
+        if (!slot.used && free_slot == NULL) {
+            free_slot = &slot;
+        }
+
+        if (slot.started < oldest->started) {
+            oldest = &slot;
+        }
+    }
+
+    if (free_slot != NULL) {
+        return free_slot;
+    }
+
+    TRACE("[FRAGMENT][DROP][group: %d][Reassembly table full]\n", oldest->group_id);
+
+    oldest->used = false;
+
+    return oldest;
+}
+
+const std::vector<uint8_t>* Fragment_reassembly::on_fragment(const Net_fragment_header& header, const uint8_t* data, std::chrono::time_point<std::chrono::high_resolution_clock>& now) {
+    if (header.num_fragments == 0 || header.num_fragments > FRAGMENT_MAX_COUNT || header.fragment_index >= header.num_fragments) {
+        return NULL;
+    }
+
+    bool is_last = header.fragment_index == header.num_fragments - 1;
+
+    // every fragment but the last is full size, so we know where it goes
+    if (header.length > FRAGMENT_SIZE || (!is_last && header.length != FRAGMENT_SIZE)) {
+        return NULL;
+    }
+
+    Slot* slot = find_slot(header.group_id, now);
+
+    if (!slot->used) {
+        slot->used = true;
+        slot->group_id = header.group_id;
+        slot->num_fragments = header.num_fragments;
+        slot->num_received = 0;
+        slot->received = 0;
+        slot->started = now;
+
+        slot->data.resize((size_t)header.num_fragments * FRAGMENT_SIZE);
+    }
+
+    if (slot->num_fragments != header.num_fragments) {
+        return NULL;
+    }
+
+    uint64_t bit = 1ull << header.fragment_index;
+
+    if (slot->received & bit) {
+        return NULL;
+    }
+
+    memcpy(&slot->data[(size_t)header.fragment_index * FRAGMENT_SIZE], data, header.length);
+
+    slot->received |= bit;
+    slot->num_received++;
+
+    // the last fragment tells us the real size
+    if (is_last) {
+        slot->data.resize((size_t)header.fragment_index * FRAGMENT_SIZE + header.length);
+    }
+
+    if (slot->num_received < slot->num_fragments) {
+        return NULL;
+    }
+
+    slot->used = false;
+
+    // hand the buffer out, the slot takes the previous one back so the capacity is reused
+    _complete.swap(slot->data);
+
+    return &_complete;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <chrono>
+
+#include "net_packet.h"
+#include "reliable_endpoint.h"
+
+// leaves room for the datagram header and, for reliable fragments, the reliable header
+#define FRAGMENT_SIZE               (UDP_MAX_DATAGRAM_SIZE - sizeof(Net_datagram_header) - sizeof(Net_reliable_header) - sizeof(Net_fragment_header))
+#define FRAGMENT_MAX_COUNT          64      // ~73 kB per message
+#define FRAGMENT_REASSEMBLY_SLOTS   4       // messages we reassemble at the same time per client
+#define FRAGMENT_TIMEOUT_SECONDS    3
+
+/// <summary>
+/// Number of fragments needed for len bytes, 0 if the message is too large to be sent
+/// </summary>
+uint32_t fragment_count(uint32_t len);
+
+/// <summary>
+/// Reassembles fragmented messages from one client
+/// + A fixed number of slots, a new message takes a free or timed out slot,
+///   if there is none the oldest message is dropped
+/// + Fragments are written straight to their place in the slot buffer and the
+///   complete message is handed out from there, without copying it again
+/// </summary>
+struct Fragment_reassembly {
+    Fragment_reassembly();
+
+    void reset();
+
+    // returns the complete message once the last missing fragment arrives, NULL until then
+    // the returned buffer is valid until the next call
+    const std::vector<uint8_t>* on_fragment(const Net_fragment_header& header, const uint8_t* data, std::chrono::time_point<std::chrono::high_resolution_clock>& now);
+
+private:
+    struct Slot {
+        bool        used;
+        uint16_t    group_id;
+        uint8_t     num_fragments;
+        uint8_t     num_received;
+        uint64_t    received; // a bit per fragment
+
+        std::vector<uint8_t> data;
+
+        std::chrono::time_point<std::chrono::high_resolution_clock> started;
+    };
+
+    Slot* find_slot(uint16_t group_id, std::chrono::time_point<std::chrono::high_resolution_clock>& now);
+
+    std::vector<Slot> _slots;
+
+    // the last message we handed out, kept until the next call
+    std::vector<uint8_t> _complete;
+};
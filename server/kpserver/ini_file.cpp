@@ -4,6 +4,7 @@
 #include <vector>
 
 #include "trace.h"
+#include "ip_block_list.h"
 
 Ini_node::Ini_node() {
     hostname = "localhost";
@@ -24,6 +25,17 @@ Ini_node::Ini_node() {
     is_me = false;
     is_ip_set = false;
     session_id_start_range = 1000;
+    block_ttl_seconds = 300;
+    max_connections_per_ip = 8;
+    blocked_ranges = "";
+    snapshot_rate_min = 5;
+    snapshot_budget_min = 300;
+    snapshot_budget_max = 1200;
+    item_snapshot_interval_ms = 1000;
+    transform_history_ms = 1000;
+    dead_reckoning_threshold_mm = 50;
+    dead_reckoning_max_interval_ms = 1000;
+    level_file = "";
 }
 
 void Ini_node::print() const {
@@ -68,6 +80,17 @@ void Ini_node::write(std::ofstream& outfile) {
     outfile << "is_me:" << (is_me ? "yes" : "no") << std::endl;
     outfile << "client_password:" << client_password << std::endl;
     outfile << "session_id_start_range:" << session_id_start_range << std::endl;
+    outfile << "block_ttl_seconds:" << block_ttl_seconds << std::endl;
+    outfile << "max_connections_per_ip:" << max_connections_per_ip << std::endl;
+    outfile << "blocked_ranges:" << blocked_ranges << std::endl;
+    outfile << "snapshot_rate_min:" << snapshot_rate_min << std::endl;
+    outfile << "snapshot_budget_min:" << snapshot_budget_min << std::endl;
+    outfile << "snapshot_budget_max:" << snapshot_budget_max << std::endl;
+    outfile << "item_snapshot_interval_ms:" << item_snapshot_interval_ms << std::endl;
+    outfile << "transform_history_ms:" << transform_history_ms << std::endl;
+    outfile << "dead_reckoning_threshold_mm:" << dead_reckoning_threshold_mm << std::endl;
+    outfile << "dead_reckoning_max_interval_ms:" << dead_reckoning_max_interval_ms << std::endl;
+    outfile << "level_file:" << level_file << std::endl;
     outfile << "" << std::endl;
 }
 
@@ -221,6 +244,47 @@ bool Ini_file::read() {
         else if (key == "client_password") {
             current_node->client_password = std::stoull(value, nullptr, 10);
         }
+        else if (key == "block_ttl_seconds") {
+            int ttl = stoi(value);
+
+            // 0 would make the flood blocks permanent
+            if (ttl < IP_BLOCK_TTL_MIN_SECONDS) {
+                printf("WARNING: ini file: %s, block_ttl_seconds:%d is raised to %d\n", _filepath.c_str(), ttl, IP_BLOCK_TTL_MIN_SECONDS);
+                ttl = IP_BLOCK_TTL_MIN_SECONDS;
+            }
+
+            current_node->block_ttl_seconds = ttl;
+        }
+        else if (key == "max_connections_per_ip") {
+            current_node->max_connections_per_ip = stoi(value);
+        }
+        else if (key == "blocked_ranges") {
+            current_node->blocked_ranges = value;
+        }
+        else if (key == "snapshot_rate_min") {
+            current_node->snapshot_rate_min = stoi(value);
+        }
+        else if (key == "snapshot_budget_min") {
+            current_node->snapshot_budget_min = stoi(value);
+        }
+        else if (key == "snapshot_budget_max") {
+            current_node->snapshot_budget_max = stoi(value);
+        }
+        else if (key == "item_snapshot_interval_ms") {
+            current_node->item_snapshot_interval_ms = stoi(value);
+        }
+        else if (key == "transform_history_ms") {
+            current_node->transform_history_ms = stoi(value);
+        }
+        else if (key == "dead_reckoning_threshold_mm") {
+            current_node->dead_reckoning_threshold_mm = stoi(value);
+        }
+        else if (key == "dead_reckoning_max_interval_ms") {
+            current_node->dead_reckoning_max_interval_ms = stoi(value);
+        }
+        else if (key == "level_file") {
+            current_node->level_file = value;
+        }
     }
 
 
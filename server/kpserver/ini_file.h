@@ -25,6 +25,17 @@ struct Ini_node {
     uint64_t master_password;
     uint64_t client_password;
     uint32_t session_id_start_range;
+    uint32_t block_ttl_seconds; // how long a flooding IP stays blocked, IP_BLOCK_TTL_MIN_SECONDS (10) or more
+    uint16_t max_connections_per_ip;
+    std::string blocked_ranges; // comma separated CIDRs that are always blocked
+    uint32_t snapshot_rate_min; // per client snapshot rate falls back to this on a bad link, the max is ticks_per_second_position_update_sends
+    uint32_t snapshot_budget_min; // bytes per snapshot on a bad link
+    uint32_t snapshot_budget_max; // bytes per snapshot on a good link
+    uint32_t item_snapshot_interval_ms; // how often the changed item states are sent
+    uint32_t transform_history_ms; // how far back the server can rewind the players
+    uint32_t dead_reckoning_threshold_mm; // entities are sent when the client extrapolation is off by more than this
+    uint32_t dead_reckoning_max_interval_ms; // entities are sent at least this often
+    std::string level_file; // the cooked level every session plays, no items when empty
 
     bool is_me;
     bool is_master;
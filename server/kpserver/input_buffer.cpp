@@ -0,0 +1,67 @@
+#include "input_buffer.h"
+
+#include "trace.h"
+
+void Input_counters::print(const char* name) const {
+    TRACE("--- Inputs (%s): %llu consumed, %llu late, %llu early, %llu missing\n", name,
+        (unsigned long long)consumed, (unsigned long long)late, (unsigned long long)early, (unsigned long long)missing);
+}
+
+Input_buffer::Input_buffer() : _num_players(0) {
+
+}
+
+void Input_buffer::reset(uint32_t num_players) {
+    Slot empty;
+    empty.tick = 0;
+    empty.is_set = false;
+
+    _num_players = num_players;
+    _slots.assign(num_players * INPUT_BUFFER_TICKS, empty);
+
+    counters = Input_counters();
+}
+
+bool Input_buffer::push(uint8_t player, uint32_t tick, const Net_pos& pos, uint32_t world_tick) {
+    if (player >= _num_players) {
+        return false;
+    }
+
+    if (tick < world_tick) {
+        counters.late++;
+        return false;
+    }
+
+    if (tick - world_tick >= INPUT_BUFFER_TICKS) {
+        counters.early++;
+        return false;
+    }
+
+    Slot& slot = _slots[player * INPUT_BUFFER_TICKS + (tick & (INPUT_BUFFER_TICKS - 1))];
+
+    slot.tick = tick;
+    slot.is_set = true;
+    slot.pos = pos;
+
+    return true;
+}
+
+const Net_pos* Input_buffer::pop(uint8_t player, uint32_t tick) {
+    if (player >= _num_players) {
+        return nullptr;
+    }
+
+    Slot& slot = _slots[player * INPUT_BUFFER_TICKS + (tick & (INPUT_BUFFER_TICKS - 1))];
+
+    // a slot left from an older tick is stale, the slot is free again either way
+    if (!slot.is_set || slot.tick != tick) {
+        slot.is_set = false;
+        counters.missing++;
+        return nullptr;
+    }
+
+    slot.is_set = false;
+    counters.consumed++;
+
+    return &slot.pos;
+}
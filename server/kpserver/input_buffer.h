@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "net_packet.h"
+
+#define INPUT_BUFFER_TICKS  32  // how far ahead of the world an input may arrive, a power of two
+
+struct Input_counters {
+    uint64_t    consumed;
+    uint64_t    late;       // arrived after the world stepped past its tick
+    uint64_t    early;      // further ahead than the buffer holds
+    uint64_t    missing;    // ticks a player had no input for
+
+    Input_counters() : consumed(0), late(0), early(0), missing(0) {}
+
+    void print(const char* name) const;
+};
+
+/// <summary>
+/// The tick stamped inputs of every player, held until the world steps the tick they are for
+/// + push() as an input arrives, a newer input for the same tick replaces it
+/// + pop() when the world steps a tick, the input the player sent for it if it has arrived
+/// A ring of INPUT_BUFFER_TICKS slots per player indexed on the tick, so the arrival order
+/// and the arrival times dont matter, only which inputs are there when the tick is stepped
+/// </summary>
+struct Input_buffer {
+    Input_buffer();
+
+    void reset(uint32_t num_players);
+
+    // world_tick is the next tick the world steps, false if the input is late or too early
+    bool push(uint8_t player, uint32_t tick, const Net_pos& pos, uint32_t world_tick);
+
+    // nullptr if the player has no input for the tick
+    const Net_pos* pop(uint8_t player, uint32_t tick);
+
+    Input_counters counters;
+
+private:
+    struct Slot {
+        uint32_t    tick;
+        bool        is_set;
+        Net_pos     pos;
+    };
+
+    std::vector<Slot>   _slots;
+    uint32_t            _num_players;
+};
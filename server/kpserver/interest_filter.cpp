@@ -0,0 +1,145 @@
+#include "interest_filter.h"
+
+#include <cmath>
+#include <algorithm>
+
+Interest_filter::Interest_filter()
+    :   _min(0, 0, 0),
+        _cells_x(1),
+        _cells_z(1),
+        _near(0),
+        _far(0),
+        _near_sq(0),
+        _far_sq(0),
+        _far_cells(0),
+        _far_interval(1) {
+
+    set_radius(INTEREST_NEAR_RADIUS, INTEREST_FAR_RADIUS, INTEREST_FAR_INTERVAL);
+}
+
+void Interest_filter::set_bounds(const glm::vec3& min, const glm::vec3& max) {
+    _min = min;
+    _cells_x = std::max(1u, (uint32_t)ceilf((max.x - min.x) / INTEREST_CELL_SIZE));
+    _cells_z = std::max(1u, (uint32_t)ceilf((max.z - min.z) / INTEREST_CELL_SIZE));
+
+    _cell_start.assign(_cells_x * _cells_z + 1, 0);
+}
+
+void Interest_filter::set_radius(float near_radius, float far_radius, uint32_t far_interval) {
+    _near = near_radius;
+    _far = far_radius;
+    _near_sq = near_radius * near_radius;
+    _far_sq = far_radius * far_radius;
+    _far_cells = (int32_t)ceilf(far_radius / INTEREST_CELL_SIZE);
+    _far_interval = far_interval == 0 ? 1 : far_interval;
+}
+
+uint32_t Interest_filter::cell_index(const glm::vec3& pos) const {
+    int32_t x = (int32_t)floorf((pos.x - _min.x) / INTEREST_CELL_SIZE);
+    int32_t z = (int32_t)floorf((pos.z - _min.z) / INTEREST_CELL_SIZE);
+
+    x = std::min(std::max(x, 0), (int32_t)_cells_x - 1);
+    z = std::min(std::max(z, 0), (int32_t)_cells_z - 1);
+
+    return (uint32_t)z * _cells_x + (uint32_t)x;
+}
+
+void Interest_filter::rebuild(const std::vector<std::unique_ptr<Transform_entity>>& entities) {
+    if (_cell_start.empty()) {
+        _cell_start.assign(_cells_x * _cells_z + 1, 0);
+    }
+
+    uint32_t num_cells = _cells_x * _cells_z;
+    uint32_t num_entities = (uint32_t)std::min(entities.size(), (size_t)256);
+
+    _entity_cell.resize(num_entities);
+    _entity_pos.resize(num_entities);
+    _cell_entities.resize(num_entities);
+
+    std::fill(_cell_start.begin(), _cell_start.end(), 0);
+
+    // count the entities per cell
+    for (uint32_t i = 0; i < num_entities; ++i) {
+        _entity_pos[i] = entities[i]->pos;
+        _entity_cell[i] = cell_index(_entity_pos[i]);
+        _cell_start[_entity_cell[i] + 1]++;
+    }
+
+    for (uint32_t c = 0; c < num_cells; ++c) {
+        _cell_start[c + 1] += _cell_start[c];
+    }
+
+    // place them, _cell_start[c] is used as the write cursor and restored afterwards
+    for (uint32_t i = 0; i < num_entities; ++i) {
+        _cell_entities[_cell_start[_entity_cell[i]]++] = (uint8_t)i;
+    }
+
+    for (uint32_t c = num_cells; c > 0; --c) {
+        _cell_start[c] = _cell_start[c - 1];
+    }
+
+    _cell_start[0] = 0;
+}
+
+void Interest_filter::gather(uint8_t viewer, uint16_t sequence, std::vector<uint8_t>& out) const {
+    out.clear();
+
+    if (viewer >= _entity_pos.size()) {
+        return;
+    }
+
+    const glm::vec3& origin = _entity_pos[viewer];
+    uint32_t cell = _entity_cell[viewer];
+
+    int32_t cx = (int32_t)(cell % _cells_x);
+    int32_t cz = (int32_t)(cell / _cells_x);
+
+    int32_t x0 = std::max(cx - _far_cells, 0);
+    int32_t x1 = std::min(cx + _far_cells, (int32_t)_cells_x - 1);
+    int32_t z0 = std::max(cz - _far_cells, 0);
+    int32_t z1 = std::min(cz + _far_cells, (int32_t)_cells_z - 1);
+
+    for (int32_t z = z0; z <= z1; ++z) {
+        for (int32_t x = x0; x <= x1; ++x) {
+            uint32_t c = (uint32_t)z * _cells_x + (uint32_t)x;
+
+            for (uint32_t n = _cell_start[c]; n < _cell_start[c + 1]; ++n) {
+                uint8_t entity = _cell_entities[n];
+
+                glm::vec3 d = _entity_pos[entity] - origin;
+                float dist_sq = d.x * d.x + d.z * d.z;
+
+                if (dist_sq > _far_sq) {
+                    continue;
+                }
+
+                // the far ring is staggered so only a share of it is sent each snapshot
+                if (dist_sq > _near_sq && (uint32_t)(sequence + entity) % _far_interval != 0) {
+                    continue;
+                }
+
+                out.push_back(entity);
+            }
+        }
+    }
+
+    // the snapshot is written in index order so the client can walk its entity list once
+    std::sort(out.begin(), out.end());
+}
+
+float Interest_filter::relevance(uint8_t viewer, uint8_t entity) const {
+    if (viewer >= _entity_pos.size() || entity >= _entity_pos.size()) {
+        return 0.0f;
+    }
+
+    glm::vec3 d = _entity_pos[entity] - _entity_pos[viewer];
+    float dist_sq = d.x * d.x + d.z * d.z;
+
+    if (dist_sq <= _near_sq) {
+        return 1.0f;
+    }
+
+    float t = (sqrtf(dist_sq) - _near) / (_far - _near);
+
+    return std::max(INTEREST_MIN_RELEVANCE, 1.0f - t * (1.0f - INTEREST_MIN_RELEVANCE));
+}
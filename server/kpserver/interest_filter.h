@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <memory>
+#include <glm/glm.hpp>
+
+#include "transform_entity.h"
+
+#define INTEREST_CELL_SIZE      16.0f
+#define INTEREST_NEAR_RADIUS    24.0f   // entities closer than this are sent every snapshot
+#define INTEREST_FAR_RADIUS     64.0f   // entities further away than this are not sent at all
+#define INTEREST_FAR_INTERVAL   4       // entities between near and far are sent every nth snapshot
+#define INTEREST_MIN_RELEVANCE  0.1f    // relevance at the far radius, it is 1 inside the near radius
+
+/// <summary>
+/// Decides which entities each player should receive in a transform snapshot
+/// + Entities are bucketed into a uniform grid on the XZ plane once per snapshot,
+///   the bucketing is a counting sort so rebuild() is O(entities + cells)
+/// + gather() only visits the cells within the far radius of the viewer, so the
+///   cost per viewer depends on how crowded the area is, not on the session size
+/// + Entities in the far ring are spread over INTEREST_FAR_INTERVAL snapshots
+///   (staggered on the entity index) so they dont all arrive on the same tick
+/// </summary>
+struct Interest_filter {
+    Interest_filter();
+
+    // the grid covers the level bounds, entities outside are clamped to the edge cells
+    void set_bounds(const glm::vec3& min, const glm::vec3& max);
+
+    void set_radius(float near_radius, float far_radius, uint32_t far_interval);
+
+    void rebuild(const std::vector<std::unique_ptr<Transform_entity>>& entities);
+
+    // fills out with the entity indices the viewer should receive this snapshot, sorted ascending
+    void gather(uint8_t viewer, uint16_t sequence, std::vector<uint8_t>& out) const;
+
+    // how much the viewer cares about the entity, falls off linearly from the near to the far radius
+    float relevance(uint8_t viewer, uint8_t entity) const;
+
+private:
+    uint32_t cell_index(const glm::vec3& pos) const;
+
+    glm::vec3   _min;
+    uint32_t    _cells_x;
+    uint32_t    _cells_z;
+
+    float       _near;
+    float       _far;
+    float       _near_sq;
+    float       _far_sq;
+    int32_t     _far_cells;
+    uint32_t    _far_interval;
+
+    // _cell_start[c] .. _cell_start[c+1] is the range in _cell_entities for cell c
+    std::vector<uint32_t>   _cell_start;
+    std::vector<uint8_t>    _cell_entities;
+
+    std::vector<uint32_t>   _entity_cell;
+    std::vector<glm::vec3>  _entity_pos;
+};
@@ -0,0 +1,183 @@
+#include "ip_block_list.h"
+
+#include <algorithm>
+#include <sstream>
+#include <stdio.h>
+#include <ctype.h>
+
+#include "trace.h"
+
+Ip_block_list::Ip_block_list()
+    :   _default_ttl_seconds(300),
+        _max_connections_per_ip(8) {
+
+    _now = std::chrono::high_resolution_clock::now();
+    _next_expiry = _now + std::chrono::hours(24 * 365);
+}
+
+void Ip_block_list::configure(uint32_t default_ttl_seconds, uint16_t max_connections_per_ip, const std::string& ranges) {
+    _default_ttl_seconds = default_ttl_seconds < IP_BLOCK_TTL_MIN_SECONDS ? IP_BLOCK_TTL_MIN_SECONDS : default_ttl_seconds;
+    _max_connections_per_ip = max_connections_per_ip;
+
+    // ranges is a comma separated list of CIDRs, for example: 10.0.0.0/8,192.168.1.17
+    std::istringstream is(ranges);
+    std::string cidr;
+
+    while (getline(is, cidr, ',')) {
+        cidr.erase(std::remove_if(cidr.begin(), cidr.end(), ::isspace), cidr.end());
+
+        if (cidr.length() == 0) {
+            continue;
+        }
+
+        if (!block_cidr(cidr, 0)) {
+            TRACE("[IP-BLOCK-LIST][CONFIGURE][ERROR][Invalid range: %s]\n", cidr.c_str());
+        }
+    }
+}
+
+void Ip_block_list::block(uint32_t ip, uint32_t ttl_seconds) {
+    block_range(ip, 32, ttl_seconds == 0 ? _default_ttl_seconds : ttl_seconds);
+}
+
+void Ip_block_list::block_range(uint32_t ip, uint8_t prefix_len, uint32_t ttl_seconds) {
+    if (prefix_len > 32) {
+        prefix_len = 32;
+    }
+
+    uint32_t mask = prefix_len == 0 ? 0 : (0xFFFFFFFFu << (32 - prefix_len));
+
+    Ip_block_range range;
+    range.first = ip & mask;
+    range.last = range.first | ~mask;
+    range.permanent = ttl_seconds == 0;
+    range.expires = _now + std::chrono::seconds(ttl_seconds);
+
+    insert(range);
+
+    TRACE("[IP-BLOCK-LIST][BLOCK][%u.%u.%u.%u/%d][ttl: %u]\n",
+        (ip >> 24) & 0xFF, (ip >> 16) & 0xFF, (ip >> 8) & 0xFF, ip & 0xFF, prefix_len, ttl_seconds);
+}
+
+bool Ip_block_list::block_cidr(const std::string& cidr, uint32_t ttl_seconds) {
+    unsigned int a, b, c, d;
+    unsigned int prefix_len = 32;
+
+    int num = sscanf(cidr.c_str(), "%u.%u.%u.%u/%u", &a, &b, &c, &d, &prefix_len);
+
+    if (num < 4 || a > 255 || b > 255 || c > 255 || d > 255 || prefix_len > 32) {
+        return false;
+    }
+
+    block_range((a << 24) | (b << 16) | (c << 8) | d, (uint8_t)prefix_len, ttl_seconds);
+
+    return true;
+}
+
+void Ip_block_list::insert(const Ip_block_range& range) {
+    auto it = std::lower_bound(_ranges.begin(), _ranges.end(), range.first,
+        [](const Ip_block_range& r, uint32_t first) { return r.first < first; });
+
+    // same range already blocked, just extend it
+    for (auto same = it; same != _ranges.end() && same->first == range.first; ++same) {
+        if (same->last == range.last) {
+            same->permanent = same->permanent || range.permanent;
+            same->expires = std::max(same->expires, range.expires);
+            return;
+        }
+    }
+
+    _ranges.insert(it, range);
+    rebuild_max_last();
+
+    if (!range.permanent && range.expires < _next_expiry) {
+        _next_expiry = range.expires;
+    }
+}
+
+void Ip_block_list::rebuild_max_last() {
+    _max_last.resize(_ranges.size());
+
+    uint32_t max_last = 0;
+
+    for (size_t i = 0; i < _ranges.size(); ++i) {
+        max_last = std::max(max_last, _ranges[i].last);
+        _max_last[i] = max_last;
+    }
+}
+
+bool Ip_block_list::is_blocked(uint32_t ip) const {
+    if (_ranges.empty()) {
+        return false;
+    }
+
+    // first range that starts after the ip
+    auto it = std::upper_bound(_ranges.begin(), _ranges.end(), ip,
+        [](uint32_t ip, const Ip_block_range& r) { return ip < r.first; });
+
+    // walk back over ranges that can still cover the ip
+    for (int64_t i = (int64_t)(it - _ranges.begin()) - 1; i >= 0 && _max_last[i] >= ip; --i) {
+        const Ip_block_range& r = _ranges[i];
+
+        if (r.last >= ip && (r.permanent || r.expires > _now)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void Ip_block_list::update(std::chrono::time_point<std::chrono::high_resolution_clock>& now) {
+    _now = now;
+
+    if (now < _next_expiry) {
+        return;
+    }
+
+    _next_expiry = now + std::chrono::hours(24 * 365);
+
+    size_t num_before = _ranges.size();
+
+    _ranges.erase(std::remove_if(_ranges.begin(), _ranges.end(), [&](const Ip_block_range& r) {
+        return !r.permanent && r.expires <= now;
+    }), _ranges.end());
+
+    for (auto& r : _ranges) {
+        if (!r.permanent && r.expires < _next_expiry) {
+            _next_expiry = r.expires;
+        }
+    }
+
+    if (num_before != _ranges.size()) {
+        TRACE("[IP-BLOCK-LIST][UPDATE][Expired %d entries]\n", (int)(num_before - _ranges.size()));
+        rebuild_max_last();
+    }
+}
+
+bool Ip_block_list::try_add_connection(uint32_t ip) {
+    uint16_t& count = _connections_per_ip[ip];
+
+    if (_max_connections_per_ip != 0 && count >= _max_connections_per_ip) {
+        return false;
+    }
+
+    count++;
+
+    return true;
+}
+
+void Ip_block_list::remove_connection(uint32_t ip) {
+    auto it = _connections_per_ip.find(ip);
+
+    if (it == _connections_per_ip.end()) {
+        return;
+    }
+
+    if (--it->second == 0) {
+        _connections_per_ip.erase(it);
+    }
+}
+
+size_t Ip_block_list::size() const {
+    return _ranges.size();
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <unordered_map>
+
+// a flooding IP is blocked at least this long, a TTL of 0 would block it for good
+#define IP_BLOCK_TTL_MIN_SECONDS 10
+
+/// <summary>
+/// A single blocked range of IPv4 addresses (host byte order, inclusive)
+/// A single IP is stored as a /32 range
+/// </summary>
+struct Ip_block_range {
+    uint32_t    first;
+    uint32_t    last;
+    bool        permanent; // configured ranges never expire
+
+    std::chrono::time_point<std::chrono::high_resolution_clock> expires;
+};
+
+/// <summary>
+/// Block list shared by the TCP and UDP servers
+/// + Entries expire individually after their TTL instead of the whole list being wiped
+/// + CIDR ranges (10.0.0.0/8) are stored as inclusive [first, last] ranges
+/// + Ranges are kept sorted on first, together with a running max of last, so a
+///   lookup is a binary search followed by a short walk back over overlapping ranges
+/// + Keeps count of concurrent connections per IP so a single host cant eat all our sockets
+/// </summary>
+struct Ip_block_list {
+    Ip_block_list();
+
+    // default_ttl_seconds is raised to IP_BLOCK_TTL_MIN_SECONDS, the blocks of flooding IPs always expire
+    void configure(uint32_t default_ttl_seconds, uint16_t max_connections_per_ip, const std::string& ranges);
+
+    // block a single IP, ttl_seconds == 0 uses the default TTL
+    void block(uint32_t ip, uint32_t ttl_seconds = 0);
+
+    // block a CIDR range, ttl_seconds == 0 blocks the range permanently
+    void block_range(uint32_t ip, uint8_t prefix_len, uint32_t ttl_seconds);
+
+    // parse and block a "a.b.c.d/n" string
+    bool block_cidr(const std::string& cidr, uint32_t ttl_seconds);
+
+    bool is_blocked(uint32_t ip) const;
+
+    // call once per tick, drops expired entries
+    void update(std::chrono::time_point<std::chrono::high_resolution_clock>& now);
+
+    // returns false if the IP already has max_connections_per_ip open connections
+    bool try_add_connection(uint32_t ip);
+
+    void remove_connection(uint32_t ip);
+
+    size_t size() const;
+
+private:
+    void insert(const Ip_block_range& range);
+
+    void rebuild_max_last();
+
+    uint32_t _default_ttl_seconds;
+    uint16_t _max_connections_per_ip;
+
+    std::vector<Ip_block_range> _ranges;    // sorted on first
+    std::vector<uint32_t>       _max_last;  // _max_last[i] = max(_ranges[0..i].last)
+
+    std::unordered_map<uint32_t, uint16_t> _connections_per_ip;
+
+    std::chrono::time_point<std::chrono::high_resolution_clock> _now;
+    std::chrono::time_point<std::chrono::high_resolution_clock> _next_expiry;
+};
@@ -0,0 +1,202 @@
+#include "item_delta.h"
+
+#include "bitstream.h"
+#include "net_schema.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static inline uint32_t item_popcount(uint64_t word) {
+    uint32_t count = 0;
+
+    while (word != 0) {
+        word &= word - 1;
+        count++;
+    }
+
+    return count;
+}
+
+// the index of the lowest set bit, word must not be 0
+static inline uint32_t item_lowest_bit(uint64_t word) {
+#ifdef _MSC_VER
+    unsigned long bit;
+    _BitScanForward64(&bit, word);
+
+    return (uint32_t)bit;
+#else
+    return (uint32_t)__builtin_ctzll(word);
+#endif
+}
+
+// the number of items in a block, the last block of the scene can be partial
+static inline uint32_t item_block_size(uint32_t num_items, uint32_t block) {
+    uint32_t left = num_items - block * 64;
+
+    return left < 64 ? left : 64;
+}
+
+uint32_t Item_bitset::count() const {
+    uint32_t count = 0;
+
+    for (auto word : words) {
+        count += item_popcount(word);
+    }
+
+    return count;
+}
+
+void Item_changes::resize(uint32_t num_items) {
+    changed.resize(num_items);
+    changed_sequence.assign(num_items, sequence);
+    states.assign(num_items, 0);
+}
+
+void Item_changes::mark(uint16_t index, uint8_t states_) {
+    if (index >= states.size()) {
+        return;
+    }
+
+    states[index] = states_;
+    changed_sequence[index] = sequence;
+    changed.set(index);
+}
+
+void Item_changes::next_snapshot() {
+    changed.clear();
+    sequence++;
+}
+
+Item_baselines::Item_baselines() {
+    _ring.resize(ITEM_BASELINE_RING_SIZE);
+}
+
+void Item_baselines::reset(uint32_t num_items) {
+    dirty.resize(num_items);
+
+    for (auto& slot : _ring) {
+        slot.is_set = false;
+        slot.sent.resize(num_items);
+    }
+}
+
+void Item_baselines::add_changes(const Item_changes& changes) {
+    if (dirty.size != changes.changed.size) {
+        return;
+    }
+
+    for (size_t i = 0; i < dirty.words.size(); ++i) {
+        dirty.words[i] |= changes.changed.words[i];
+    }
+}
+
+void Item_baselines::store(uint16_t sequence, const Item_bitset& sent) {
+    Slot& slot = _ring[sequence % ITEM_BASELINE_RING_SIZE];
+
+    // assignment reuses the capacity of the slot
+    slot.sent.words = sent.words;
+    slot.sent.size = sent.size;
+    slot.sequence = sequence;
+    slot.is_set = true;
+}
+
+void Item_baselines::ack(uint16_t sequence, const Item_changes& changes) {
+    Slot& slot = _ring[sequence % ITEM_BASELINE_RING_SIZE];
+
+    // the slot has been overwritten by a newer snapshot, the items are still dirty and go out again
+    if (!slot.is_set || slot.sequence != sequence || slot.sent.size != dirty.size) {
+        return;
+    }
+
+    for (size_t w = 0; w < slot.sent.words.size(); ++w) {
+        uint64_t word = slot.sent.words[w] & dirty.words[w];
+
+        while (word != 0) {
+            uint32_t index = (uint32_t)w * 64 + item_lowest_bit(word);
+
+            word &= word - 1;
+
+            // changed again after the acked snapshot was written, the player has an old state
+            if (!sequence_greater_than(changes.changed_sequence[index], sequence)) {
+                dirty.reset(index);
+            }
+        }
+    }
+
+    // every ack is used once, a duplicate cant clear a later change
+    slot.is_set = false;
+}
+
+uint32_t item_snapshot_write(const Net_session_snapshot& header, const Item_changes& changes, const Item_bitset& dirty, uint32_t budget, Item_bitset& sent, std::vector<uint8_t>& data, uint32_t offset) {
+    uint32_t num_items = header.num_items;
+    uint32_t num_blocks = (num_items + 63) / 64;
+    uint32_t header_size = wire_min_size<Net_session_snapshot>();
+
+    if (sent.size != num_items) {
+        sent.resize(num_items);
+    }
+
+    sent.clear();
+
+    // pick the items in index order until the budget is used up, the rest stay dirty
+    int64_t bits_left = (int64_t)budget * 8 - (int64_t)header_size * 8 - num_blocks;
+
+    for (uint32_t b = 0; b < num_blocks && bits_left > 0 && dirty.size == num_items; ++b) {
+        uint64_t word = dirty.words[b];
+
+        if (word == 0) {
+            continue;
+        }
+
+        bits_left -= item_block_size(num_items, b);
+
+        while (word != 0 && bits_left >= 8) {
+            uint64_t lowest = word & (~word + 1);
+
+            sent.words[b] |= lowest;
+            word &= word - 1;
+            bits_left -= 8;
+        }
+    }
+
+    if (data.size() < offset + header_size) {
+        data.resize(offset + header_size);
+    }
+
+    wire_encode(header, &data[offset]);
+
+    Bit_writer writer(data, offset + header_size);
+
+    for (uint32_t b = 0; b < num_blocks; ++b) {
+        writer.write_bool(sent.words[b] != 0);
+    }
+
+    for (uint32_t b = 0; b < num_blocks; ++b) {
+        uint64_t word = sent.words[b];
+
+        if (word == 0) {
+            continue;
+        }
+
+        uint32_t bits = item_block_size(num_items, b);
+
+        writer.write_bits((uint32_t)word, bits < 32 ? bits : 32);
+
+        if (bits > 32) {
+            writer.write_bits((uint32_t)(word >> 32), bits - 32);
+        }
+    }
+
+    for (uint32_t b = 0; b < num_blocks; ++b) {
+        uint64_t word = sent.words[b];
+
+        while (word != 0) {
+            writer.write_bits(changes.states[b * 64 + item_lowest_bit(word)], 8);
+
+            word &= word - 1;
+        }
+    }
+
+    return header_size + writer.flush();
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "net_packet.h"
+
+#define ITEM_BASELINE_RING_SIZE 32
+
+/// <summary>
+/// A bit per scene item, 64 items to a word so empty parts of a large scene are skipped a word at a time
+/// </summary>
+struct Item_bitset {
+    Item_bitset() : size(0) {}
+
+    void resize(uint32_t num_items) {
+        size = num_items;
+        words.assign((num_items + 63) / 64, 0);
+    }
+
+    void set(uint32_t index) { words[index >> 6] |= (uint64_t)1 << (index & 63); }
+    void reset(uint32_t index) { words[index >> 6] &= ~((uint64_t)1 << (index & 63)); }
+    bool test(uint32_t index) const { return (words[index >> 6] >> (index & 63)) & 1; }
+
+    void clear() {
+        for (auto& word : words) {
+            word = 0;
+        }
+    }
+
+    bool any() const {
+        for (auto word : words) {
+            if (word != 0) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    uint32_t count() const;
+
+    std::vector<uint64_t> words;
+    uint32_t size;
+};
+
+/// <summary>
+/// The item state changes of a scene, shared by every player in the session
+/// + mark() when an item changes state
+/// + next_snapshot() once the snapshot of every player has been written
+/// the sequence of the snapshot an item last changed before is kept per item,
+/// so an ack of an older snapshot doesnt clear a change the player hasnt seen
+/// </summary>
+struct Item_changes {
+    Item_changes() : sequence(0) {}
+
+    void resize(uint32_t num_items);
+
+    void mark(uint16_t index, uint8_t states);
+
+    void next_snapshot();
+
+    // the sequence the next snapshot is sent with
+    uint16_t                sequence;
+
+    // changed since the last snapshot
+    Item_bitset             changed;
+
+    std::vector<uint16_t>   changed_sequence;
+    std::vector<uint8_t>    states;
+};
+
+/// <summary>
+/// Per player, the items whose latest state the player hasnt acked
+/// + add_changes() before writing a snapshot, the new changes become dirty
+/// + store() what was sent with a snapshot, items that didnt fit stay dirty for the next one
+/// + ack() clears the items of the acked snapshot that havent changed since it was sent
+/// the world init the player got when joining is the first baseline, so nothing is dirty after reset()
+/// </summary>
+struct Item_baselines {
+    Item_baselines();
+
+    void reset(uint32_t num_items);
+
+    void add_changes(const Item_changes& changes);
+
+    void store(uint16_t sequence, const Item_bitset& sent);
+
+    void ack(uint16_t sequence, const Item_changes& changes);
+
+    Item_bitset dirty;
+
+private:
+    struct Slot {
+        uint16_t    sequence;
+        bool        is_set;
+        Item_bitset sent;
+    };
+
+    std::vector<Slot> _ring;
+};
+
+/// <summary>
+/// Writes a Net_session_snapshot with the dirty items that fit in budget bytes,
+/// the items that were written are set in sent
+/// returns the number of bytes written
+///
+/// Wire format, after the Net_session_snapshot header:
+/// a bit per block of 64 items, set if the block has items in the snapshot,
+/// then a 64 bit mask for every set block (the last block only has a bit per item it holds),
+/// then the 8 bit states of the items in the masks, in index order
+/// the size follows the number of changed items, not the number of items in the scene
+/// </summary>
+uint32_t item_snapshot_write(const Net_session_snapshot& header, const Item_changes& changes, const Item_bitset& dirty, uint32_t budget, Item_bitset& sent, std::vector<uint8_t>& data, uint32_t offset);
@@ -0,0 +1,343 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <memory>
+
+#include "level.h"
+#include "trace.h"
+
+/// <summary>
+/// kpcook, cooks the text description of a level into the binary level file the slaves map
+///
+/// The description is in the style of the ini files, a section per thing and key:value lines
+///
+/// [LEVEL]
+/// bounds:-100 -10 -100 100 50 100
+/// [ITEM]
+/// id:1
+/// prefab:PulleySwitch             optional, the types of the prefab
+/// types:Switch Junction           ItemType names, added to the prefab
+/// states:Activated Switch_AND     ItemState names, what the item starts in
+/// inc:2 3                         up to two item ids
+/// out:4
+/// pos:3 0 -2
+/// [SPAWN]
+/// pos:0 0 5
+/// yaw:90
+/// team:1
+/// [TRIGGER]
+/// id:1
+/// item:4                          the item the volume activates
+/// min:-1 0 -1
+/// max:1 2 1
+/// [BOX]
+/// min:-100 -1 -100
+/// max:100 0 100
+/// </summary>
+
+enum class CookSection {
+    None,
+    Level,
+    Item,
+    Spawn,
+    Trigger,
+    Box
+};
+
+static const char* item_type_names[] = { "Junction", "Switch", "Openable", "Hackable", "Breakable", "MustBePoweredForActivate" };
+static const char* item_state_names[] = { "", "Power", "Activated", "", "Switch_AND", "", "", "", "Switch_OR" };
+static const char* prefab_names[] = { "HingedDoor", "PoweredHingedDoor", "DoubleSlidingDoor", "SingleSlidingDoor", "PulleySwitch", "PathPuzzleSwitch" };
+
+static bool read_floats(const std::string& value, float* out, int count) {
+    std::istringstream is(value);
+
+    for (int i = 0; i < count; ++i) {
+        if (!(is >> out[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool read_ids(const std::string& value, uint16_t* out, int count) {
+    std::istringstream is(value);
+    int id;
+    int i = 0;
+
+    while (is >> id) {
+        if (i == count || id <= 0 || id > 0xffff) {
+            return false;
+        }
+
+        out[i++] = (uint16_t)id;
+    }
+
+    return true;
+}
+
+// the index of the name is the bit
+static bool read_flags(const std::string& value, const char** names, int num_names, uint8_t& out) {
+    std::istringstream is(value);
+    std::string name;
+
+    while (is >> name) {
+        int found = -1;
+
+        for (int i = 0; i < num_names; ++i) {
+            if (name == names[i]) {
+                found = i;
+            }
+        }
+
+        // Switch_OR is bit 8 and doesnt fit in the states, the circuit treats a gate that isnt AND as OR
+        if (found < 0 || found > 7) {
+            return false;
+        }
+
+        out |= (uint8_t)(1u << found);
+    }
+
+    return true;
+}
+
+// the ids must be unique and the connections must be to items that exist
+static bool add_items(const std::string& in_path, const std::vector<Level_item>& items, Level& level) {
+    std::vector<uint8_t> used(0x10000, 0);
+
+    for (const Level_item& item : items) {
+        if (item.id == 0) {
+            printf("ERROR: %s, an item has no id\n", in_path.c_str());
+            return false;
+        }
+
+        if (used[item.id]) {
+            printf("ERROR: %s, item %d, the id is used by another item\n", in_path.c_str(), item.id);
+            return false;
+        }
+
+        used[item.id] = 1;
+    }
+
+    for (const Level_item& item : items) {
+        for (int i = 0; i < 2; ++i) {
+            if (item.inc[i] != 0 && !used[item.inc[i]]) {
+                printf("ERROR: %s, item %d, inc %d is not an item\n", in_path.c_str(), item.id, item.inc[i]);
+                return false;
+            }
+
+            if (item.out[i] != 0 && !used[item.out[i]]) {
+                printf("ERROR: %s, item %d, out %d is not an item\n", in_path.c_str(), item.id, item.out[i]);
+                return false;
+            }
+        }
+
+        level.add_item(item);
+    }
+
+    return true;
+}
+
+static bool cook(const std::string& in_path, Level& level) {
+    std::ifstream infile(in_path);
+
+    if (!infile.good()) {
+        printf("ERROR: level description: %s, not found\n", in_path.c_str());
+        return false;
+    }
+
+    CookSection current = CookSection::None;
+
+    // the items are added once every id is known, so the connections can be checked
+    std::vector<Level_item> items;
+
+    Level_item item;
+    Level_spawn spawn;
+    Level_trigger trigger;
+    Level_box box;
+
+    // adds what the section before described
+    auto flush = [&]() {
+        switch (current) {
+        case CookSection::Item: items.push_back(item); break;
+        case CookSection::Spawn: level.add_spawn(spawn); break;
+        case CookSection::Trigger: level.add_trigger(trigger); break;
+        case CookSection::Box: level.add_box(box); break;
+        default: break;
+        }
+
+        current = CookSection::None;
+    };
+
+    std::string line;
+    int line_number = 0;
+
+    while (getline(infile, line)) {
+        line_number++;
+
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+
+        if (line.length() <= 0 || line[0] == '#') {
+            continue;
+        }
+
+        if (line[0] == '[') {
+            flush();
+
+            if (line == "[LEVEL]") {
+                current = CookSection::Level;
+            }
+            else if (line == "[ITEM]") {
+                current = CookSection::Item;
+                item = Level_item();
+            }
+            else if (line == "[SPAWN]") {
+                current = CookSection::Spawn;
+                memset(&spawn, 0, sizeof(spawn));
+            }
+            else if (line == "[TRIGGER]") {
+                current = CookSection::Trigger;
+                memset(&trigger, 0, sizeof(trigger));
+            }
+            else if (line == "[BOX]") {
+                current = CookSection::Box;
+                memset(&box, 0, sizeof(box));
+            }
+            else {
+                printf("ERROR: %s:%d, unknown section %s\n", in_path.c_str(), line_number, line.c_str());
+                return false;
+            }
+
+            continue;
+        }
+
+        std::istringstream is_line(line);
+
+        std::string key;
+        std::string value;
+
+        getline(is_line, key, ':');
+        getline(is_line, value);
+
+        bool ok = false;
+
+        if (current == CookSection::Level && key == "bounds") {
+            float bounds[6];
+            ok = read_floats(value, bounds, 6);
+
+            if (ok) {
+                level.set_bounds(glm::vec3(bounds[0], bounds[1], bounds[2]), glm::vec3(bounds[3], bounds[4], bounds[5]));
+            }
+        }
+        else if (current == CookSection::Item) {
+            if (key == "id") {
+                ok = read_ids(value, &item.id, 1) && item.id != 0;
+            }
+            else if (key == "prefab") {
+                std::istringstream is(value);
+                std::string name;
+                is >> name;
+
+                for (int i = 0; i < (int)ItemPrefab::NumPrefabs; ++i) {
+                    if (name == prefab_names[i]) {
+                        item.types |= Level_item::from_prefab((ItemPrefab)i, item.id).types;
+                        ok = true;
+                    }
+                }
+            }
+            else if (key == "types") {
+                ok = read_flags(value, item_type_names, 6, item.types);
+            }
+            else if (key == "states") {
+                ok = read_flags(value, item_state_names, 9, item.states);
+            }
+            else if (key == "inc") {
+                ok = read_ids(value, item.inc, 2);
+            }
+            else if (key == "out") {
+                ok = read_ids(value, item.out, 2);
+            }
+            else if (key == "pos") {
+                ok = read_floats(value, item.pos, 3);
+            }
+        }
+        else if (current == CookSection::Spawn) {
+            if (key == "pos") {
+                ok = read_floats(value, spawn.pos, 3);
+            }
+            else if (key == "yaw") {
+                ok = read_floats(value, &spawn.yaw, 1);
+            }
+            else if (key == "team") {
+                spawn.team = (uint8_t)atoi(value.c_str());
+                ok = true;
+            }
+        }
+        else if (current == CookSection::Trigger) {
+            if (key == "id") {
+                ok = read_ids(value, &trigger.id, 1);
+            }
+            else if (key == "item") {
+                ok = read_ids(value, &trigger.item_id, 1);
+            }
+            else if (key == "min") {
+                ok = read_floats(value, trigger.min, 3);
+            }
+            else if (key == "max") {
+                ok = read_floats(value, trigger.max, 3);
+            }
+        }
+        else if (current == CookSection::Box) {
+            if (key == "min") {
+                ok = read_floats(value, box.min, 3);
+            }
+            else if (key == "max") {
+                ok = read_floats(value, box.max, 3);
+            }
+        }
+
+        if (!ok) {
+            printf("ERROR: %s:%d, invalid line %s\n", in_path.c_str(), line_number, line.c_str());
+            return false;
+        }
+    }
+
+    flush();
+
+    return add_items(in_path, items, level);
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3) {
+        TRACE("Usage: ./kpcook level.txt level.kplevel\n");
+        return 1;
+    }
+
+    Level level;
+
+    if (!cook(argv[1], level)) {
+        return 1;
+    }
+
+    level.build();
+
+    if (!level.save(argv[2])) {
+        TRACE("ERROR: unable to write %s\n", argv[2]);
+        return 1;
+    }
+
+    // what the slaves will see
+    if (Level::load(argv[2]) == nullptr) {
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,358 @@
+#include "level.h"
+
+#include <algorithm>
+#include <fstream>
+
+#include "trace.h"
+
+/// <summary>
+/// The defaults of the prefabs, indexed by ItemPrefab
+/// </summary>
+static const uint8_t prefab_types[(int)ItemPrefab::NumPrefabs] = {
+    (uint8_t)ItemType::Openable,                                                // HingedDoor
+    (uint8_t)ItemType::Openable | (uint8_t)ItemType::MustBePoweredForActivate,  // PoweredHingedDoor
+    (uint8_t)ItemType::Openable | (uint8_t)ItemType::MustBePoweredForActivate,  // DoubleSlidingDoor
+    (uint8_t)ItemType::Openable | (uint8_t)ItemType::MustBePoweredForActivate,  // SingleSlidingDoor
+    (uint8_t)ItemType::Switch,                                                  // PulleySwitch
+    (uint8_t)ItemType::Switch | (uint8_t)ItemType::Hackable                     // PathPuzzleSwitch
+};
+
+Level_item Level_item::from_prefab(ItemPrefab prefab, uint16_t id) {
+    Level_item item;
+    item.id = id;
+
+    if (prefab < ItemPrefab::NumPrefabs) {
+        item.types = prefab_types[(int)prefab];
+    }
+
+    return item;
+}
+
+Level::Level() :
+    _header(nullptr),
+    _data(nullptr),
+    _size(0),
+    _items(nullptr),
+    _ids(nullptr),
+    _initial_states(nullptr),
+    _spawns(nullptr),
+    _num_spawns(0),
+    _triggers(nullptr),
+    _num_triggers(0),
+    _boxes(nullptr),
+    _num_boxes(0) {
+
+    memset(_add_bounds, 0, sizeof(_add_bounds));
+}
+
+std::shared_ptr<const Level> Level::load(const std::string& path) {
+    auto level = std::make_shared<Level>();
+
+    if (!level->_mapping.open(path)) {
+        return nullptr;
+    }
+
+    if (!level->attach(level->_mapping.data(), level->_mapping.size())) {
+        TRACE("[LEVEL][LOAD][ERROR] %s is not a level file of version %d\n", path.c_str(), LEVEL_FILE_VERSION);
+        return nullptr;
+    }
+
+    TRACE("[LEVEL][LOAD] %s, %d items, %d spawns, %d triggers, %d boxes\n", path.c_str(),
+        level->num_items(), level->num_spawns(), level->num_triggers(), level->num_boxes());
+
+    return level;
+}
+
+bool Level::add_item(const Level_item& item) {
+    if (_add_items.size() >= LEVEL_MAX_ITEMS) {
+        TRACE("[LEVEL][ADD_ITEM] Too many items, %d dropped\n", item.id);
+        return false;
+    }
+
+    _add_items.push_back(item);
+
+    return true;
+}
+
+void Level::add_spawn(const Level_spawn& spawn) {
+    _add_spawns.push_back(spawn);
+}
+
+void Level::add_trigger(const Level_trigger& trigger) {
+    _add_triggers.push_back(trigger);
+}
+
+void Level::add_box(const Level_box& box) {
+    _add_boxes.push_back(box);
+}
+
+void Level::set_bounds(const glm::vec3& min, const glm::vec3& max) {
+    for (int i = 0; i < 3; ++i) {
+        _add_bounds[i] = min[i];
+        _add_bounds[3 + i] = max[i];
+    }
+}
+
+void Level::build() {
+    uint32_t num_items = (uint32_t)_add_items.size();
+
+    std::vector<uint32_t> ids(num_items);
+
+    for (uint32_t i = 0; i < num_items; ++i) {
+        ids[i] = ((uint32_t)_add_items[i].id << 16) | i;
+    }
+
+    std::sort(ids.begin(), ids.end());
+
+    _ids = ids.data();
+    _graph.num_items = num_items;
+
+    // the connections are taken from both the inc and the out of every item
+    Circuit_builder builder;
+    builder.begin(num_items);
+
+    for (uint32_t i = 0; i < num_items; ++i) {
+        builder.add_item((uint16_t)i, _add_items[i].types, _add_items[i].states);
+    }
+
+    for (uint32_t i = 0; i < num_items; ++i) {
+        const Level_item& item = _add_items[i];
+
+        for (int c = 0; c < 2; ++c) {
+            uint16_t out = item.out[c] != 0 ? find(item.out[c]) : CIRCUIT_NO_ITEM;
+            uint16_t inc = item.inc[c] != 0 ? find(item.inc[c]) : CIRCUIT_NO_ITEM;
+
+            if (out != CIRCUIT_NO_ITEM) {
+                builder.add_edge((uint16_t)i, out);
+            }
+
+            if (inc != CIRCUIT_NO_ITEM) {
+                builder.add_edge(inc, (uint16_t)i);
+            }
+        }
+    }
+
+    Circuit_graph graph;
+    builder.build(graph);
+
+    // the states the sessions start in are settled once here
+    Circuit circuit;
+    circuit.reset(&graph, builder.states.data());
+    circuit.settle();
+
+    // laid out like the file, every section aligned after the header
+    struct Source {
+        const void* data;
+        uint32_t    count;
+        uint32_t    elem_size;
+    };
+
+    Source sources[(int)LevelSection::NumSections] = {
+        { _add_items.data(), num_items, sizeof(Level_item) },
+        { ids.data(), num_items, sizeof(uint32_t) },
+        { circuit.states(), num_items, sizeof(uint8_t) },
+        { builder.types.data(), num_items, sizeof(uint8_t) },
+        { builder.gates.data(), num_items, sizeof(uint8_t) },
+        { builder.levels.data(), num_items, sizeof(uint16_t) },
+        { builder.out_start.data(), (uint32_t)builder.out_start.size(), sizeof(uint32_t) },
+        { builder.out.data(), (uint32_t)builder.out.size(), sizeof(uint16_t) },
+        { builder.in_start.data(), (uint32_t)builder.in_start.size(), sizeof(uint32_t) },
+        { builder.in.data(), (uint32_t)builder.in.size(), sizeof(uint16_t) },
+        { builder.loop_items.data(), (uint32_t)builder.loop_items.size(), sizeof(uint16_t) },
+        { _add_spawns.data(), (uint32_t)_add_spawns.size(), sizeof(Level_spawn) },
+        { _add_triggers.data(), (uint32_t)_add_triggers.size(), sizeof(Level_trigger) },
+        { _add_boxes.data(), (uint32_t)_add_boxes.size(), sizeof(Level_box) }
+    };
+
+    Level_file_header header;
+    memset(&header, 0, sizeof(header));
+
+    header.magic = LEVEL_FILE_MAGIC;
+    header.version = LEVEL_FILE_VERSION;
+    header.num_sections = (uint16_t)LevelSection::NumSections;
+    header.num_levels = graph.num_levels;
+    memcpy(header.bounds_min, &_add_bounds[0], 3 * sizeof(float));
+    memcpy(header.bounds_max, &_add_bounds[3], 3 * sizeof(float));
+
+    uint32_t offset = sizeof(Level_file_header);
+
+    for (int i = 0; i < (int)LevelSection::NumSections; ++i) {
+        offset = (offset + LEVEL_FILE_ALIGN - 1) & ~(LEVEL_FILE_ALIGN - 1);
+
+        header.sections[i].offset = offset;
+        header.sections[i].count = sources[i].count;
+        header.sections[i].elem_size = sources[i].elem_size;
+
+        offset += sources[i].count * sources[i].elem_size;
+    }
+
+    header.file_size = offset;
+
+    _image.assign((offset + 7) / 8, 0);
+
+    uint8_t* image = (uint8_t*)_image.data();
+
+    memcpy(image, &header, sizeof(header));
+
+    for (int i = 0; i < (int)LevelSection::NumSections; ++i) {
+        if (sources[i].count > 0) {
+            memcpy(image + header.sections[i].offset, sources[i].data, sources[i].count * sources[i].elem_size);
+        }
+    }
+
+    _add_items.clear();
+    _add_spawns.clear();
+    _add_triggers.clear();
+    _add_boxes.clear();
+
+    attach(image, offset);
+
+    TRACE("[LEVEL][BUILD] %d items, %d levels, %d in loops, %d bytes\n", num_items, graph.num_levels, graph.num_loop_items, offset);
+}
+
+bool Level::save(const std::string& path) const {
+    if (_data == nullptr) {
+        return false;
+    }
+
+    std::ofstream outfile(path, std::ios::binary);
+
+    if (!outfile.good()) {
+        TRACE("[LEVEL][SAVE][ERROR] Unable to open %s\n", path.c_str());
+        return false;
+    }
+
+    outfile.write((const char*)_data, _size);
+
+    return outfile.good();
+}
+
+template<typename T>
+const T* Level::section(LevelSection id, uint32_t& count) const {
+    const Level_file_section& section = _header->sections[(int)id];
+
+    if (section.elem_size != sizeof(T) || section.offset % LEVEL_FILE_ALIGN != 0 ||
+        (uint64_t)section.offset + (uint64_t)section.count * sizeof(T) > _size) {
+        return nullptr;
+    }
+
+    count = section.count;
+
+    return (const T*)(_data + section.offset);
+}
+
+bool Level::attach(const uint8_t* data, uint32_t size) {
+    if (size < sizeof(Level_file_header)) {
+        return false;
+    }
+
+    const Level_file_header* header = (const Level_file_header*)data;
+
+    if (header->magic != LEVEL_FILE_MAGIC || header->version != LEVEL_FILE_VERSION ||
+        header->num_sections != (uint16_t)LevelSection::NumSections || header->file_size != size) {
+        return false;
+    }
+
+    _header = header;
+    _data = data;
+    _size = size;
+
+    // the sections are checked to be in the file and to have the counts that go together,
+    // what is in them is trusted as the cooker wrote it
+    uint32_t num_items = 0;
+    uint32_t counts[(int)LevelSection::NumSections];
+
+    const Level_item* items = section<Level_item>(LevelSection::Items, num_items);
+    const uint32_t* ids = section<uint32_t>(LevelSection::Ids, counts[(int)LevelSection::Ids]);
+    const uint8_t* initial_states = section<uint8_t>(LevelSection::InitialStates, counts[(int)LevelSection::InitialStates]);
+    const uint8_t* types = section<uint8_t>(LevelSection::Types, counts[(int)LevelSection::Types]);
+    const uint8_t* gates = section<uint8_t>(LevelSection::Gates, counts[(int)LevelSection::Gates]);
+    const uint16_t* levels = section<uint16_t>(LevelSection::Levels, counts[(int)LevelSection::Levels]);
+    const uint32_t* out_start = section<uint32_t>(LevelSection::OutStart, counts[(int)LevelSection::OutStart]);
+    const uint16_t* out = section<uint16_t>(LevelSection::Out, counts[(int)LevelSection::Out]);
+    const uint32_t* in_start = section<uint32_t>(LevelSection::InStart, counts[(int)LevelSection::InStart]);
+    const uint16_t* in = section<uint16_t>(LevelSection::In, counts[(int)LevelSection::In]);
+    const uint16_t* loop_items = section<uint16_t>(LevelSection::LoopItems, counts[(int)LevelSection::LoopItems]);
+
+    uint32_t num_spawns = 0;
+    uint32_t num_triggers = 0;
+    uint32_t num_boxes = 0;
+
+    const Level_spawn* spawns = section<Level_spawn>(LevelSection::Spawns, num_spawns);
+    const Level_trigger* triggers = section<Level_trigger>(LevelSection::Triggers, num_triggers);
+    const Level_box* boxes = section<Level_box>(LevelSection::Boxes, num_boxes);
+
+    if (items == nullptr || ids == nullptr || initial_states == nullptr || types == nullptr || gates == nullptr ||
+        levels == nullptr || out_start == nullptr || out == nullptr || in_start == nullptr || in == nullptr ||
+        loop_items == nullptr || spawns == nullptr || triggers == nullptr || boxes == nullptr) {
+        return false;
+    }
+
+    if (num_items > LEVEL_MAX_ITEMS ||
+        counts[(int)LevelSection::Ids] != num_items ||
+        counts[(int)LevelSection::InitialStates] != num_items ||
+        counts[(int)LevelSection::Types] != num_items ||
+        counts[(int)LevelSection::Gates] != num_items ||
+        counts[(int)LevelSection::Levels] != num_items ||
+        counts[(int)LevelSection::OutStart] != num_items + 1 ||
+        counts[(int)LevelSection::InStart] != num_items + 1 ||
+        out_start[num_items] != counts[(int)LevelSection::Out] ||
+        in_start[num_items] != counts[(int)LevelSection::In] ||
+        counts[(int)LevelSection::LoopItems] > num_items) {
+        return false;
+    }
+
+    _items = items;
+    _ids = ids;
+    _initial_states = initial_states;
+
+    _graph.num_items = num_items;
+    _graph.num_levels = header->num_levels;
+    _graph.num_loop_items = counts[(int)LevelSection::LoopItems];
+    _graph.types = types;
+    _graph.gates = gates;
+    _graph.levels = levels;
+    _graph.out_start = out_start;
+    _graph.out = out;
+    _graph.in_start = in_start;
+    _graph.in = in;
+    _graph.loop_items = loop_items;
+
+    _spawns = spawns;
+    _num_spawns = num_spawns;
+    _triggers = triggers;
+    _num_triggers = num_triggers;
+    _boxes = boxes;
+    _num_boxes = num_boxes;
+
+    return true;
+}
+
+uint16_t Level::find(uint16_t id) const {
+    const uint32_t* end = _ids + _graph.num_items;
+    const uint32_t* it = std::lower_bound(_ids, end, (uint32_t)id << 16);
+
+    if (it == end || (*it >> 16) != id) {
+        return CIRCUIT_NO_ITEM;
+    }
+
+    return (uint16_t)(*it & 0xffff);
+}
+
+bool Level::has_bounds() const {
+    if (_header == nullptr) {
+        return false;
+    }
+
+    return _header->bounds_min[0] < _header->bounds_max[0] &&
+        _header->bounds_min[1] < _header->bounds_max[1] &&
+        _header->bounds_min[2] < _header->bounds_max[2];
+}
+
+glm::vec3 Level::bounds_min() const {
+    return glm::vec3(_header->bounds_min[0], _header->bounds_min[1], _header->bounds_min[2]);
+}
+
+glm::vec3 Level::bounds_max() const {
+    return glm::vec3(_header->bounds_max[0], _header->bounds_max[1], _header->bounds_max[2]);
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <glm/glm.hpp>
+
+#include "circuit.h"
+#include "level_file.h"
+#include "file_mapping.h"
+
+#define LEVEL_MAX_ITEMS 0xfffe // an item index of 0xffff is CIRCUIT_NO_ITEM
+
+enum class ItemPrefab {
+    HingedDoor = 0,
+    PoweredHingedDoor,
+    DoubleSlidingDoor,
+    SingleSlidingDoor,
+    PulleySwitch,
+    PathPuzzleSwitch,
+    NumPrefabs
+};
+
+/// <summary>
+/// An item as the level defines it, the states are the ones it starts in
+/// the connections are item ids, 0 is no connection
+/// </summary>
+struct Level_item {
+    uint16_t    id;
+    uint8_t     types; // ItemType
+    uint8_t     states; // ItemState
+
+    uint16_t    inc[2];
+    uint16_t    out[2];
+
+    float       pos[3]; // where a player interacts with it
+
+    Level_item() : id(0), types(0), states(0) {
+        memset(inc, 0, 2 * sizeof(uint16_t));
+        memset(out, 0, 2 * sizeof(uint16_t));
+        memset(pos, 0, 3 * sizeof(float));
+    }
+
+    // the types and states of the prefab, without connections
+    static Level_item from_prefab(ItemPrefab prefab, uint16_t id);
+};
+
+static_assert(sizeof(Level_item) == 24, "Level_item is part of the file format");
+
+/// <summary>
+/// The static data of a level, loaded once per process and shared by every session playing it
+/// + load() maps a cooked level file, nothing is parsed or copied
+/// + or add_item(), add_spawn(), add_trigger(), add_box() and set_bounds(), then build()
+///   compiles the wiring and lays everything out the way it is in the file, save() writes it
+/// Once it is loaded or built the level is read only, the sessions keep their states in a Circuit
+/// on top of graph() that starts from a copy of initial_states()
+/// </summary>
+struct Level {
+    Level();
+
+    static std::shared_ptr<const Level> load(const std::string& path);
+
+    bool add_item(const Level_item& item);
+
+    void add_spawn(const Level_spawn& spawn);
+
+    void add_trigger(const Level_trigger& trigger);
+
+    void add_box(const Level_box& box);
+
+    void set_bounds(const glm::vec3& min, const glm::vec3& max);
+
+    void build();
+
+    bool save(const std::string& path) const;
+
+    uint32_t num_items() const { return _graph.num_items; }
+
+    const Level_item& item(uint16_t index) const { return _items[index]; }
+
+    // the index of the item with the id, CIRCUIT_NO_ITEM if there is none
+    uint16_t find(uint16_t id) const;
+
+    const Circuit_graph& graph() const { return _graph; }
+
+    // settled, indexed by the item index
+    const uint8_t* initial_states() const { return _initial_states; }
+
+    uint32_t num_spawns() const { return _num_spawns; }
+    const Level_spawn& spawn(uint32_t index) const { return _spawns[index]; }
+
+    uint32_t num_triggers() const { return _num_triggers; }
+    const Level_trigger& trigger(uint32_t index) const { return _triggers[index]; }
+
+    uint32_t num_boxes() const { return _num_boxes; }
+    const Level_box& box(uint32_t index) const { return _boxes[index]; }
+
+    // false if the level doesnt set them
+    bool has_bounds() const;
+
+    glm::vec3 bounds_min() const;
+    glm::vec3 bounds_max() const;
+
+private:
+    // everything points into the file
+    Level(const Level&);
+    Level& operator=(const Level&);
+
+    // checks the header and the section table and points everything into the file
+    bool attach(const uint8_t* data, uint32_t size);
+
+    template<typename T>
+    const T* section(LevelSection id, uint32_t& count) const;
+
+    // what build() is given, cleared once it has been laid out
+    std::vector<Level_item>     _add_items;
+    std::vector<Level_spawn>    _add_spawns;
+    std::vector<Level_trigger>  _add_triggers;
+    std::vector<Level_box>      _add_boxes;
+    float                       _add_bounds[6];
+
+    // the file, built in _image or mapped
+    std::vector<uint64_t>       _image;
+    File_mapping                _mapping;
+
+    const Level_file_header*    _header;
+    const uint8_t*              _data;
+    uint32_t                    _size;
+
+    const Level_item*           _items;
+    const uint32_t*             _ids;
+    const uint8_t*              _initial_states;
+    Circuit_graph               _graph;
+
+    const Level_spawn*          _spawns;
+    uint32_t                    _num_spawns;
+    const Level_trigger*        _triggers;
+    uint32_t                    _num_triggers;
+    const Level_box*            _boxes;
+    uint32_t                    _num_boxes;
+};
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdint.h>
+
+#define LEVEL_FILE_MAGIC    0x4c56504b  // "KPVL"
+#define LEVEL_FILE_VERSION  1
+#define LEVEL_FILE_ALIGN    8           // every section starts on it
+
+/// <summary>
+/// The sections of a level file, new sections go at the end with a new version
+/// the circuit sections are the compiled Circuit_graph so a session can use them as they are
+/// </summary>
+enum class LevelSection : uint32_t {
+    Items = 0,      // Level_item, indexed by the item index
+    Ids,            // uint32_t, the item id in the high half and the index in the low, sorted
+    InitialStates,  // uint8_t per item, settled
+    Types,          // the Circuit_graph arrays
+    Gates,
+    Levels,
+    OutStart,
+    Out,
+    InStart,
+    In,
+    LoopItems,
+    Spawns,         // Level_spawn
+    Triggers,       // Level_trigger
+    Boxes,          // Level_box, the static collision
+    NumSections
+};
+
+/// <summary>
+/// A point a player can start at
+/// </summary>
+struct Level_spawn {
+    float       pos[3];
+    float       yaw;    // degrees
+    uint8_t     team;
+    uint8_t     pad[3];
+};
+
+/// <summary>
+/// A volume that activates an item when a player enters it
+/// </summary>
+struct Level_trigger {
+    uint16_t    id;
+    uint16_t    item_id; // 0 is no item
+    float       min[3];
+    float       max[3];
+};
+
+/// <summary>
+/// An axis aligned box of static collision
+/// </summary>
+struct Level_box {
+    float       min[3];
+    float       max[3];
+};
+
+#pragma pack(push, 1)
+
+/// <summary>
+/// Where a section is, offset from the start of the file, count elements of elem_size bytes
+/// </summary>
+struct Level_file_section {
+    uint32_t    offset;
+    uint32_t    count;
+    uint32_t    elem_size;
+};
+
+/// <summary>
+/// The start of a level file
+/// The file is little endian and has no pointers, it is used in place where it is mapped
+/// </summary>
+struct Level_file_header {
+    uint32_t    magic;
+    uint16_t    version;
+    uint16_t    num_sections;
+    uint32_t    file_size;
+
+    float       bounds_min[3];
+    float       bounds_max[3];
+
+    uint32_t    num_levels; // of the circuit
+
+    Level_file_section sections[(int)LevelSection::NumSections];
+};
+
+#pragma pack(pop)
+
+static_assert(sizeof(Level_spawn) == 20, "Level_spawn is part of the file format");
+static_assert(sizeof(Level_trigger) == 28, "Level_trigger is part of the file format");
+static_assert(sizeof(Level_box) == 24, "Level_box is part of the file format");
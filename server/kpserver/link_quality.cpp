@@ -0,0 +1,222 @@
+#include "link_quality.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include "trace.h"
+
+#define LINK_RTT_ALPHA      0.125f
+#define LINK_RTTVAR_BETA    0.25f
+#define LINK_LOSS_ALPHA     0.05f
+#define LINK_RATE_STEPS     10.0f   // the number of good evaluations to go from min to max
+
+typedef std::chrono::high_resolution_clock Link_clock;
+
+Link_quality::Link_quality() {
+    _sent.resize(LINK_HISTORY_SIZE);
+
+    reset();
+}
+
+void Link_quality::configure(const Link_settings& settings) {
+    _settings = settings;
+
+    if (_settings.max_rate < _settings.min_rate) {
+        _settings.max_rate = _settings.min_rate;
+    }
+
+    if (_settings.max_budget < _settings.min_budget) {
+        _settings.max_budget = _settings.min_budget;
+    }
+
+    reset();
+}
+
+void Link_quality::reset() {
+    for (auto& sent : _sent) {
+        sent.pending = false;
+    }
+
+    _has_rtt = false;
+    _srtt = 0.0f;
+    _rttvar = 0.0f;
+    _loss = 0.0f;
+
+    _has_sync = false;
+    _last_sync_transit = 0;
+    _sync_jitter = 0.0f;
+
+    // start optimistic, a bad link is found within a couple of seconds
+    _rate = _settings.max_rate;
+    _budget = (float)_settings.max_budget;
+
+    _congested = false;
+    _recovery_seconds = LINK_RECOVERY_SECONDS_MIN;
+
+    _next_send = Link_clock::time_point();
+    _next_eval = Link_clock::time_point();
+    _state_changed = Link_clock::time_point();
+}
+
+void Link_quality::on_sent(uint16_t sequence, std::chrono::time_point<std::chrono::high_resolution_clock>& now) {
+    Sent_packet& slot = _sent[sequence % LINK_HISTORY_SIZE];
+
+    // still waiting on the one we overwrite, it is not coming
+    if (slot.pending) {
+        add_loss_sample(true);
+    }
+
+    slot.sequence = sequence;
+    slot.pending = true;
+    slot.time = now;
+
+    auto interval = std::chrono::duration_cast<Link_clock::duration>(std::chrono::duration<float>(1.0f / _rate));
+
+    _next_send += interval;
+
+    if (_next_send < now) {
+        _next_send = now;
+    }
+}
+
+void Link_quality::on_acked(uint16_t sequence, std::chrono::time_point<std::chrono::high_resolution_clock>& now) {
+    Sent_packet& slot = _sent[sequence % LINK_HISTORY_SIZE];
+
+    if (!slot.pending || slot.sequence != sequence) {
+        return;
+    }
+
+    slot.pending = false;
+    add_loss_sample(false);
+
+    float sample = std::chrono::duration<float, std::milli>(now - slot.time).count();
+
+    if (!_has_rtt) {
+        _srtt = sample;
+        _rttvar = sample / 2.0f;
+        _has_rtt = true;
+        return;
+    }
+
+    _rttvar = (1.0f - LINK_RTTVAR_BETA) * _rttvar + LINK_RTTVAR_BETA * fabsf(_srtt - sample);
+    _srtt = (1.0f - LINK_RTT_ALPHA) * _srtt + LINK_RTT_ALPHA * sample;
+}
+
+void Link_quality::on_sync_request(uint64_t client_time, uint64_t server_time) {
+    // the clocks are not synced, but the change in transit time between two requests is the jitter
+    int64_t transit = (int64_t)(server_time - client_time);
+
+    if (_has_sync) {
+        int64_t d = transit - _last_sync_transit;
+        float d_ms = std::chrono::duration<float, std::milli>(Link_clock::duration(d < 0 ? -d : d)).count();
+
+        _sync_jitter += (d_ms - _sync_jitter) / 16.0f;
+    }
+
+    _last_sync_transit = transit;
+    _has_sync = true;
+}
+
+void Link_quality::add_loss_sample(bool lost) {
+    _loss = (1.0f - LINK_LOSS_ALPHA) * _loss + LINK_LOSS_ALPHA * (lost ? 1.0f : 0.0f);
+}
+
+void Link_quality::update(std::chrono::time_point<std::chrono::high_resolution_clock>& now) {
+    // give the ack a generous window before we call it lost, at least 100 ms and at most a second
+    float timeout_ms = _has_rtt ? _srtt + 4.0f * _rttvar : 1000.0f;
+
+    timeout_ms = std::min(std::max(timeout_ms, 100.0f), 1000.0f);
+
+    auto timeout = std::chrono::duration_cast<Link_clock::duration>(std::chrono::duration<float, std::milli>(timeout_ms));
+
+    for (auto& sent : _sent) {
+        if (sent.pending && now - sent.time > timeout) {
+            sent.pending = false;
+            add_loss_sample(true);
+        }
+    }
+
+    if (now >= _next_eval) {
+        _next_eval = now + std::chrono::duration_cast<Link_clock::duration>(std::chrono::duration<float>(LINK_EVAL_SECONDS));
+
+        evaluate(now);
+    }
+}
+
+void Link_quality::evaluate(std::chrono::time_point<std::chrono::high_resolution_clock>& now) {
+    float jitter = jitter_ms();
+    float in_state = std::chrono::duration<float>(now - _state_changed).count();
+
+    bool bad = _loss > LINK_BAD_LOSS || (_has_rtt && _srtt > LINK_BAD_RTT_MS) || jitter > LINK_BAD_JITTER_MS;
+    bool good = _loss < LINK_GOOD_LOSS && (!_has_rtt || _srtt < LINK_GOOD_RTT_MS) && jitter < LINK_BAD_JITTER_MS / 2.0f;
+
+    if (bad) {
+        if (!_congested) {
+            // went bad again shortly after we trusted it, make it wait longer next time
+            if (in_state < _recovery_seconds * 2.0f) {
+                _recovery_seconds = std::min(_recovery_seconds * 2.0f, LINK_RECOVERY_SECONDS_MAX);
+            }
+
+            _congested = true;
+            _state_changed = now;
+
+            TRACE("[LINK][CONGESTED][rtt: %.1f][jitter: %.1f][loss: %.3f]\n", _srtt, jitter, _loss);
+        }
+
+        _rate = std::max(_rate * 0.5f, _settings.min_rate);
+        _budget = std::max(_budget * 0.5f, (float)_settings.min_budget);
+
+        return;
+    }
+
+    if (!good) {
+        return;
+    }
+
+    if (_congested) {
+        if (in_state < _recovery_seconds) {
+            return;
+        }
+
+        _congested = false;
+        _state_changed = now;
+
+        TRACE("[LINK][RECOVERED][rtt: %.1f][loss: %.3f]\n", _srtt, _loss);
+    }
+    else if (in_state > LINK_RECOVERY_SECONDS_MAX / 6.0f) {
+        // stable for a while, forgive it
+        _recovery_seconds = std::max(_recovery_seconds * 0.5f, LINK_RECOVERY_SECONDS_MIN);
+        _state_changed = now;
+    }
+
+    _rate = std::min(_rate + (_settings.max_rate - _settings.min_rate) / LINK_RATE_STEPS, _settings.max_rate);
+    _budget = std::min(_budget + (float)(_settings.max_budget - _settings.min_budget) / LINK_RATE_STEPS, (float)_settings.max_budget);
+}
+
+bool Link_quality::is_send_due(std::chrono::time_point<std::chrono::high_resolution_clock>& now) const {
+    return now >= _next_send;
+}
+
+float Link_quality::rtt_ms() const {
+    return _srtt;
+}
+
+float Link_quality::jitter_ms() const {
+    return std::max(_rttvar, _sync_jitter);
+}
+
+float Link_quality::loss() const {
+    return _loss;
+}
+
+float Link_quality::send_rate() const {
+    return _rate;
+}
+
+uint32_t Link_quality::budget() const {
+    return (uint32_t)_budget;
+}
+
+bool Link_quality::is_congested() const {
+    return _congested;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <chrono>
+
+#define LINK_HISTORY_SIZE           64      // sent snapshots we wait for an ack on
+#define LINK_EVAL_SECONDS           1.0f    // how often the send rate is adjusted
+#define LINK_BAD_LOSS               0.05f   // over this we back off
+#define LINK_GOOD_LOSS              0.01f   // under this we may speed up
+#define LINK_BAD_RTT_MS             250.0f
+#define LINK_GOOD_RTT_MS            150.0f
+#define LINK_BAD_JITTER_MS          50.0f
+#define LINK_RECOVERY_SECONDS_MIN   2.0f    // how long a link must be good before we leave the congested state
+#define LINK_RECOVERY_SECONDS_MAX   60.0f
+
+struct Link_settings {
+    float       min_rate; // snapshots per second
+    float       max_rate;
+    uint32_t    min_budget; // bytes per snapshot
+    uint32_t    max_budget; // keep it below the common internet MTU
+
+    Link_settings() : min_rate(5.0f), max_rate(20.0f), min_budget(300), max_budget(1200) {}
+};
+
+/// <summary>
+/// Estimates the quality of the UDP link to a client and picks a snapshot rate and budget for it
+/// + RTT and jitter are smoothed like TCP does it (RFC 6298) from the time between
+///   sending a snapshot and receiving its ack
+/// + NetPlayerSyncTimeRequest timestamps give the interarrival jitter (RFC 3550)
+///   of the client to server direction
+/// + A snapshot that has not been acked in time is counted as lost
+///
+/// The rate is halved when the link goes bad and raised in small steps when it is good.
+/// In between nothing changes, that gap is the hysteresis. A link that goes bad again
+/// soon after recovering has to stay good twice as long before it is trusted again
+/// </summary>
+struct Link_quality {
+    Link_quality();
+
+    void configure(const Link_settings& settings);
+
+    void reset();
+
+    void on_sent(uint16_t sequence, std::chrono::time_point<std::chrono::high_resolution_clock>& now);
+
+    void on_acked(uint16_t sequence, std::chrono::time_point<std::chrono::high_resolution_clock>& now);
+
+    // client_time and server_time are high_resolution_clock counts, same as Net_player_sync_time_request
+    void on_sync_request(uint64_t client_time, uint64_t server_time);
+
+    // counts timed out snapshots as lost and adjusts the rate, call before is_send_due
+    void update(std::chrono::time_point<std::chrono::high_resolution_clock>& now);
+
+    bool is_send_due(std::chrono::time_point<std::chrono::high_resolution_clock>& now) const;
+
+    float rtt_ms() const;
+    float jitter_ms() const;
+    float loss() const;
+    float send_rate() const;
+    uint32_t budget() const;
+    bool is_congested() const;
+
+private:
+    struct Sent_packet {
+        uint16_t    sequence;
+        bool        pending;
+
+        std::chrono::time_point<std::chrono::high_resolution_clock> time;
+    };
+
+    void add_loss_sample(bool lost);
+
+    void evaluate(std::chrono::time_point<std::chrono::high_resolution_clock>& now);
+
+    Link_settings _settings;
+
+    std::vector<Sent_packet> _sent;
+
+    bool        _has_rtt;
+    float       _srtt;
+    float       _rttvar;
+    float       _loss;
+
+    bool        _has_sync;
+    int64_t     _last_sync_transit;
+    float       _sync_jitter;
+
+    float       _rate;
+    float       _budget;
+
+    bool        _congested;
+    float       _recovery_seconds;
+
+    std::chrono::time_point<std::chrono::high_resolution_clock> _next_send;
+    std::chrono::time_point<std::chrono::high_resolution_clock> _next_eval;
+    std::chrono::time_point<std::chrono::high_resolution_clock> _state_changed;
+};
@@ -0,0 +1,199 @@
+#include "lz.h"
+
+#include <string.h>
+
+static inline uint32_t lz_read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+
+    return v;
+}
+
+static inline uint32_t lz_hash(uint32_t v) {
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+// a length that doesnt fit in the 4 bits of the token continues in bytes of 255
+static inline uint8_t* lz_put_length(uint8_t* out, uint32_t len) {
+    while (len >= 255) {
+        *out++ = 255;
+        len -= 255;
+    }
+
+    *out++ = (uint8_t)len;
+
+    return out;
+}
+
+static inline uint8_t* lz_put_literals(uint8_t* out, uint8_t* token, const uint8_t* literals, uint32_t len) {
+    if (len >= 15) {
+        *token = 15 << 4;
+        out = lz_put_length(out, len - 15);
+    }
+    else {
+        *token = (uint8_t)(len << 4);
+    }
+
+    memcpy(out, literals, len);
+
+    return out + len;
+}
+
+// limit stops a long run of 255 from wrapping the length around
+static inline bool lz_get_length(const uint8_t* in, uint32_t len, uint32_t& ip, uint32_t& value, uint32_t limit) {
+    uint8_t b;
+
+    do {
+        if (ip >= len || value > limit) {
+            return false;
+        }
+
+        b = in[ip++];
+        value += b;
+    } while (b == 255);
+
+    return true;
+}
+
+uint32_t lz_compress_bound(uint32_t len) {
+    return len + len / 255 + 16;
+}
+
+uint32_t lz_compress(const uint8_t* in, uint32_t len, uint8_t* out) {
+    uint8_t* op = out;
+    uint32_t anchor = 0;
+
+    if (len > LZ_MATCH_LIMIT) {
+        uint32_t table[1 << LZ_HASH_BITS];
+        memset(table, 0, sizeof(table));
+
+        uint32_t ip = 1;
+        uint32_t match_end = len - LZ_LAST_LITERALS;
+        uint32_t search_end = len - LZ_MATCH_LIMIT;
+
+        table[lz_hash(lz_read32(in))] = 0;
+
+        while (ip < search_end) {
+            uint32_t seq = lz_read32(in + ip);
+            uint32_t h = lz_hash(seq);
+            uint32_t ref = table[h];
+
+            table[h] = ip;
+
+            if (ip - ref > LZ_MAX_OFFSET || lz_read32(in + ref) != seq) {
+                // step faster through data that doesnt compress
+                ip += 1 + ((ip - anchor) >> 6);
+                continue;
+            }
+
+            // extend the match backwards into the literals, then forwards
+            while (ip > anchor && ref > 0 && in[ip - 1] == in[ref - 1]) {
+                ip--;
+                ref--;
+            }
+
+            uint32_t match_len = LZ_MIN_MATCH;
+
+            while (ip + match_len < match_end && in[ip + match_len] == in[ref + match_len]) {
+                match_len++;
+            }
+
+            uint8_t* token = op++;
+
+            op = lz_put_literals(op, token, in + anchor, ip - anchor);
+
+            uint32_t offset = ip - ref;
+
+            *op++ = (uint8_t)offset;
+            *op++ = (uint8_t)(offset >> 8);
+
+            if (match_len - LZ_MIN_MATCH >= 15) {
+                *token |= 15;
+                op = lz_put_length(op, match_len - LZ_MIN_MATCH - 15);
+            }
+            else {
+                *token |= (uint8_t)(match_len - LZ_MIN_MATCH);
+            }
+
+            ip += match_len;
+            anchor = ip;
+
+            // the position just before the next search, helps runs of the same pattern
+            if (ip - 2 < search_end) {
+                table[lz_hash(lz_read32(in + ip - 2))] = ip - 2;
+            }
+        }
+    }
+
+    uint8_t* token = op++;
+
+    op = lz_put_literals(op, token, in + anchor, len - anchor);
+
+    return (uint32_t)(op - out);
+}
+
+bool lz_decompress(const uint8_t* in, uint32_t len, uint8_t* out, uint32_t out_len) {
+    uint32_t ip = 0;
+    uint32_t op = 0;
+
+    while (ip < len) {
+        uint8_t token = in[ip++];
+        uint32_t literals = token >> 4;
+
+        if (literals == 15 && !lz_get_length(in, len, ip, literals, out_len)) {
+            return false;
+        }
+
+        if (literals > len - ip || literals > out_len - op) {
+            return false;
+        }
+
+        memcpy(out + op, in + ip, literals);
+        ip += literals;
+        op += literals;
+
+        // the last sequence has no match
+        if (ip == len) {
+            break;
+        }
+
+        if (len - ip < 2) {
+            return false;
+        }
+
+        uint32_t offset = in[ip] | ((uint32_t)in[ip + 1] << 8);
+        ip += 2;
+
+        if (offset == 0 || offset > op) {
+            return false;
+        }
+
+        uint32_t match_len = token & 15;
+
+        if (match_len == 15 && !lz_get_length(in, len, ip, match_len, out_len)) {
+            return false;
+        }
+
+        match_len += LZ_MIN_MATCH;
+
+        if (match_len > out_len - op) {
+            return false;
+        }
+
+        const uint8_t* ref = out + op - offset;
+
+        if (offset >= match_len) {
+            memcpy(out + op, ref, match_len);
+        }
+        else {
+            // the match overlaps what it writes, a short offset repeats a pattern
+            for (uint32_t i = 0; i < match_len; ++i) {
+                out[op + i] = ref[i];
+            }
+        }
+
+        op += match_len;
+    }
+
+    return op == out_len;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdint.h>
+
+// the LZ4 block format, so clients can use any LZ4 block decoder
+#define LZ_MIN_MATCH        4
+#define LZ_MAX_OFFSET       65535
+#define LZ_LAST_LITERALS    5       // a block always ends with at least this many literals
+#define LZ_MATCH_LIMIT      12      // no match starts closer than this to the end
+#define LZ_HASH_BITS        12
+
+/// <summary>
+/// The largest compressed size of len bytes, for sizing the output buffer
+/// </summary>
+uint32_t lz_compress_bound(uint32_t len);
+
+/// <summary>
+/// Greedy single pass compression with a hash table of the last position of every 4 byte sequence
+/// + out must have room for lz_compress_bound(len) bytes
+/// + returns the compressed size, which can be larger than len for data that doesnt repeat
+/// </summary>
+uint32_t lz_compress(const uint8_t* in, uint32_t len, uint8_t* out);
+
+/// <summary>
+/// Decompresses a block into exactly out_len bytes
+/// every length and offset is checked, returns false on data that would read or write out of bounds
+/// or that doesnt decompress to out_len bytes
+/// </summary>
+bool lz_decompress(const uint8_t* in, uint32_t len, uint8_t* out, uint32_t out_len);
@@ -38,6 +38,7 @@
 #include "net_master.h"
 #include "net_slave.h"
 #include "process_stats.h"
+#include "bench.h"
 #include "trace.h"
 
 // -ini C:\projects\kapitan_srv\server\build\kpserver\Debug\slave_eu1.ini
@@ -47,10 +48,15 @@ int main(int argc , char *argv[])
 
     char ini_filename[128];
 
+    if (argc == 2 && !strcmp(argv[1], "-bench")) {
+        return run_benchmarks();
+    }
+
     if (argc < 3) {
         TRACE("ERROR: Invalid argument count\n");
         
         TRACE("Usage: ./kpserver -ini master_eu.ini [-v]\n");
+        TRACE("       ./kpserver -bench\n");
         return 0;
     }
 
@@ -102,6 +108,11 @@ int main(int argc , char *argv[])
             return 0;
         }
 
+        if (!slave_node->load_level()) {
+            TRACE("Quitting because the level could not be loaded\n");
+            return 0;
+        }
+
         slave_node->setup_sessions();
         slave_node->print_sessions();
 
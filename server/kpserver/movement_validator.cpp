@@ -0,0 +1,154 @@
+#include "movement_validator.h"
+
+#include <cmath>
+
+#include "trace.h"
+
+#ifdef MOVEMENT_SSE
+#include <emmintrin.h>
+#endif
+
+void Movement_counters::print(const char* name) const {
+    TRACE("--- Movement (%s): %llu checked, %llu clamped, %llu rejected\n", name,
+        (unsigned long long)checked, (unsigned long long)clamped, (unsigned long long)rejected);
+}
+
+Movement_validator::Movement_validator() {
+
+}
+
+void Movement_validator::reset(uint32_t num_players) {
+    uint32_t size = (num_players + 3) & ~3u;
+
+    _x.assign(size, 0.0f);
+    _y.assign(size, 0.0f);
+    _z.assign(size, 0.0f);
+    _t.assign(size, 0);
+
+    _last_x.assign(size, 0.0f);
+    _last_y.assign(size, 0.0f);
+    _last_z.assign(size, 0.0f);
+    _last_t.assign(size, 0);
+    _has_last.assign(size, 0);
+
+    _over.assign(size, 0);
+    _results.assign(size, (uint8_t)MovementResult::None);
+    _pending.clear();
+
+    counters = Movement_counters();
+}
+
+void Movement_validator::push(uint8_t player, const glm::vec3& pos, uint32_t timestamp) {
+    if (player >= _results.size()) {
+        return;
+    }
+
+    if (_results[player] == (uint8_t)MovementResult::None) {
+        _results[player] = (uint8_t)MovementResult::Accepted;
+        _pending.push_back(player);
+    }
+
+    _x[player] = pos.x;
+    _y[player] = pos.y;
+    _z[player] = pos.z;
+    _t[player] = (int32_t)timestamp;
+}
+
+void Movement_validator::find_over(float speed) {
+    uint32_t size = (uint32_t)_x.size();
+
+#ifdef MOVEMENT_SSE
+    const __m128 ms = _mm_set1_ps(speed / 1000.0f);
+    const __m128 slack = _mm_set1_ps(MOVEMENT_SLACK);
+    const __m128 zero = _mm_setzero_ps();
+
+    for (uint32_t i = 0; i < size; i += 4) {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(&_x[i]), _mm_loadu_ps(&_last_x[i]));
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(&_y[i]), _mm_loadu_ps(&_last_y[i]));
+        __m128 dz = _mm_sub_ps(_mm_loadu_ps(&_z[i]), _mm_loadu_ps(&_last_z[i]));
+
+        __m128 dist_sq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+        __m128i dt = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)&_t[i]), _mm_loadu_si128((const __m128i*)&_last_t[i]));
+        __m128 elapsed = _mm_max_ps(_mm_cvtepi32_ps(dt), zero);
+
+        __m128 allowed = _mm_add_ps(_mm_mul_ps(elapsed, ms), slack);
+
+        int mask = _mm_movemask_ps(_mm_cmpgt_ps(dist_sq, _mm_mul_ps(allowed, allowed)));
+
+        _over[i] = mask & 1;
+        _over[i + 1] = (mask >> 1) & 1;
+        _over[i + 2] = (mask >> 2) & 1;
+        _over[i + 3] = (mask >> 3) & 1;
+    }
+#else
+    for (uint32_t i = 0; i < size; ++i) {
+        float dx = _x[i] - _last_x[i];
+        float dy = _y[i] - _last_y[i];
+        float dz = _z[i] - _last_z[i];
+
+        int32_t dt = _t[i] - _last_t[i];
+        float allowed = (dt > 0 ? (float)dt : 0.0f) * (speed / 1000.0f) + MOVEMENT_SLACK;
+
+        _over[i] = dx * dx + dy * dy + dz * dz > allowed * allowed;
+    }
+#endif
+}
+
+void Movement_validator::validate(float max_speed) {
+    if (_pending.empty()) {
+        return;
+    }
+
+    float speed = max_speed * MOVEMENT_TOLERANCE;
+
+    find_over(speed);
+
+    for (uint8_t player : _pending) {
+        counters.checked++;
+
+        if (_has_last[player] && _over[player]) {
+            float dx = _x[player] - _last_x[player];
+            float dy = _y[player] - _last_y[player];
+            float dz = _z[player] - _last_z[player];
+
+            int32_t dt = _t[player] - _last_t[player];
+            float allowed = (dt > 0 ? (float)dt : 0.0f) * (speed / 1000.0f) + MOVEMENT_SLACK;
+            float dist = std::sqrt(dx * dx + dy * dy + dz * dz);
+
+            if (dist > allowed * MOVEMENT_REJECT_FACTOR) {
+                _results[player] = (uint8_t)MovementResult::Rejected;
+                counters.rejected++;
+
+                // the time isnt moved either, the next update gets the allowance of the whole gap
+                _x[player] = _last_x[player];
+                _y[player] = _last_y[player];
+                _z[player] = _last_z[player];
+                continue;
+            }
+
+            float scale = allowed / dist;
+
+            _x[player] = _last_x[player] + dx * scale;
+            _y[player] = _last_y[player] + dy * scale;
+            _z[player] = _last_z[player] + dz * scale;
+
+            _results[player] = (uint8_t)MovementResult::Clamped;
+            counters.clamped++;
+        }
+
+        _last_x[player] = _x[player];
+        _last_y[player] = _y[player];
+        _last_z[player] = _z[player];
+        _last_t[player] = _t[player];
+        _has_last[player] = 1;
+    }
+}
+
+void Movement_validator::clear() {
+    for (uint8_t player : _pending) {
+        _results[player] = (uint8_t)MovementResult::None;
+    }
+
+    _pending.clear();
+}
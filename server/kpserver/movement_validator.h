@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MOVEMENT_SSE 1
+#endif
+
+#define MOVEMENT_TOLERANCE      1.25f   // allowed speed over the rule, the arrival times jitter
+#define MOVEMENT_SLACK          0.25f   // meters, allowed on top for quantization and a late packet
+#define MOVEMENT_REJECT_FACTOR  4.0f    // moving further than this times the allowed distance is a teleport
+
+enum class MovementResult : uint8_t {
+    None = 0, // no update this tick
+    Accepted,
+    Clamped,  // moved too far, the position is pulled back to the allowed distance
+    Rejected  // teleported, the player stays where it was
+};
+
+struct Movement_counters {
+    uint64_t    checked;
+    uint64_t    clamped;
+    uint64_t    rejected;
+
+    Movement_counters() : checked(0), clamped(0), rejected(0) {}
+
+    void print(const char* name) const;
+};
+
+/// <summary>
+/// Checks the position updates of a session against the max speed once per tick
+/// + push() the latest position of a player as it arrives, a newer one in the same tick replaces it
+/// + validate() checks every pending update against max speed * time since the last accepted position,
+///   the positions are kept as separate arrays so four players are checked at a time,
+///   only the players over the limit take the scalar path
+/// + results() is the pending players and what happened to them, clear() when they have been applied
+/// The first position of a player is accepted as is
+/// </summary>
+struct Movement_validator {
+    Movement_validator();
+
+    void reset(uint32_t num_players);
+
+    void push(uint8_t player, const glm::vec3& pos, uint32_t timestamp);
+
+    // max_speed in meters per second
+    void validate(float max_speed);
+
+    void clear();
+
+    // the players with an update this tick
+    const std::vector<uint8_t>& pending() const { return _pending; }
+
+    MovementResult result(uint8_t player) const { return (MovementResult)_results[player]; }
+
+    // the validated position of the player
+    glm::vec3 position(uint8_t player) const { return glm::vec3(_x[player], _y[player], _z[player]); }
+
+    uint32_t timestamp(uint8_t player) const { return (uint32_t)_t[player]; }
+
+    Movement_counters counters;
+
+private:
+    // sets _over for the players that moved further than allowed, pending or not
+    void find_over(float speed);
+
+    // padded to a multiple of four players
+    std::vector<float>      _x;
+    std::vector<float>      _y;
+    std::vector<float>      _z;
+    std::vector<int32_t>    _t;
+
+    std::vector<float>      _last_x;
+    std::vector<float>      _last_y;
+    std::vector<float>      _last_z;
+    std::vector<int32_t>    _last_t;
+    std::vector<uint8_t>    _has_last;
+
+    std::vector<uint8_t>    _over;
+    std::vector<uint8_t>    _results;
+    std::vector<uint8_t>    _pending;
+};
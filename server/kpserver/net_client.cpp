@@ -18,23 +18,32 @@
 
 #define BUFFER_SIZE 2000
 
+#include "net_schema.h"
+#include "lz.h"
 #include "trace.h"
 #include "udp_server.h"
 
 uint32_t Net_client::__ID_COUNTER = 0;
 
 Net_client::Net_client(Net_client_info info_, uint32_t id) 
-	:	_num_flooded_packets(0),
+	:	info(info_),
+		_fragment_group(0),
 		_tcp_data_buffer_pos(0),
+		_tcp_raw_pos(0),
+		_tcp_dense_len(0),
+		_tcp_compression(NET_COMPRESSION_NONE),
 		_udp_data_buffer_pos(0),
 		_id(id),
-		info(info_),
+		_num_flooded_packets(0),
+		_num_dropped_messages(0),
 		_net_session_id(0) {
 	
 	info.client_id = id;
 
 	_tcp_data_buffer.resize(BUFFER_SIZE);
 	_udp_data_buffer.resize(BUFFER_SIZE);
+	_datagram_buffer.resize(UDP_MAX_DATAGRAM_SIZE);
+	_fragment_buffer.resize(sizeof(Net_fragment_header) + FRAGMENT_SIZE);
 }
 
 /**
@@ -61,27 +70,198 @@ void Net_client::generate_udp_code() {
 	info.udp_code = rand() % USHRT_MAX;
 }
 
+/// <summary>
+/// Messages that LZ cant shrink, the world init is an array of ids that count up
+/// with no 4 byte sequence repeated, compressing it would only cost CPU
+/// </summary>
+static bool is_tcp_compressible(uint8_t type) {
+	return type != (uint8_t)MsgType::NetSessionWorldInit;
+}
+
 void Net_client::add_tcp_data(void* data, uint32_t len) {
 	TRACE("Adding message to client: %d, %d\n", ((uint8_t*)data)[0], len);
+
+	// the world state can be larger than the buffer when it falls back to TCP
+	if (_tcp_data_buffer.size() < _tcp_data_buffer_pos + len) {
+		_tcp_data_buffer.resize(_tcp_data_buffer_pos + len);
+	}
+
+	// kept out of the compressed frames, so they are skipped without trying
+	if (_tcp_compression != NET_COMPRESSION_NONE && len > 0 && !is_tcp_compressible(((uint8_t*)data)[0])) {
+		if (!_tcp_dense_ranges.empty() && _tcp_dense_ranges.back() == _tcp_data_buffer_pos) {
+			_tcp_dense_ranges.back() += len;
+		}
+		else {
+			_tcp_dense_ranges.push_back(_tcp_data_buffer_pos);
+			_tcp_dense_ranges.push_back(_tcp_data_buffer_pos + len);
+		}
+
+		_tcp_dense_len += len;
+	}
+
 	memcpy(&_tcp_data_buffer[_tcp_data_buffer_pos], data, len);
 
 	_tcp_data_buffer_pos += len;
 }
 
 void Net_client::add_udp_data(void* data, uint32_t len) {
+	if (len > UDP_MAX_DATAGRAM_SIZE - sizeof(Net_datagram_header)) {
+		add_fragmented((const uint8_t*)data, len, [&](const uint8_t* fragment, uint32_t size) {
+			add_udp_data((void*)fragment, size);
+		});
+
+		return;
+	}
+
+	if (_udp_data_buffer.size() < _udp_data_buffer_pos + len) {
+		_udp_data_buffer.resize(_udp_data_buffer_pos + len);
+	}
+
 	memcpy(&_udp_data_buffer[_udp_data_buffer_pos], data, len);
 
 	_udp_data_buffer_pos += len;
+	_udp_message_sizes.push_back(len);
+}
+
+void Net_client::add_reliable_data(void* data, uint32_t len, ReliableChannel channel) {
+	if (!info.udp_established) {
+		add_tcp_data(data, len);
+		return;
+	}
+
+	if (len > UDP_MAX_DATAGRAM_SIZE - sizeof(Net_datagram_header) - sizeof(Net_reliable_header)) {
+		add_fragmented((const uint8_t*)data, len, [&](const uint8_t* fragment, uint32_t size) {
+			reliable.send(channel, fragment, size);
+		});
+
+		return;
+	}
+
+	reliable.send(channel, data, len);
+}
+
+bool Net_client::add_fragmented(const uint8_t* data, uint32_t len, std::function<void(const uint8_t*, uint32_t)> send) {
+	uint32_t count = fragment_count(len);
+
+	if (count == 0) {
+		TRACE("[NET-CLIENT][FRAGMENT][ERROR][Message too large: %d]\n", len);
+		return false;
+	}
+
+	Net_fragment_header header;
+	header.group_id = _fragment_group++;
+	header.num_fragments = (uint8_t)count;
+
+	for (uint32_t i = 0; i < count; ++i) {
+		uint32_t off = i * (uint32_t)FRAGMENT_SIZE;
+
+		header.fragment_index = (uint8_t)i;
+		header.length = (uint16_t)(len - off < FRAGMENT_SIZE ? len - off : FRAGMENT_SIZE);
+		wire_encode(header, _fragment_buffer, 0);
+
+		memcpy(&_fragment_buffer[sizeof(Net_fragment_header)], data + off, header.length);
+
+		send(&_fragment_buffer[0], sizeof(Net_fragment_header) + header.length);
+	}
+
+	return true;
+}
+
+void Net_client::enable_tcp_compression(uint8_t algorithms) {
+	uint8_t algorithm = (algorithms & NET_COMPRESSION_LZ) ? NET_COMPRESSION_LZ : NET_COMPRESSION_NONE;
+
+	Net_compression_config config(algorithm, NET_TCP_COMPRESS_THRESHOLD);
+
+	add_tcp_message(config);
+
+	// the client only knows about the compression once it has read the reply
+	_tcp_raw_pos = _tcp_data_buffer_pos;
+	_tcp_dense_ranges.clear();
+	_tcp_dense_len = 0;
+	_tcp_compression = algorithm;
+
+	TRACE("[NET-CLIENT][COMPRESSION][%d][algorithm: %d]\n", _id, algorithm);
+}
+
+bool Net_client::append_tcp_frame(uint32_t start, uint32_t end, bool compress, uint32_t& len) {
+	uint32_t raw_len = end - start;
+	uint32_t header_size = wire_min_size<Net_compressed_frame>();
+
+	if (_tcp_frame_buffer.size() < len + header_size + lz_compress_bound(raw_len)) {
+		_tcp_frame_buffer.resize(len + header_size + lz_compress_bound(raw_len));
+	}
+
+	if (compress && raw_len >= NET_TCP_COMPRESS_THRESHOLD) {
+		Net_compressed_frame frame;
+		frame.raw_length = raw_len;
+		frame.length = lz_compress(&_tcp_data_buffer[start], raw_len, &_tcp_frame_buffer[len + header_size]);
+
+		if (header_size + frame.length < raw_len) {
+			wire_encode(frame, &_tcp_frame_buffer[len]);
+			len += header_size + frame.length;
+
+			return true;
+		}
+	}
+
+	memcpy(&_tcp_frame_buffer[len], &_tcp_data_buffer[start], raw_len);
+	len += raw_len;
+
+	return false;
+}
+
+/// <summary>
+/// The messages queued before compression was enabled and the dense messages go as they are,
+/// the runs of messages between the dense ones are compressed into a frame each
+/// </summary>
+const uint8_t* Net_client::get_tcp_frame(uint32_t& len) {
+	len = _tcp_data_buffer_pos;
+
+	uint32_t compressible_len = _tcp_data_buffer_pos - _tcp_raw_pos - _tcp_dense_len;
+
+	if (_tcp_compression != NET_COMPRESSION_LZ || compressible_len < NET_TCP_COMPRESS_THRESHOLD) {
+		return &_tcp_data_buffer[0];
+	}
+
+	uint32_t frame_len = 0;
+	uint32_t pos = _tcp_raw_pos;
+	bool compressed = append_tcp_frame(0, _tcp_raw_pos, false, frame_len);
+
+	for (size_t i = 0; i < _tcp_dense_ranges.size(); i += 2) {
+		compressed |= append_tcp_frame(pos, _tcp_dense_ranges[i], true, frame_len);
+		append_tcp_frame(_tcp_dense_ranges[i], _tcp_dense_ranges[i + 1], false, frame_len);
+
+		pos = _tcp_dense_ranges[i + 1];
+	}
+
+	compressed |= append_tcp_frame(pos, _tcp_data_buffer_pos, true, frame_len);
+
+	if (!compressed) {
+		return &_tcp_data_buffer[0];
+	}
+
+	len = frame_len;
+
+	return &_tcp_frame_buffer[0];
+}
+
+void Net_client::clear_tcp_data() {
+	_tcp_data_buffer_pos = 0;
+	_tcp_raw_pos = 0;
+	_tcp_dense_ranges.clear();
+	_tcp_dense_len = 0;
 }
 
 void Net_client::send_tcp_data() {
 	
 	int result;
 	uint32_t pos = 0;
-	int32_t len = (int32_t)_tcp_data_buffer_pos;
+	uint32_t frame_len = 0;
+	const uint8_t* data = get_tcp_frame(frame_len);
+	int32_t len = (int32_t)frame_len;
 
 	while (len > 0) {
-		result = send(info.tcp_socket, (const char*)&_tcp_data_buffer[pos], len, 0);
+		result = send(info.tcp_socket, (const char*)&data[pos], len, 0);
 		
 		if (result == SOCKET_ERROR) {
 			/*result = WSAGetLastError();
@@ -90,7 +270,7 @@ void Net_client::send_tcp_data() {
 				// ignore
 			}
 			*/
-			_tcp_data_buffer_pos = 0;
+			clear_tcp_data();
 			return;
 		}
 		else {
@@ -99,26 +279,76 @@ void Net_client::send_tcp_data() {
 		}
 	}
 
-	_tcp_data_buffer_pos = 0;
+	clear_tcp_data();
 }
 
-void Net_client::send_udp_data(Udp_server* server) {
-	
-	if (_udp_data_buffer_pos == 0) { return; }
+/// <summary>
+/// Packs everything queued for the client this tick into as few datagrams as possible
+/// + Every datagram starts with a Net_datagram_header so the acks ride along
+/// + Reliable messages that are due go first, then the unreliable messages
+///   fill the space that is left, first fit, so a large snapshot doesnt push
+///   the small messages behind it into a datagram of their own
+/// + No datagram is larger than UDP_MAX_DATAGRAM_SIZE
+/// </summary>
+void Net_client::send_udp_data(Udp_server* server, std::chrono::time_point<std::chrono::high_resolution_clock>& now) {
+	if (!info.udp_established) {
+		return;
+	}
+
+	// resend after the smoothed RTT plus four deviations, like TCP
+	float resend_ms = link.rtt_ms() + 4.0f * link.jitter_ms();
+
+	resend_ms = resend_ms < 100.0f ? 100.0f : (resend_ms > 1000.0f ? 1000.0f : resend_ms);
+
+	size_t num_unreliable = _udp_message_sizes.size();
+	size_t unreliable_left = num_unreliable;
+
+	_udp_message_sent.assign(num_unreliable, 0);
+
+	for (int i = 0; i < NET_MAX_DATAGRAMS_PER_TICK; ++i) {
+		if (unreliable_left == 0 && !reliable.wants_to_send(now, resend_ms)) {
+			break;
+		}
 
-	int result = 0;
+		uint32_t size = reliable.write_packet(_datagram_buffer, 0, UDP_MAX_DATAGRAM_SIZE, now, resend_ms);
+		uint32_t msg_pos = 0;
 
+		for (size_t m = 0; m < num_unreliable && unreliable_left > 0; ++m) {
+			uint32_t msg_size = _udp_message_sizes[m];
 
-	TRACE("[NET-CLIENT][UDP OUT][%d]\n", _udp_data_buffer_pos);
+			if (!_udp_message_sent[m] && size + msg_size <= UDP_MAX_DATAGRAM_SIZE) {
+				memcpy(&_datagram_buffer[size], &_udp_data_buffer[msg_pos], msg_size);
+				size += msg_size;
+
+				_udp_message_sent[m] = 1;
+				unreliable_left--;
+			}
+
+			msg_pos += msg_size;
+		}
+
+		server->send_client(this, _datagram_buffer, size);
+	}
+
+	// unreliable messages are stale by the next tick, they arent carried over
+	if (unreliable_left > 0) {
+		_num_dropped_messages += unreliable_left;
+
+		TRACE("[NET-CLIENT][SEND-UDP][%d][Unreliable messages dropped: %d, total: %llu]\n", _id, (int)unreliable_left, (unsigned long long)_num_dropped_messages);
+	}
 
-	server->send_client(this, _udp_data_buffer, _udp_data_buffer_pos);
 	_udp_data_buffer_pos = 0;
+	_udp_message_sizes.clear();
 }
 
 uint32_t Net_client::get_id() const {
 	return _id;
 }
 
+uint64_t Net_client::get_num_dropped_messages() const {
+	return _num_dropped_messages;
+}
+
 /// <summary>
 /// Checks if the client is sending packets at a good rate
 /// </summary>
@@ -4,6 +4,12 @@
 #include <string>
 #include <vector>
 #include <chrono>
+#include <functional>
+
+#include "link_quality.h"
+#include "reliable_endpoint.h"
+#include "fragment.h"
+#include "net_schema.h"
 
 #ifdef WIN32
 
@@ -47,6 +53,13 @@ enum class NetClientType {
 
 #define MSG_BUF_SIZE 20000
 
+// TCP sends smaller than this arent worth compressing, the lobby replies are mostly a few bytes
+#define NET_TCP_COMPRESS_THRESHOLD 256
+
+// bounds the datagrams send_udp_data sends per tick so a huge backlog cant stall the tick,
+// the unreliable messages that dont fit are dropped
+#define NET_MAX_DATAGRAMS_PER_TICK 16
+
 struct Net_client_info {
 	Net_client_info() {
 		ip = "";
@@ -60,6 +73,7 @@ struct Net_client_info {
 		udp_established = false;
 		quick_hash = 0;
 		player_short_id = 0;
+		protocol_version = NET_PROTOCOL_VERSION_MIN;
 		memset(username, 0, 64);
 	}
 
@@ -80,6 +94,7 @@ struct Net_client_info {
 	uint8_t				player_short_id;
 	uint16_t			udp_code;
 	uint16_t			udp_port;
+	uint8_t				protocol_version;	// settled on in the handshake, the messages are written and read in it
 	char				username[64];
 
 };
@@ -93,12 +108,52 @@ struct Net_client {
 	virtual ~Net_client();
 
 	void add_tcp_data(void* data, uint32_t len);
+	// unreliable, data must be a complete message, it is coalesced with the other messages of the tick
+	// messages larger than a datagram are fragmented, if one fragment is lost the message is lost
 	void add_udp_data(void* data, uint32_t len);
 
+	// in game events, sent reliably over UDP once it is established, over TCP until then
+	// messages larger than a datagram are fragmented and each fragment is acked on its own
+	void add_reliable_data(void* data, uint32_t len, ReliableChannel channel = ReliableChannel::Ordered);
+
+	// the same as the add_*_data above for a message with a wire schema,
+	// encoded in the protocol version of the client
+	template<typename T>
+	void add_tcp_message(const T& msg) {
+		uint32_t len = wire_encode(msg, _message_buffer, 0, info.protocol_version);
+
+		add_tcp_data(&_message_buffer[0], len);
+	}
+
+	template<typename T>
+	void add_udp_message(const T& msg) {
+		uint32_t len = wire_encode(msg, _message_buffer, 0, info.protocol_version);
+
+		add_udp_data(&_message_buffer[0], len);
+	}
+
+	template<typename T>
+	void add_reliable_message(const T& msg, ReliableChannel channel = ReliableChannel::Ordered) {
+		uint32_t len = wire_encode(msg, _message_buffer, 0, info.protocol_version);
+
+		add_reliable_data(&_message_buffer[0], len, channel);
+	}
+
+	// answers a Net_compression_request, the TCP data queued after the reply is compressed
+	// when the client can decompress it
+	void enable_tcp_compression(uint8_t algorithms);
+
 	SOCKET get_tcp_socket() const;
 
+	// the queued TCP data as it goes on the wire, with the messages worth compressing
+	// in Net_compressed_frames when the client asked for it
+	const uint8_t* get_tcp_frame(uint32_t& len);
+
+	// drops the queued TCP data once it is sent
+	void clear_tcp_data();
+
 	void send_tcp_data();
-	void send_udp_data(Udp_server* server);
+	void send_udp_data(Udp_server* server, std::chrono::time_point<std::chrono::high_resolution_clock>& now);
 
 	std::string get_ip() const;
 
@@ -110,10 +165,21 @@ struct Net_client {
 
 	uint32_t get_id() const;
 
+	uint64_t get_num_dropped_messages() const;
+
 	bool log_activity();
 	
 	Net_client_info     info;
 
+	// RTT, jitter and loss of the UDP link, decides how often and how much we send
+	Link_quality		link;
+
+	// sequence numbers, acks and resends of the UDP connection
+	Reliable_endpoint	reliable;
+
+	// fragmented messages from the client
+	Fragment_reassembly	fragments;
+
 	void reset_session();
 
 	bool is_in_session() const;
@@ -123,15 +189,34 @@ struct Net_client {
 	uint32_t get_session_id() const;
 
 private:
+	// splits data into fragments, each passed to send as a complete message
+	bool add_fragmented(const uint8_t* data, uint32_t len, std::function<void(const uint8_t*, uint32_t)> send);
+
+	// appends the queued TCP data from start to end to the frame at len,
+	// in a Net_compressed_frame when compress is set and it gets smaller, returns true if it did
+	bool append_tcp_frame(uint32_t start, uint32_t end, bool compress, uint32_t& len);
 
 	std::vector<uint8_t>	_tcp_data_buffer;
 	std::vector<uint8_t>	_udp_data_buffer;
+	std::vector<uint32_t>	_udp_message_sizes;	// the unreliable messages in _udp_data_buffer
+	std::vector<uint8_t>	_udp_message_sent;
+	std::vector<uint8_t>	_datagram_buffer;
+	std::vector<uint8_t>	_fragment_buffer;
+	std::vector<uint8_t>	_tcp_frame_buffer;
+	std::vector<uint8_t>	_message_buffer;	// a message being encoded before it is queued
+
+	uint16_t				_fragment_group;
 
 	uint32_t				_tcp_data_buffer_pos;
+	uint32_t				_tcp_raw_pos;		// queued before compression was enabled, sent as it is
+	std::vector<uint32_t>	_tcp_dense_ranges;	// start and end of the queued messages that dont compress
+	uint32_t				_tcp_dense_len;
+	uint8_t					_tcp_compression;
 	uint32_t				_udp_data_buffer_pos;
 
 	uint32_t				_id;
 	int						_num_flooded_packets;
+	uint64_t				_num_dropped_messages;	// unreliable messages that didnt fit in NET_MAX_DATAGRAMS_PER_TICK
 
 	uint32_t				_net_session_id;
 	
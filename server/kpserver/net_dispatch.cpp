@@ -0,0 +1,44 @@
+#include "net_dispatch.h"
+
+#include <string.h>
+
+#include "trace.h"
+
+Net_message_counters::Net_message_counters() {
+    reset();
+}
+
+void Net_message_counters::reset() {
+    memset(received, 0, sizeof(received));
+    memset(bytes, 0, sizeof(bytes));
+    memset(rejected, 0, sizeof(rejected));
+    unknown = 0;
+}
+
+void Net_message_counters::print(const char* name) const {
+    TRACE("--- Messages received (%s)\n", name);
+
+    for (uint32_t i = 0; i < NET_NUM_MSG_TYPES; ++i) {
+        if (received[i] == 0 && rejected[i] == 0) {
+            continue;
+        }
+
+        TRACE("   | type %u: %llu received, %llu bytes, %llu rejected\n", i, (unsigned long long)received[i], (unsigned long long)bytes[i], (unsigned long long)rejected[i]);
+    }
+
+    TRACE("   | unknown: %llu\n", (unsigned long long)unknown);
+}
+
+NetAuth net_client_auth(const Net_client* client) {
+    if (client == NULL) {
+        return NetAuth::Master;
+    }
+
+    switch (client->info.type) {
+        case NetClientType::Unauthenticated: return NetAuth::Unauthenticated;
+        case NetClientType::Player: return NetAuth::Player;
+        case NetClientType::SlaveNode: return NetAuth::Slave;
+    }
+
+    return NetAuth::None;
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <stdint.h>
+#include <initializer_list>
+#include <type_traits>
+
+#include "net_packet.h"
+#include "net_client.h"
+#include "packet_view.h"
+#include "net_schema.h"
+
+#define NET_NUM_MSG_TYPES ((uint32_t)MsgType::NumMsgTypes)
+
+// what a message may arrive on, reliable UDP messages are delivered as TCP messages
+#define NET_CHANNEL_TCP 1
+#define NET_CHANNEL_UDP 2
+
+/// <summary>
+/// Who is allowed to send a message
+/// </summary>
+enum class NetAuth : uint8_t {
+    None = 0, // not registered
+    Unauthenticated,
+    Player,
+    Slave,
+    Master // the connection a slave has to the master, there is no Net_client for it
+};
+
+enum class NetDispatchResult {
+    Done = 0,       // every message was handled
+    Stopped,        // a handler stopped the reading, the client may have been disconnected
+    Unknown,        // a message this node has no handler for
+    NotAllowed,     // wrong channel or wrong auth state
+    Truncated
+};
+
+/// <summary>
+/// One entry in the registry
+/// handle reads the message, sent at the protocol version of the connection, from the reader
+/// and returns false to stop reading the rest
+/// </summary>
+template<typename Node>
+struct Net_handler {
+    MsgType     type;
+    uint32_t    size;       // the smallest wire size of any version, 0 for variable length messages that the handler bounds checks
+    uint8_t     channels;
+    NetAuth     auth;
+    bool        (*handle)(Node& node, Net_client* client, Packet_reader& reader, uint8_t version);
+};
+
+template<typename Node, typename T, bool (Node::*F)(Net_client*, const T&)>
+bool net_handle_message(Node& node, Net_client* client, Packet_reader& reader, uint8_t version) {
+    // only used when the message cant be read in place, the fields that arent on the wire stay zero
+    T storage{};
+
+    const T* msg = wire_view(reader, storage, version);
+
+    return msg != NULL && (node.*F)(client, *msg);
+}
+
+template<typename Node, bool (Node::*F)(Net_client*, Packet_reader&)>
+bool net_handle_stream(Node& node, Net_client* client, Packet_reader& reader, uint8_t) {
+    return (node.*F)(client, reader);
+}
+
+/// <summary>
+/// Registers a message T with a wire schema, handled by bool Node::handler(Net_client*, const T&)
+/// </summary>
+#define NET_MESSAGE(Node, msg_type, T, handler, channels, auth) \
+    Net_handler<Node>{ MsgType::msg_type, wire_smallest_size<T>(), channels, NetAuth::auth, &net_handle_message<Node, T, &Node::handler> }
+
+/// <summary>
+/// Registers a variable length message, handled by bool Node::handler(Net_client*, Packet_reader&)
+/// </summary>
+#define NET_STREAM(Node, msg_type, handler, channels, auth) \
+    Net_handler<Node>{ MsgType::msg_type, 0, channels, NetAuth::auth, &net_handle_stream<Node, &Node::handler> }
+
+/// <summary>
+/// Dense table indexed by MsgType, built at compile time from the registry of a node
+/// types that arent in the registry have NetAuth::None
+/// </summary>
+template<typename Node>
+struct Net_dispatch_table {
+    constexpr Net_dispatch_table(std::initializer_list<Net_handler<Node>> handlers) : _handlers{} {
+        for (const Net_handler<Node>& handler : handlers) {
+            _handlers[(uint32_t)handler.type] = handler;
+        }
+    }
+
+    constexpr const Net_handler<Node>& get(MsgType type) const {
+        return _handlers[(uint32_t)type];
+    }
+
+    constexpr bool has(MsgType type) const {
+        return (uint32_t)type < NET_NUM_MSG_TYPES && _handlers[(uint32_t)type].auth != NetAuth::None;
+    }
+
+private:
+    Net_handler<Node> _handlers[NET_NUM_MSG_TYPES];
+};
+
+/// <summary>
+/// Per message type counters, filled in by net_dispatch
+/// </summary>
+struct Net_message_counters {
+    uint64_t    received[NET_NUM_MSG_TYPES];
+    uint64_t    bytes[NET_NUM_MSG_TYPES];
+    uint64_t    rejected[NET_NUM_MSG_TYPES];
+    uint64_t    unknown;
+
+    Net_message_counters();
+
+    void reset();
+    void print(const char* name) const;
+};
+
+NetAuth net_client_auth(const Net_client* client);
+
+/// <summary>
+/// Reads every message in the reader and calls its handler
+/// stops at the first message that is unknown, not allowed on the channel or from the sender,
+/// truncated, or whose handler returns false
+/// client is NULL for the connection to the master
+/// the messages are read in node.protocol_version(client), asked for every message
+/// as a handshake message can change it for the ones after it
+/// </summary>
+template<typename Node>
+NetDispatchResult net_dispatch(const Net_dispatch_table<Node>& table, Node& node, Net_client* client, uint8_t channel, Packet_reader& reader, Net_message_counters& counters) {
+    MsgType type = MsgType::None;
+
+    while (reader.peek_type(type)) {
+        // we cant know the size of an unknown message, so the rest of the data is unreadable
+        if (!table.has(type)) {
+            counters.unknown++;
+            return NetDispatchResult::Unknown;
+        }
+
+        const Net_handler<Node>& handler = table.get(type);
+        uint32_t index = (uint32_t)type;
+
+        // the auth state is checked per message, an authentication can be followed by other messages
+        if ((handler.channels & channel) == 0 || handler.auth != net_client_auth(client)) {
+            counters.rejected[index]++;
+            return NetDispatchResult::NotAllowed;
+        }
+
+        if (handler.size > reader.remaining()) {
+            counters.rejected[index]++;
+            return NetDispatchResult::Truncated;
+        }
+
+        uint32_t start = reader.offset();
+
+        bool keep_reading = handler.handle(node, client, reader, node.protocol_version(client));
+
+        counters.received[index]++;
+        counters.bytes[index] += reader.offset() - start;
+
+        if (reader.failed()) {
+            return NetDispatchResult::Truncated;
+        }
+
+        if (!keep_reading) {
+            return NetDispatchResult::Stopped;
+        }
+    }
+
+    return NetDispatchResult::Done;
+}
@@ -2,6 +2,8 @@
 
 #include "tcp_server.h"
 #include "net_packet.h"
+#include "packet_view.h"
+#include "net_dispatch.h"
 #include "ini_file.h"
 #include "trace.h"
 
@@ -20,6 +22,7 @@ Net_master::Net_master(Ini_file* file)
     //file.get_slaves(slaves);
 
     _tcp.init(_my_node->tcp_port);
+    _tcp.block_list().configure(_my_node->block_ttl_seconds, _my_node->max_connections_per_ip, _my_node->blocked_ranges);
 
     _tcp.set_on_client_data_callback([&](Net_client* client, const std::vector<uint8_t>& data, int32_t len) {
         on_inc_tcp_data(client, data, len);
@@ -147,6 +150,32 @@ void Net_master::add_authenticated_slave(Net_client* client, const Net_authentic
     TRACE("[NET-MASTER][New slave node registered successfully]\n");
 }
 
+/// <summary>
+/// Every message the master accepts and who may send it
+/// </summary>
+struct Net_master_dispatch 
+{
+    static constexpr Net_dispatch_table<Net_master> table = {
+        NET_MESSAGE(Net_master, NetProtocolVersionRequest, Net_protocol_version_request, on_protocol_version_request, NET_CHANNEL_TCP, Unauthenticated),
+        NET_MESSAGE(Net_master, NetCompressionRequest, Net_compression_request, on_compression_request, NET_CHANNEL_TCP, Unauthenticated),
+        NET_MESSAGE(Net_master, NetAuthenticatePlayer, Net_authenticate_player, on_authenticate_player, NET_CHANNEL_TCP, Unauthenticated),
+        NET_MESSAGE(Net_master, NetAuthenticateSlave, Net_authenticate_slave, on_authenticate_slave, NET_CHANNEL_TCP, Unauthenticated),
+
+        // ---------- PLAYER MESSAGES ---------- //
+        NET_MESSAGE(Net_master, NetPlayerSlaveNodeRequest, Net_player_slave_node_request, on_slave_node_request, NET_CHANNEL_TCP, Player),
+        NET_MESSAGE(Net_master, NetPlayerMasterJoinPrivateSessionRequest, Net_player_master_join_private_session_request, on_join_private_session_request, NET_CHANNEL_TCP, Player),
+
+        // ---------- SLAVE MESSAGES ------- //
+        NET_MESSAGE(Net_master, NetSlaveConfig, Net_slave_config, on_slave_config, NET_CHANNEL_TCP, Slave),
+        NET_MESSAGE(Net_master, NetFromSlaveSyncSession, Net_from_slave_sync_session, on_slave_sync_session, NET_CHANNEL_TCP, Slave),
+        NET_MESSAGE(Net_master, NetSlaveHealthReport, Net_slave_health_snapshot, on_slave_health_report, NET_CHANNEL_TCP, Slave)
+    };
+};
+
+constexpr Net_dispatch_table<Net_master> Net_master_dispatch::table;
+
+static_assert(Net_master_dispatch::table.get(MsgType::NetSlaveConfig).auth == NetAuth::Slave, "players cant send slave messages");
+
 /// <summary>
 /// When we get TCP data it can be either from players or from slaves
 /// client->info.type determines who is what
@@ -160,228 +189,217 @@ void Net_master::add_authenticated_slave(Net_client* client, const Net_authentic
 /// <param name="data_len"></param>
 void Net_master::on_inc_tcp_data(Net_client* client, const std::vector<uint8_t>& data, int32_t data_len) 
 {
-    uint32_t pos = 0;
-    int32_t len = data_len;
+    // a message we cant read drops the rest of the data
+    Packet_reader reader(data, data_len);
+
+    NetDispatchResult result = net_dispatch(Net_master_dispatch::table, *this, client, NET_CHANNEL_TCP, reader, _counters);
 
-    while (len > 0) 
+    if (result == NetDispatchResult::NotAllowed && client->info.type == NetClientType::Unauthenticated) 
     {
-        MsgType type = (MsgType)((uint8_t)data[pos]);
+        // we only allow authentication packets if the client is unauthenticated
+        // if the client isnt able to authenticate, we disconnect it directly
+        TRACE("[NET-MASTER][ON-INC-TCP-DATA][ERROR][Client tried to send message without authenticated state]\n");
+        _tcp.disconnect(client);
+    }
+    else if (result == NetDispatchResult::Unknown || result == NetDispatchResult::NotAllowed) 
+    {
+        MsgType type = MsgType::None;
+        reader.peek_type(type);
 
-        if (client->info.type == NetClientType::Unauthenticated) 
+        if (result == NetDispatchResult::Unknown) 
         {
-            // we only allow authentication packets if the client is unauthenticated
-            // if the client isnt able to authenticate, we disconnect it directly
-            switch (type) 
-            {
-                case MsgType::NetAuthenticatePlayer:
-                {
-                    Net_authenticate_player auth(data, pos);
-                    pos += sizeof(Net_authenticate_player);
-                    len -= sizeof(Net_authenticate_player);
-
-                    if (auth.client_password != _my_node->client_password) 
-                    {
-                        TRACE("[NET-MASTER][ON-INC-TCP-DATA][NetAuthenticatePlayer][FAIL][Invalid password]\n");
-                        _tcp.disconnect(client);
-                        
-                        return;
-                    }
-
-                    TRACE("[NET-MASTER][ON-INC-TCP-DATA][NetAuthenticatePlayer][SUCCESS]\n");
-                    client->info.type = NetClientType::Player;
-
-                    Net_success success(NetSuccessType::Authentication);
-
-                    client->add_tcp_data(&success, sizeof(Net_success));
-                    continue;
-                }
-                case MsgType::NetAuthenticateSlave:
-                {
-                    Net_authenticate_slave auth(data, pos);
-                
-                    pos += sizeof(Net_authenticate_slave);
-                    len -= sizeof(Net_authenticate_slave);
-
-                    if (auth.master_password != _my_node->master_password) 
-                    {
-                        TRACE("[NET-MASTER][ON-INC-TCP-DATA][NetAuthenticateSlave][FAIL][Invalid master password]\n");
-                        _tcp.disconnect(client);
-
-                        return;
-                    }
-
-                    TRACE("[NET-MASTER][ON-INC-TCP-DATA][NetAuthenticateSlave][SUCCESS]\n");
-
-                    add_authenticated_slave(client, auth);
-                    continue;
-                }
-                default:
-                    // disconnect
-                    break;
-            }
-
-            TRACE("[NET-MASTER][ON-INC-TCP-DATA][ERROR][Client tried to send message without authenticated state]\n");
-            _tcp.disconnect(client);
-
-            return;
+            TRACE("[NET-MASTER][ON_INC_DATA][ERROR][Unknown message type: %d]\n", type);
         }
-
-        switch (type) 
+        else 
         {
-
-            // ---------- PLAYER MESSAGES ---------- //
-            case MsgType::NetPlayerSlaveNodeRequest: 
-            {
-                TRACE("[NET-MASTER][NetPlayerSlaveNodeRequest]\n");
-
-                // no need to populate packet, its only a uint8
-                // just send a slave config
-                // But first we need to check that the player has been registered on the master node
-
-                pos += sizeof(Net_player_slave_node_request);
-                len -= sizeof(Net_player_slave_node_request);
-
-                if (_slaves_health.size() == 0) 
-                {
-                    Net_error error(NetErrorType::NoAvailableSessions);
-
-                    client->add_tcp_data(&error, sizeof(Net_error));
-                    continue;
-                }
-
-                Net_slave_info* slave = _slaves_health[0].get();
-
-                Net_player_slave_node_response resp(slave->slave_id, slave->ip, slave->tcp_port, slave->udp_port);
-                memcpy(resp.ip, slave->ip, 64);
-                
-                resp.slave_id = slave->slave_id;
-                resp.tcp_port = slave->tcp_port;
-                resp.udp_port = slave->udp_port;
-
-                TRACE("Sending slave config: %s, %d, %d\n", slave->ip, slave->slave_id, slave->tcp_port);
-                
-                client->add_tcp_data(&resp, sizeof(Net_player_slave_node_response));
-
-                break;
-            }
-            case MsgType::NetPlayerMasterJoinPrivateSessionRequest:
-            {
-                TRACE("[NET-MASTER][NetPlayerMasterJoinPrivateSessionRequest]\n");
-                // when a session join request comes in to the master, it means
-                // its a private session that isnt listed
-
-                // We need to send a reply with the node config of the session
-                // When the client gets the response that the session was
-                // found at the provided node, it needs to connect to that noce
-                Net_player_master_join_private_session_request req(data, pos);
-
-                pos += sizeof(Net_player_master_join_private_session_request);
-                len -= sizeof(Net_player_master_join_private_session_request);
-
-                mmh::Hash_key key(req.code);
-
-                // Lookup the session code to find the slave node that the session is played on
-                if (_session_code_lookup.find(key.hash) != _session_code_lookup.end()) 
-                {
-                    TRACE("[NET-MASTER][NetPlayerMasterJoinPrivateSessionRequest][OK]\n");
-
-                    // we found the session
-                    Net_slave_info* slave = _session_code_lookup[key.hash];
-                    
-                    Net_player_master_join_private_session_response resp;
-                    memcpy(resp.ip, slave->ip, 64);
-                    
-                    resp.slave_id = slave->slave_id;
-                    resp.tcp_port = slave->tcp_port;
-                    resp.udp_port = slave->udp_port;
-                    
-                    // the client now has all the information needed to connect to the slave node
-                    client->add_tcp_data(&resp, sizeof(Net_player_master_join_private_session_response));
-                }
-                else 
-                {
-                    TRACE("[NET-MASTER][ERROR][Session not found]\n");
-                    Net_error error(NetErrorType::SessionNotFound);
-                
-                    // we didnt find the session so send an error instead
-                    client->add_tcp_data(&error, sizeof(Net_error));
-                }
-                
-                break;
-            }
-
-            // ---------- SLAVE MESSAGES ------- //
-            case MsgType::NetSlaveConfig:
-            {
-                TRACE("[NET-MASTER][NetSlaveConfig]\n");
-
-                Net_slave_config config(data, pos);
-
-                pos += sizeof(Net_slave_config);
-                len -= sizeof(Net_slave_config);
-
-                Net_slave_info* slave = get_slave(client);
-                memcpy(slave->ip, config.ip, 64);
-                memcpy(slave->hostname, config.hostname, 64);
-                
-                slave->tcp_port = config.tcp_port;
-                slave->udp_port = config.udp_port;
-                
-                TRACE("slave id: %d, config id: %d, ip: %s\n", slave->slave_id, config.node_id, slave->ip);
-
-                break;
-            }
-            case MsgType::NetFromSlaveSyncSession: 
-            {
-                // Keepalive messages are sent from the slave node to the master to indicate that everything is fine with the session
-                TRACE("[NET-MASTER][NetFromSlaveSyncSession]\n");
-
-                Net_from_slave_sync_session session(data, pos);
-
-                Net_slave_info* slave = get_slave(client);
-
-                pos += sizeof(Net_from_slave_sync_session);
-                len -= sizeof(Net_from_slave_sync_session);
-
-                slave->add_session_if_not_exists(session.session_id, session.code);
-                slave->set_session(session.session_id, session.code, session.num_players);
-
-                break;
-            }
-            case MsgType::NetSlaveHealthReport:
-            {
-                TRACE("[NET-MASTER][NetSlaveHealthReport][Got health report from slave]\n");
-                auto slave = get_slave(client);
-
-                if (slave == nullptr) 
-                {
-                    TRACE("[NET-MASTER][NetSlaveHealthReport][ERROR][Cant find slave with client_id: %d]\n", client->info.client_id);
-                    return;
-                }
-
-                Net_slave_health_snapshot health(data, pos);
-                TRACE("Health report from slave_id: %d\n", slave->slave_id);
-
-                slave->set_health_rating(health);
-                std::sort(_slaves_health.begin(), _slaves_health.end(), best_health_is_first());
-
-                health.print();
-
-                pos += sizeof(Net_slave_health_snapshot);
-                len -= sizeof(Net_slave_health_snapshot);
-
-                break;
-            }
-            default:
-                TRACE("[NET-MASTER][ON_INC_DATA][ERROR][Unknown message type: %d]\n", type);
-
-                pos = 0;
-                len = 0;
-                break;
+            TRACE("[NET-MASTER][ON_INC_DATA][ERROR][Message type not allowed from client: %d]\n", type);
         }
     }
 }
 
+uint8_t Net_master::protocol_version(const Net_client* client) const
+{
+    return client->info.protocol_version;
+}
+
+bool Net_master::on_protocol_version_request(Net_client* client, const Net_protocol_version_request& req) 
+{
+    // players and slaves both ask, the slaves authenticate once they have the answer
+    client->info.protocol_version = net_protocol_version(req.version);
+
+    client->add_tcp_message(Net_protocol_version_response(client->info.protocol_version));
+
+    return true;
+}
+
+bool Net_master::on_compression_request(Net_client* client, const Net_compression_request& req) 
+{
+    // login peaks are mostly master egress, the session lists and slave replies compress well
+    client->enable_tcp_compression(req.algorithms);
+
+    return true;
+}
+
+bool Net_master::on_authenticate_player(Net_client* client, const Net_authenticate_player& auth) 
+{
+    if (auth.client_password != _my_node->client_password) 
+    {
+        TRACE("[NET-MASTER][ON-INC-TCP-DATA][NetAuthenticatePlayer][FAIL][Invalid password]\n");
+        _tcp.disconnect(client);
+        
+        return false;
+    }
+
+    TRACE("[NET-MASTER][ON-INC-TCP-DATA][NetAuthenticatePlayer][SUCCESS]\n");
+    client->info.type = NetClientType::Player;
+
+    Net_success success(NetSuccessType::Authentication);
+
+    client->add_tcp_message(success);
+
+    return true;
+}
+
+bool Net_master::on_authenticate_slave(Net_client* client, const Net_authenticate_slave& auth) 
+{
+    if (auth.master_password != _my_node->master_password) 
+    {
+        TRACE("[NET-MASTER][ON-INC-TCP-DATA][NetAuthenticateSlave][FAIL][Invalid master password]\n");
+        _tcp.disconnect(client);
+
+        return false;
+    }
+
+    TRACE("[NET-MASTER][ON-INC-TCP-DATA][NetAuthenticateSlave][SUCCESS]\n");
+
+    add_authenticated_slave(client, auth);
+
+    return true;
+}
+
+bool Net_master::on_slave_node_request(Net_client* client, const Net_player_slave_node_request&) 
+{
+    TRACE("[NET-MASTER][NetPlayerSlaveNodeRequest]\n");
+
+    // no need to populate packet, its only a uint8
+    // just send a slave config
+    // But first we need to check that the player has been registered on the master node
+
+    if (_slaves_health.size() == 0) 
+    {
+        Net_error error(NetErrorType::NoAvailableSessions);
+
+        client->add_tcp_message(error);
+        return true;
+    }
+
+    Net_slave_info* slave = _slaves_health[0].get();
+
+    Net_player_slave_node_response resp(slave->slave_id, slave->ip, slave->tcp_port, slave->udp_port);
+    memcpy(resp.ip, slave->ip, 64);
+    
+    resp.slave_id = slave->slave_id;
+    resp.tcp_port = slave->tcp_port;
+    resp.udp_port = slave->udp_port;
+
+    TRACE("Sending slave config: %s, %d, %d\n", slave->ip, slave->slave_id, slave->tcp_port);
+    
+    client->add_tcp_message(resp);
+
+    return true;
+}
+
+bool Net_master::on_join_private_session_request(Net_client* client, const Net_player_master_join_private_session_request& req) 
+{
+    TRACE("[NET-MASTER][NetPlayerMasterJoinPrivateSessionRequest]\n");
+    // when a session join request comes in to the master, it means
+    // its a private session that isnt listed
+
+    // We need to send a reply with the node config of the session
+    // When the client gets the response that the session was
+    // found at the provided node, it needs to connect to that noce
+    mmh::Hash_key key(req.code);
+
+    // Lookup the session code to find the slave node that the session is played on
+    if (_session_code_lookup.find(key.hash) != _session_code_lookup.end()) 
+    {
+        TRACE("[NET-MASTER][NetPlayerMasterJoinPrivateSessionRequest][OK]\n");
+
+        // we found the session
+        Net_slave_info* slave = _session_code_lookup[key.hash];
+        
+        Net_player_master_join_private_session_response resp;
+        memcpy(resp.ip, slave->ip, 64);
+        
+        resp.slave_id = slave->slave_id;
+        resp.tcp_port = slave->tcp_port;
+        resp.udp_port = slave->udp_port;
+        
+        // the client now has all the information needed to connect to the slave node
+        client->add_tcp_message(resp);
+    }
+    else 
+    {
+        TRACE("[NET-MASTER][ERROR][Session not found]\n");
+        Net_error error(NetErrorType::SessionNotFound);
+    
+        // we didnt find the session so send an error instead
+        client->add_tcp_message(error);
+    }
+    
+    return true;
+}
+
+bool Net_master::on_slave_config(Net_client* client, const Net_slave_config& config) 
+{
+    TRACE("[NET-MASTER][NetSlaveConfig]\n");
+
+    Net_slave_info* slave = get_slave(client);
+    memcpy(slave->ip, config.ip, 64);
+    memcpy(slave->hostname, config.hostname, 64);
+    
+    slave->tcp_port = config.tcp_port;
+    slave->udp_port = config.udp_port;
+    
+    TRACE("slave id: %d, config id: %d, ip: %s\n", slave->slave_id, config.node_id, slave->ip);
+
+    return true;
+}
+
+bool Net_master::on_slave_sync_session(Net_client* client, const Net_from_slave_sync_session& session) 
+{
+    // Keepalive messages are sent from the slave node to the master to indicate that everything is fine with the session
+    TRACE("[NET-MASTER][NetFromSlaveSyncSession]\n");
+
+    Net_slave_info* slave = get_slave(client);
+
+    slave->add_session_if_not_exists(session.session_id, session.code);
+    slave->set_session(session.session_id, session.code, session.num_players);
+
+    return true;
+}
+
+bool Net_master::on_slave_health_report(Net_client* client, const Net_slave_health_snapshot& health) 
+{
+    TRACE("[NET-MASTER][NetSlaveHealthReport][Got health report from slave]\n");
+    auto slave = get_slave(client);
+
+    if (slave == nullptr) 
+    {
+        TRACE("[NET-MASTER][NetSlaveHealthReport][ERROR][Cant find slave with client_id: %d]\n", client->info.client_id);
+        return false;
+    }
+
+    TRACE("Health report from slave_id: %d\n", slave->slave_id);
+
+    slave->set_health_rating(health);
+    std::sort(_slaves_health.begin(), _slaves_health.end(), best_health_is_first());
+
+    health.print();
+
+    return true;
+}
+
 void Net_master::update() {
     auto now = std::chrono::high_resolution_clock::now();
 
@@ -394,17 +412,17 @@ void Net_master::update() {
         // set the next time we want a report
         _next_slave_report = now + std::chrono::seconds(_my_node->slave_sync_interval_seconds);
 
-        // slaves will connect to us as net_clients
+        // slaves will connect to us as net_clients, each gets it in its own protocol version
+        // with the next send_client_data
         Net_master_to_slave_command report(NetMasterToSlaveCommand::ReportHealth);
 
-        report.set_buffer(_data_buffer, 0);
-
-        if (!_tcp.send_data_to_all(_data_buffer, sizeof(NetMasterToSlaveCommand))) {
-            TRACE("[NET-MASTER][UPDATE][Demand report send failed]\n");
-        }
-        else {
-            TRACE("[NET-MASTER][UPDATE][Demand report sent]\n");
+        for (auto& slave : _slaves_health) {
+            slave->client->add_tcp_message(report);
         }
+
+        TRACE("[NET-MASTER][UPDATE][Demand report queued]\n");
+
+        _counters.print("master");
     }
 }
 
@@ -10,6 +10,7 @@
 #include "tcp_server.h"
 #include "net_packet.h"
 #include "net_client.h"
+#include "net_dispatch.h"
 #include "net_session_player.h"
 #include "net_session.h"
 #include "hash.h"
@@ -105,17 +106,35 @@ struct Net_master {
     Net_slave_info* get_slave(Net_client* client);
 
     void update();
+
+    // the version the messages of client are read in
+    uint8_t protocol_version(const Net_client* client) const;
     
 private:
     void add_authenticated_slave(Net_client* client, const Net_authenticate_slave& auth);
 
     void on_inc_tcp_data(Net_client* client, const std::vector<uint8_t>& data, int32_t data_len);
+
+    // message handlers, registered in Net_master_dispatch
+    // returning false stops reading the rest of the data
+    bool on_protocol_version_request(Net_client* client, const Net_protocol_version_request& req);
+    bool on_compression_request(Net_client* client, const Net_compression_request& req);
+    bool on_authenticate_player(Net_client* client, const Net_authenticate_player& auth);
+    bool on_authenticate_slave(Net_client* client, const Net_authenticate_slave& auth);
+    bool on_slave_node_request(Net_client* client, const Net_player_slave_node_request& req);
+    bool on_join_private_session_request(Net_client* client, const Net_player_master_join_private_session_request& req);
+    bool on_slave_config(Net_client* client, const Net_slave_config& config);
+    bool on_slave_sync_session(Net_client* client, const Net_from_slave_sync_session& session);
+    bool on_slave_health_report(Net_client* client, const Net_slave_health_snapshot& health);
+
     void on_client_connect(Net_client* client);
     void on_client_disconnect(Net_client* client);
 
     void remove_slave(Net_client* client);
     void remove_player(Net_client* client);
 
+    friend struct Net_master_dispatch;
+
     std::unordered_map<uint32_t, Net_slave_info*>                       _session_code_lookup; // this is a hash as a key
     std::unordered_map<uint32_t, Net_slave_info*>                       _session_id_lookup;
     
@@ -130,6 +149,8 @@ private:
     std::vector<uint8_t>    _data_buffer;
     Tcp_server              _tcp;
 
+    Net_message_counters    _counters;
+
     Ini_file*               _ini_file;
     Ini_node*               _my_node;
 };
\ No newline at end of file
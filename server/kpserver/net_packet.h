@@ -9,6 +9,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 
+#include "transform_codec.h"
+
 #pragma pack(push, 1)
 
 /// The packet we send to clients as well as receive
@@ -63,7 +65,19 @@ enum class MsgType {
     NetGameSessionHasEnded,
     NetPlayerSetItemStateRequest,
     NetPlayerSetItemStateResponse,
-    NetSceneItemStateChanged
+    NetSceneItemStateChanged,
+    NetGameTransformsAck,
+    NetTransformCodecConfig,
+    NetDatagram,
+    NetReliableMessage,
+    NetFragment,
+    NetCompressionRequest,
+    NetCompressionConfig,
+    NetCompressedFrame,
+    NetSessionSnapshotAck,
+    NetProtocolVersionRequest,
+    NetProtocolVersionResponse,
+    NumMsgTypes // keep last, sizes the dispatch tables
 };
 
 enum class NetErrorType {
@@ -123,14 +137,6 @@ struct Net_Udp_establish {
     Net_Udp_establish() : type((uint8_t)MsgType::NetUDPEstablish), code(0), client_id(0) {
     
     }
-
-    Net_Udp_establish(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(this, &data[off], sizeof(Net_Udp_establish));
-    }
-
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&data[off], this, sizeof(Net_Udp_establish));
-    }
 };
 
 /// <summary>
@@ -147,14 +153,85 @@ struct Net_Udp_client_connection_info {
     Net_Udp_client_connection_info() : type((uint8_t)MsgType::NetUDPClientConnectionInfo), code(0), client_id(0), port(0) {
         memset(ip, 0, 64);
     }
+};
 
-    Net_Udp_client_connection_info(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(this, &data[off], sizeof(Net_Udp_client_connection_info));
-    }
+// the version of the message layouts, see net_schema.h
+// a client that never sends a Net_protocol_version_request speaks NET_PROTOCOL_VERSION_MIN
+#define NET_PROTOCOL_VERSION        2
+#define NET_PROTOCOL_VERSION_MIN    1
 
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&data[off], this, sizeof(Net_Udp_client_connection_info));
+/// <summary>
+/// The version to use with a peer that asked for requested, the lower of the two
+/// </summary>
+inline uint8_t net_protocol_version(uint8_t requested) {
+    if (requested < NET_PROTOCOL_VERSION_MIN) {
+        return NET_PROTOCOL_VERSION_MIN;
     }
+
+    return requested < NET_PROTOCOL_VERSION ? requested : NET_PROTOCOL_VERSION;
+}
+
+/// <summary>
+/// Sent before authenticating, the highest protocol version the sender can read and write
+/// the messages after the reply are in the lower of the two versions
+/// </summary>
+struct Net_protocol_version_request {
+    uint8_t     type;
+    uint8_t     version;
+
+    Net_protocol_version_request() : type((uint8_t)MsgType::NetProtocolVersionRequest), version(NET_PROTOCOL_VERSION) {}
+};
+
+/// <summary>
+/// The reply to Net_protocol_version_request, the version both sides use from now on
+/// </summary>
+struct Net_protocol_version_response {
+    uint8_t     type;
+    uint8_t     version;
+
+    Net_protocol_version_response() : type((uint8_t)MsgType::NetProtocolVersionResponse), version(NET_PROTOCOL_VERSION) {}
+
+    Net_protocol_version_response(uint8_t version_) : type((uint8_t)MsgType::NetProtocolVersionResponse), version(version_) {}
+};
+
+// compression algorithms a client can ask for, a bit each
+#define NET_COMPRESSION_NONE    0
+#define NET_COMPRESSION_LZ      1
+
+/// <summary>
+/// Sent by the client before it authenticates, asks the server to compress the TCP stream
+/// algorithms is the set of NET_COMPRESSION_ bits the client can decompress
+/// </summary>
+struct Net_compression_request {
+    uint8_t     type;
+    uint8_t     algorithms;
+
+    Net_compression_request() : type((uint8_t)MsgType::NetCompressionRequest), algorithms(NET_COMPRESSION_NONE) {}
+};
+
+/// <summary>
+/// The reply to Net_compression_request, sent uncompressed
+/// everything the server sends on TCP after it can be a Net_compressed_frame
+/// </summary>
+struct Net_compression_config {
+    uint8_t     type;
+    uint8_t     algorithm;  // NET_COMPRESSION_NONE if the server wont compress
+    uint32_t    threshold;  // frames smaller than this are sent as they are
+
+    Net_compression_config(uint8_t algorithm_, uint32_t threshold_)
+        : type((uint8_t)MsgType::NetCompressionConfig), algorithm(algorithm_), threshold(threshold_) {}
+};
+
+/// <summary>
+/// Everything the server sent on TCP in one tick, compressed
+/// followed by length bytes that decompress to raw_length bytes of ordinary messages
+/// </summary>
+struct Net_compressed_frame {
+    uint8_t     type;
+    uint32_t    raw_length;
+    uint32_t    length;
+
+    Net_compressed_frame() : type((uint8_t)MsgType::NetCompressedFrame), raw_length(0), length(0) {}
 };
 
 //// ############# END COMMON PACKETS ############ ////
@@ -170,19 +247,13 @@ struct Net_authenticate_slave {
     uint32_t    slave_id;
     uint64_t    master_password;
 
+    Net_authenticate_slave() : type((uint8_t)MsgType::NetAuthenticateSlave), slave_id(0), master_password(0) {}
+
     Net_authenticate_slave(uint32_t slave_id_, uint64_t master_password_) {
         type = (uint8_t)MsgType::NetAuthenticateSlave;
         slave_id = slave_id_;
         master_password = master_password_;
     }
-
-    Net_authenticate_slave(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(this, &data[off], sizeof(Net_authenticate_slave));
-    }
-
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&data[off], this, sizeof(Net_authenticate_slave));
-    }
 };
 
 struct Net_session_player_packet {
@@ -194,18 +265,6 @@ struct Net_session_player_packet {
     Net_session_player_packet() : type((uint8_t)MsgType::NetPlayerSession), player_id(0) {
         
     }
-
-    Net_session_player_packet(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(this, &data[off], sizeof(Net_session_player_packet));
-    }
-
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&data[off], this, sizeof(Net_session_player_packet));
-    }
-
-    void from_buffer(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(this, &data[off], sizeof(Net_session_player_packet));
-    }
 };
 
 /// <summary>
@@ -221,14 +280,6 @@ struct Net_player_join_notify {
         memset(username, 0, 64);
         memset(avatar, 0, 32 * sizeof(uint16_t));
     }
-
-    Net_player_join_notify(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(this, &data[off], sizeof(Net_player_join_notify));
-    }
-
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&data[off], &type, sizeof(Net_player_join_notify));
-    }
 };
 
 /// <summary>
@@ -242,24 +293,17 @@ struct Net_game_session_will_start {
     Net_game_session_will_start() : type((uint8_t)MsgType::NetGameSessionWillStart) {
     
     }
-
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&data[off], this, sizeof(Net_game_session_will_start));
-    }
 };
 
 struct Net_game_session_has_started {
     uint8_t type;
     uint8_t ok;
     uint64_t start_timestamp;
+    uint16_t ticks_per_second; // the inputs are stamped with the tick, session timestamp * ticks_per_second / 1000
 
-    Net_game_session_has_started() : type((uint8_t)MsgType::NetGameSessionHasStarted) {
+    Net_game_session_has_started() : type((uint8_t)MsgType::NetGameSessionHasStarted), ticks_per_second(0) {
 
     }
-
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&data[off], this, sizeof(Net_game_session_has_started));
-    }
 };
 
 struct Net_game_session_has_ended {
@@ -269,10 +313,6 @@ struct Net_game_session_has_ended {
     Net_game_session_has_ended() : type((uint8_t)MsgType::NetGameSessionHasEnded) {
 
     }
-
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&data[off], this, sizeof(Net_game_session_has_ended));
-    }
 };
 
 
@@ -288,22 +328,48 @@ struct Net_scene_item_state_updated {
 /// Gives details of the game state
 /// Mission updates, doors etc
 /// </summary>
+/// <summary>
+/// The state of the scene items, sent every item snapshot interval
+/// only has the items the player hasnt acked the latest state of, see item_delta.h
+/// </summary>
 struct Net_session_snapshot {
     uint8_t     type;
     uint32_t    session_timestamp;
-    uint8_t     items[64];
+    uint16_t    sequence;
+    uint16_t    num_items;  // in the scene, not in the snapshot
 
-    Net_session_snapshot() : type((uint8_t)MsgType::NetSessionSnapshot), session_timestamp(0) {}
+    Net_session_snapshot() : type((uint8_t)MsgType::NetSessionSnapshot), session_timestamp(0), sequence(0), num_items(0) {}
 };
 
 /// <summary>
-/// Gives the initial state of the world
+/// Sent from the client over UDP when it has received a Net_session_snapshot
+/// the items in it arent sent again unless they change
+/// </summary>
+struct Net_session_snapshot_ack {
+    uint8_t     type;
+    uint16_t    sequence;
+
+    Net_session_snapshot_ack() : type((uint8_t)MsgType::NetSessionSnapshotAck), sequence(0) {}
+};
+
+struct Net_session_world_init_item {
+    uint16_t    id;
+    uint8_t     types;
+    uint8_t     states;
+};
+
+/// <summary>
+/// Gives the initial state of the world, sent when a player joins
+/// Followed by num_items Net_session_world_init_item, this is usually
+/// larger than a datagram so it is sent fragmented
 /// </summary>
 struct Net_session_world_init {
     uint8_t type;
-    
+    uint16_t num_items;
 
-    Net_session_world_init() : type((uint8_t)MsgType::NetSessionWorldInit) {}
+    std::vector<Net_session_world_init_item> items;
+
+    Net_session_world_init() : type((uint8_t)MsgType::NetSessionWorldInit), num_items(0) {}
 };
 
 struct Net_player_sync_time_request {
@@ -311,15 +377,6 @@ struct Net_player_sync_time_request {
     uint64_t t0; // the time at the client
 
     Net_player_sync_time_request() : type(((uint8_t)MsgType::NetPlayerSyncTimeRequest)) {}
-
-
-    Net_player_sync_time_request(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(this, &data[off], sizeof(Net_player_sync_time_request));
-    }
-
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&data[off], this, sizeof(Net_player_sync_time_request));
-    }
 };
 
 struct Net_player_sync_time_response {
@@ -329,10 +386,6 @@ struct Net_player_sync_time_response {
     uint32_t session_time;
 
     Net_player_sync_time_response() : type(((uint8_t)MsgType::NetPlayerSyncTimeResponse)) {}
-
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&data[off], this, sizeof(Net_player_sync_time_response));
-    }
 };
 
 
@@ -343,14 +396,6 @@ struct Net_player_start_game_session_request {
     uint8_t type;
 
     Net_player_start_game_session_request() : type((uint8_t)MsgType::NetPlayerStartGameSessionRequest) {}
-
-    Net_player_start_game_session_request(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(this, &data[off], sizeof(Net_player_start_game_session_request));
-    }
-
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&data[off], this, sizeof(Net_player_start_game_session_request));
-    }
 };
 
 struct Net_player_set_item_state_request {
@@ -360,14 +405,6 @@ struct Net_player_set_item_state_request {
     uint8_t on;
 
     Net_player_set_item_state_request() : type((uint8_t)MsgType::NetPlayerSetItemStateRequest) {}
-
-    Net_player_set_item_state_request(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(this, &data[off], sizeof(Net_player_set_item_state_request));
-    }
-
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&data[off], this, sizeof(Net_player_set_item_state_request));
-    }
 };
 
 struct Net_player_set_item_state_response {
@@ -376,14 +413,6 @@ struct Net_player_set_item_state_response {
     uint16_t id;
 
     Net_player_set_item_state_response() : type((uint8_t)MsgType::NetPlayerSetItemStateResponse) {}
-
-    Net_player_set_item_state_response(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(this, &data[off], sizeof(Net_player_set_item_state_response));
-    }
-
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&data[off], this, sizeof(Net_player_set_item_state_response));
-    }
 };
 
 struct Net_player_start_game_session_response {
@@ -394,10 +423,6 @@ struct Net_player_start_game_session_response {
     Net_player_start_game_session_response() : type((uint8_t)MsgType::NetPlayerStartGameSessionResponse) {
         ok = 0;
     }
-
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&data[off], this, sizeof(Net_player_start_game_session_response));
-    }
 };
 
 /// <summary>
@@ -411,14 +436,6 @@ struct Net_player_host_session_request {
         type = (uint8_t)MsgType::NetPlayerHostSessionRequest;
         is_private = 0;
     }
-
-    Net_player_host_session_request(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(this, &data[off], sizeof(Net_player_host_session_request));
-    }
-
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&data[off], this, sizeof(Net_player_host_session_request));
-    }
 };
 
 
@@ -434,14 +451,6 @@ struct Net_player_host_session_response {
     Net_player_host_session_response() {
         type = (uint8_t)MsgType::NetPlayerHostSessionResponse;
     }
-
-    Net_player_host_session_response(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(this, &data[off], sizeof(Net_player_host_session_response));
-    }
-
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&data[off], this, sizeof(Net_player_host_session_response));
-    }
 };
 
 /// <summary>
@@ -455,10 +464,6 @@ struct Net_player_master_join_private_session_request {
         type = (uint8_t)MsgType::NetPlayerMasterJoinPrivateSessionRequest;
         memset(code, 0, 8);
     }
-
-    Net_player_master_join_private_session_request(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(this, &data[off], sizeof(Net_player_master_join_private_session_request));
-    }
 };
 
 /// <summary>
@@ -472,10 +477,6 @@ struct Net_player_slave_join_private_session_request {
         type = (uint8_t)MsgType::NetPlayerSlaveJoinPrivateSessionRequest;
         memset(code, 0, 8);
     }
-
-    Net_player_slave_join_private_session_request(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(this, &data[off], sizeof(Net_player_slave_join_private_session_request));
-    }
 };
 
 struct Net_player_slave_join_public_session_request {
@@ -486,10 +487,6 @@ struct Net_player_slave_join_public_session_request {
         type = (uint8_t)MsgType::NetPlayerSlaveJoinPublicSessionRequest;
         session_id = 0;
     }
-
-    Net_player_slave_join_public_session_request(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(this, &data[off], sizeof(Net_player_slave_join_public_session_request));
-    }
 };
 
 struct Net_player_slave_join_public_session_response {
@@ -499,10 +496,6 @@ struct Net_player_slave_join_public_session_response {
     Net_player_slave_join_public_session_response() {
         type = (uint8_t)MsgType::NetPlayerSlaveJoinPublicSessionResponse;
     }
-
-    Net_player_slave_join_public_session_response(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(this, &data[off], sizeof(Net_player_slave_join_public_session_response));
-    }
 };
 
 
@@ -513,10 +506,6 @@ struct Net_player_slave_join_private_session_response {
     Net_player_slave_join_private_session_response() {
         type = (uint8_t)MsgType::NetPlayerSlaveJoinPrivateSessionResponse;
     }
-
-    Net_player_slave_join_private_session_response(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(this, &data[off], sizeof(Net_player_slave_join_private_session_response));
-    }
 };
 
 /// <summary>
@@ -536,10 +525,6 @@ struct Net_player_master_join_private_session_response {
     Net_player_master_join_private_session_response() {
         type = (uint8_t)MsgType::NetPlayerMasterJoinPrivateSessionResponse;
     }
-
-    Net_player_master_join_private_session_response(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(this, &data[off], sizeof(Net_player_master_join_private_session_response));
-    }
 };
 
 /// <summary>
@@ -560,10 +545,6 @@ struct Net_player_has_joined_session {
         memcpy(username, username_, 64);
         memset(avatar, 0, 32 * sizeof(uint16_t));
     }
-
-    Net_player_has_joined_session(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(this, &data[off], sizeof(Net_player_has_joined_session));
-    }
 };
 
 /// <summary>
@@ -582,10 +563,6 @@ struct Net_player_has_left_session {
         session_id = session_id_;
         player_id = player_id_;
     }
-
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&data[off], this, sizeof(Net_player_has_left_session));
-    }
 };
 
 /// <summary>
@@ -597,14 +574,6 @@ struct Net_player_leave_session_request {
     uint32_t    session_id;
 
     Net_player_leave_session_request() : type((uint8_t)MsgType::NetPlayerLeaveSessionRequest), session_id(0), player_id(0) {}
-
-    Net_player_leave_session_request(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(this, &data[off], sizeof(Net_player_leave_session_request));
-    }
-
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&data[off], this, sizeof(Net_player_leave_session_request));
-    }
 };
 
 /// <summary>
@@ -636,10 +605,6 @@ struct Net_player_slave_node_response {
     {
         memcpy(ip, ip_, 64);
     }
-
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&data[off], this, sizeof(Net_player_slave_node_response));
-    }
 };
 
 /// <summary>
@@ -659,15 +624,6 @@ struct Net_master_to_slave_command {
         type = (uint8_t)MsgType::NetFromMasterToSlaveCommand;
         command = (uint8_t)cmd;
     }
-
-    Net_master_to_slave_command(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(this, &data[off], sizeof(Net_master_to_slave_command));
-    }
-
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&data[off], &type, sizeof(uint8_t));
-        memcpy(&data[off + sizeof(uint8_t)], &command, sizeof(uint8_t));
-    }
 };
 
 /// <summary>
@@ -684,6 +640,14 @@ struct Net_slave_health_snapshot {
     uint16_t    pct_cpu_load_process;
     uint16_t    num_connected_players;
 
+    Net_slave_health_snapshot()
+        : type((uint8_t)MsgType::NetSlaveHealthReport),
+          pct_virt_process_ram_used(0),
+          pct_good_vs_lag_ticks(0),
+          avg_tick_idle_time(0),
+          pct_cpu_load_process(0),
+          num_connected_players(0) { }
+
     Net_slave_health_snapshot(float virt_process_ram_used, float good_vs_lag_ticks, int64_t avg_idle_time, float cpu_load, uint16_t num_players) {
         type = (uint8_t)MsgType::NetSlaveHealthReport;
         pct_virt_process_ram_used = (uint16_t)(virt_process_ram_used * 10000.0f);
@@ -694,15 +658,7 @@ struct Net_slave_health_snapshot {
         num_connected_players = num_players;
     }
 
-    Net_slave_health_snapshot(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(this, &data[off], sizeof(Net_slave_health_snapshot));
-    }
-
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&data[off], this, sizeof(Net_slave_health_snapshot));
-    }
-
-    void print() {
+    void print() const {
         printf("---- Health report:\n");
         printf("Pct RAM used: %f\n", ((float)pct_virt_process_ram_used / 10000.0f));
         printf("Pct LAG ticks: %f\n", ((float)pct_good_vs_lag_ticks / 10000.0f));
@@ -740,14 +696,6 @@ struct Net_from_slave_sync_session {
         num_players = 0;
         memset(code, 0, 8);
     }
-
-    Net_from_slave_sync_session(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(this, &data[off], sizeof(Net_from_slave_sync_session));
-    }
-
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&data[off], this, sizeof(Net_from_slave_sync_session));
-    }
 };
 
 /// <summary>
@@ -766,10 +714,6 @@ struct Net_authenticate_player {
         memset(username, 0, 64);
         memset(avatar, 0, 32 * sizeof(uint16_t));
     }
-
-    Net_authenticate_player(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(this, &data[off], sizeof(Net_authenticate_player));
-    }
 };
 
 
@@ -793,14 +737,6 @@ struct Net_slave_config {
         memset(hostname, 0, 64);
         memset(ip, 0, 32);
     }
-
-    Net_slave_config(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(this, &data[off], sizeof(Net_slave_config));
-    }
-
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&data[off], this, sizeof(Net_slave_config));
-    }
 };
 
 
@@ -824,14 +760,6 @@ struct Net_player_set_gamerule_int_request {
         : type((uint8_t)MsgType::NetPlayerSetGameRuleInt),
           rule_id(0),
           rule_value(0) { }
-
-    Net_player_set_gamerule_int_request(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(this, &data[off], sizeof(Net_player_set_gamerule_int_request));
-    }
-
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&data[off], &type, sizeof(Net_player_set_gamerule_int_request));
-    }
 };
 
 struct Net_game_config {
@@ -841,15 +769,6 @@ struct Net_game_config {
     std::vector<uint16_t> rules;
 
     Net_game_config() : type((uint8_t)MsgType::NetGameConfig) {}
-
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&data[off], &type, 3);
-        memcpy(&data[off + 3], &rules[0], sizeof(uint16_t) * num_rules);
-    }
-
-    size_t size() const {
-        return (size_t)3 + (num_rules * 4);
-    }
 };
 
 struct Net_game_rule_updated {
@@ -861,14 +780,6 @@ struct Net_game_rule_updated {
         : type((uint8_t)MsgType::NetGameRuleUpdated),
         rule_id(0),
         rule_value(0) { }
-
-    Net_game_rule_updated(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(this, &data[off], sizeof(Net_game_rule_updated));
-    }
-
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&data[off], &type, sizeof(Net_game_rule_updated));
-    }
 };
 
 
@@ -880,26 +791,6 @@ struct Net_slave_session_players_list {
     uint8_t     num_players;
 
     std::vector<Net_session_player_packet> players;
-
-    void from_buffer(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&type, &data[0], sizeof(type));
-        memcpy(&num_players, &data[sizeof(type)], sizeof(num_players));
-
-        players.resize(num_players);
-
-        for (int i = 0; i < num_players; ++i) {
-            players[i].from_buffer(data, sizeof(type) + sizeof(num_players) + sizeof(Net_session_player_packet) * i);
-        }
-    }
-
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&data[off], &type, sizeof(type));
-        memcpy(&data[off + sizeof(type)], &num_players, sizeof(num_players));
-
-        for (int i = 0; i < num_players; ++i) {
-            players[i].set_buffer(data, off + sizeof(type) + sizeof(num_players) + sizeof(Net_session_player_packet) * i);
-        }
-    }
 };
 
 
@@ -911,20 +802,6 @@ struct Net_slave_session_summary {
     uint32_t    session_id;
     uint8_t     max_players;
     uint8_t     num_players;
-
-    void from_buffer(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&type, &data[off], sizeof(type));
-        memcpy(&session_id, &data[off + sizeof(type)], sizeof(session_id));
-        memcpy(&max_players, &data[off + sizeof(type) + sizeof(session_id)], sizeof(max_players));
-        memcpy(&num_players, &data[off + sizeof(type) + sizeof(session_id) + sizeof(max_players)], sizeof(num_players));
-    }
-
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&data[off], &type, sizeof(type));
-        memcpy(&data[off + sizeof(type)], &session_id, sizeof(session_id));
-        memcpy(&data[off + sizeof(type) + sizeof(session_id)], &max_players, sizeof(max_players));
-        memcpy(&data[off + sizeof(type) + sizeof(session_id) + sizeof(max_players)], &num_players, sizeof(num_players));
-    }
 };
 
 /// <summary>
@@ -955,10 +832,6 @@ struct Net_slave_session_item {
         num_players = num_players_;
         max_players = max_players_;
     }
-
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) { 
-        memcpy(&data[off], this, sizeof(Net_slave_session_item));
-    }
 };
 
 /// <summary>
@@ -973,25 +846,6 @@ struct Net_player_slave_list_sessions_response {
     Net_player_slave_list_sessions_response() {
         type = (uint8_t)MsgType::NetPlayerSlaveListSessionsResponse;
     }
-
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        num_sessions = (uint8_t)sessions.size();
-        memcpy(&data[off], this, sizeof(uint8_t) + sizeof(uint8_t));
-        uint32_t offset = off + sizeof(uint8_t) + sizeof(uint8_t);
-
-        for (int i = 0; i < sessions.size(); ++i) {
-            sessions[i].set_buffer(data, offset);
-            offset += sizeof(Net_slave_session_item);
-        }
-    }
-
-    uint32_t header_size() const {
-        return sizeof(uint8_t) + sizeof(uint8_t);
-    }
-
-    uint32_t data_size() const {
-        return sizeof(Net_slave_session_item) * num_sessions;
-    }
 };
 
 
@@ -1016,14 +870,6 @@ struct Net_snapshot_player {
         hp = 0;
         flags = 0;
     }
-
-    Net_snapshot_player(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(this, &data[off], sizeof(Net_snapshot_player));
-    }
-
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&data[off], this, sizeof(Net_snapshot_player));
-    }
 };
 
 /// <summary>
@@ -1039,109 +885,199 @@ struct Net_chat {
     }
 };
 
-#define FLOAT_PRECISION_MULT 32767.0f
+#define SNAPSHOT_NO_BASELINE 0xFFFF
+
+/// <summary>
+/// true if sequence a is newer than b, handles wrap around
+/// </summary>
+inline bool sequence_greater_than(uint16_t a, uint16_t b) {
+    return ((a > b) && (a - b <= 32768)) || ((a < b) && (b - a > 32768));
+}
 
 /// <summary>
 /// All the players positions
+/// Bit packed with the session Transform_codec and delta encoded against
+/// the last snapshot the client acked, see snapshot_delta.h
 /// </summary>
 struct Net_game_transforms_snapshot {
     uint8_t type;
+    uint16_t sequence;
+    uint32_t session_timestamp; // ms, the clients extrapolate the entities from the snapshot they were last in
 
     uint8_t num_players;
     uint8_t num_items;
 
-    std::vector<uint8_t> player_transforms;
-    std::vector<uint8_t> item_transforms;
+    std::vector<Transform_q> player_transforms;
+    std::vector<Transform_q> item_transforms;
 
     Net_game_transforms_snapshot() : type((uint8_t)MsgType::NetGameTransformsSnapshot) {
+        sequence = 0;
+        session_timestamp = 0;
         num_players = 0;
         num_items = 0;
     }
 
-    void set_buffer(std::vector<uint8_t>& data, uint32_t offset) {
-        memcpy(&data[offset], this, 3);
-        memcpy(&data[offset + 3], &player_transforms[0], player_transforms.size());
-        //memcpy(&data[offset + 3 + player_transforms.size()], &item_transforms[0], item_transforms.size());
+    uint32_t header_size() const {
+        return sizeof(uint8_t) + sizeof(uint16_t) * 2 + sizeof(uint32_t) + sizeof(uint8_t) * 2;
     }
+};
+
+/// <summary>
+/// Sent from the client over UDP when it has received a transform snapshot
+/// the server will delta encode the next snapshots against this one
+/// </summary>
+struct Net_game_transforms_ack {
+    uint8_t type;
+    uint16_t sequence;
+
+    Net_game_transforms_ack() : type((uint8_t)MsgType::NetGameTransformsAck), sequence(0) {}
+};
 
-    uint32_t size() const {
-        return 3 + player_transforms.size() * (6 + 7);
+/// <summary>
+/// The quantization settings of the session, sent before the game starts
+/// so the client can read and write bit packed transforms
+/// </summary>
+struct Net_transform_codec_config {
+    uint8_t     type;
+    float       bounds_min[3];
+    float       bounds_max[3];
+    float       position_precision;
+    uint8_t     rotation_bits;
+    uint8_t     velocity_enabled;
+    float       max_speed;
+    float       velocity_precision;
+
+    Net_transform_codec_config(const Transform_codec& codec) : type((uint8_t)MsgType::NetTransformCodecConfig) {
+        for (int i = 0; i < 3; ++i) {
+            bounds_min[i] = codec.bounds_min[i];
+            bounds_max[i] = codec.bounds_max[i];
+        }
+
+        position_precision = codec.position_precision;
+        rotation_bits = (uint8_t)codec.rotation_bits;
+        velocity_enabled = codec.velocity_enabled ? 1 : 0;
+        max_speed = codec.max_speed;
+        velocity_precision = codec.velocity_precision;
     }
 };
 
 /// <summary>
 /// Player position and rotation
+/// type | player_index | tick (16 bits) | transform bit packed with the session Transform_codec
+/// The size depends on the codec, so use read() instead of sizeof
 /// </summary>
 struct Net_pos {
     uint8_t     type;
     uint8_t     player_index;
-    uint16_t    pos[3];
-    uint8_t     rot[7];
+    uint16_t    tick; // the world tick the client made the input for, wraps around
+    Transform_q transform;
 
     Net_pos() {
         type = (uint8_t)MsgType::NetPlayerPos;
         player_index = 0;
+        tick = 0;
     }
 
-    Net_pos(const std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(this, &data[off], sizeof(Net_pos));
-    }
+    /// <summary>
+    /// Reads the packet at off, returns the number of bytes consumed or 0 if the packet is truncated
+    /// </summary>
+    uint32_t read(const std::vector<uint8_t>& data, uint32_t off, int32_t len, const Transform_codec& codec) {
+        if (len < 2) {
+            return 0;
+        }
 
-    void set_buffer(std::vector<uint8_t>& data, uint32_t off) {
-        memcpy(&data[off], this, sizeof(Net_pos));
+        return read(data.data() + off, (uint32_t)len, codec);
     }
 
-    void print() {
-        printf("[MSG-POS][E: %d][x: %d][y: %d][z: %d]\n", player_index, pos[0], pos[1], pos[2]);
-        printf("[MSG-POS][DEBUG][x: %f][y: %f][z: %f]\n", ((float)pos[0]) / 100.0f, ((float)pos[1]) / 100.0f, ((float)pos[2]) / 100.0f);
-    }
+    uint32_t read(const uint8_t* data, uint32_t len, const Transform_codec& codec) {
+        if (len < 4) {
+            return 0;
+        }
 
-    glm::vec3 to_vec3() const {
-        return glm::vec3(((float)pos[0]) / 100.0f, ((float)pos[0]) / 100.0f, ((float)pos[0]) / 100.0f);
-    }
+        type = data[0];
+        player_index = data[1];
+        tick = (uint16_t)(data[2] | (data[3] << 8));
 
-    glm::quat to_quat() const {
-        uint8_t maxindex = rot[0];
+        Bit_reader reader(data + 4, len - 4);
 
-        if (maxindex >= 4 && maxindex <= 7)
-        {
-            float x = (maxindex == 4) ? 1.0f : 0.0f;
-            float y = (maxindex == 5) ? 1.0f : 0.0f;
-            float z = (maxindex == 6) ? 1.0f : 0.0f;
-            float w = (maxindex == 7) ? 1.0f : 0.0f;
+        if (!codec.read(reader, transform)) {
+            return 0;
+        }
 
-            return glm::quat(x, y, z, w);
+        return 4 + reader.bytes_read();
+    }
+
+    /// <summary>
+    /// Writes the packet at off, returns the number of bytes written
+    /// </summary>
+    uint32_t write(std::vector<uint8_t>& data, uint32_t off, const Transform_codec& codec) const {
+        if (data.size() < off + 4) {
+            data.resize(off + 4);
         }
 
-        uint16_t v[3];
+        data[off] = type;
+        data[off + 1] = player_index;
+        data[off + 2] = (uint8_t)(tick & 0xff);
+        data[off + 3] = (uint8_t)(tick >> 8);
 
-        memcpy(&v[0], &rot[1], sizeof(uint16_t));
-        memcpy(&v[1], &rot[3], sizeof(uint16_t));
-        memcpy(&v[2], &rot[5], sizeof(uint16_t));
+        Bit_writer writer(data, off + 4);
+        codec.write(writer, transform);
 
-        // Read the other three fields and derive the value of the omitted field
-        float a = (float)v[0] / FLOAT_PRECISION_MULT;
-        float b = (float)v[1] / FLOAT_PRECISION_MULT;
-        float c = (float)v[2] / FLOAT_PRECISION_MULT;
-        float d = sqrt(1.0f - (a * a + b * b + c * c));
+        return 4 + writer.flush();
+    }
 
-        if (maxindex == 0)
-        {
-            return glm::quat(d, a, b, c);
-        }
-        else if (maxindex == 1)
-        {
-            return glm::quat(a, d, b, c);
-        }
-        else if (maxindex == 2)
-        {
-            return glm::quat(a, b, d, c);
-        }
+    void print(const Transform_codec& codec) const {
+        glm::vec3 pos = codec.position(transform);
 
-        return glm::quat(a, b, c, d);
+        printf("[MSG-POS][E: %d][x: %d][y: %d][z: %d]\n", player_index, transform.pos[0], transform.pos[1], transform.pos[2]);
+        printf("[MSG-POS][DEBUG][x: %f][y: %f][z: %f]\n", pos.x, pos.y, pos.z);
     }
+};
 
-    
+/// <summary>
+/// Starts every UDP datagram once the UDP connection is established
+/// ack is the newest datagram sequence we have received from the other side,
+/// bit n of ack_bits is set if we have also received ack - 1 - n
+/// timestamp is the sender clock in milliseconds when the datagram was written
+/// The rest of the datagram is messages, as many as fit
+/// </summary>
+struct Net_datagram_header {
+    uint8_t     type;
+    uint16_t    sequence;
+    uint16_t    ack;
+    uint32_t    ack_bits;
+    uint32_t    timestamp;
+
+    Net_datagram_header() : type((uint8_t)MsgType::NetDatagram), sequence(0), ack(0), ack_bits(0), timestamp(0) {}
+};
+
+/// <summary>
+/// A message on one of the reliable UDP channels, followed by length bytes of message data
+/// The message data is a regular message, same as we would have sent over TCP
+/// </summary>
+struct Net_reliable_header {
+    uint8_t     type;
+    uint8_t     channel;
+    uint16_t    message_id;
+    uint16_t    length;
+
+    Net_reliable_header() : type((uint8_t)MsgType::NetReliableMessage), channel(0), message_id(0), length(0) {}
+};
+
+/// <summary>
+/// A part of a message that is too large for a single datagram, followed by length bytes
+/// All fragments but the last carry FRAGMENT_SIZE bytes, so fragment_index * FRAGMENT_SIZE
+/// is where the data goes in the reassembled message
+/// Unreliable fragments are sent as is, reliable fragments are sent as individual reliable messages
+/// </summary>
+struct Net_fragment_header {
+    uint8_t     type;
+    uint16_t    group_id;   // the same for all fragments of a message, unique per sender
+    uint8_t     fragment_index;
+    uint8_t     num_fragments;
+    uint16_t    length;
+
+    Net_fragment_header() : type((uint8_t)MsgType::NetFragment), group_id(0), fragment_index(0), num_fragments(0), length(0) {}
 };
 
 struct Net_packet {
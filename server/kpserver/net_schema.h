@@ -0,0 +1,365 @@
+#pragma once
+
+#include "net_packet.h"
+#include "packet_view.h"
+#include "wire_schema.h"
+
+/// <summary>
+/// Wire schemas of the messages the servers read and write
+/// a message version is the NET_PROTOCOL_VERSION that brought its layout, so the version a
+/// connection settled on in the handshake is passed as is to wire_encode and wire_decode
+/// version 1 is the packed little endian layout the clients already use,
+/// the assert keeps the struct and the schema in sync so the fast path can read it in place
+/// the lobby messages at the end are compact since version 2, they are decoded,
+/// a client that stays at version 1 still gets and sends their packed layout
+/// </summary>
+#define NET_SCHEMA(T, version, ...) \
+    WIRE_SCHEMA(T, version, __VA_ARGS__); \
+    static_assert(!WIRE_HOST_LITTLE_ENDIAN || wire_in_place<T>(), #T " schema does not match the struct layout")
+
+// transport
+NET_SCHEMA(Net_datagram_header, 1,
+    WIRE_FIELD(Net_datagram_header, type),
+    WIRE_FIELD(Net_datagram_header, sequence),
+    WIRE_FIELD(Net_datagram_header, ack),
+    WIRE_FIELD(Net_datagram_header, ack_bits),
+    WIRE_FIELD(Net_datagram_header, timestamp));
+
+NET_SCHEMA(Net_reliable_header, 1,
+    WIRE_FIELD(Net_reliable_header, type),
+    WIRE_FIELD(Net_reliable_header, channel),
+    WIRE_FIELD(Net_reliable_header, message_id),
+    WIRE_FIELD(Net_reliable_header, length));
+
+NET_SCHEMA(Net_fragment_header, 1,
+    WIRE_FIELD(Net_fragment_header, type),
+    WIRE_FIELD(Net_fragment_header, group_id),
+    WIRE_FIELD(Net_fragment_header, fragment_index),
+    WIRE_FIELD(Net_fragment_header, num_fragments),
+    WIRE_FIELD(Net_fragment_header, length));
+
+NET_SCHEMA(Net_Udp_establish, 1,
+    WIRE_FIELD(Net_Udp_establish, type),
+    WIRE_FIELD(Net_Udp_establish, code),
+    WIRE_FIELD(Net_Udp_establish, client_id));
+
+NET_SCHEMA(Net_compression_request, 1,
+    WIRE_FIELD(Net_compression_request, type),
+    WIRE_FIELD(Net_compression_request, algorithms));
+
+NET_SCHEMA(Net_compression_config, 1,
+    WIRE_FIELD(Net_compression_config, type),
+    WIRE_FIELD(Net_compression_config, algorithm),
+    WIRE_FIELD(Net_compression_config, threshold));
+
+NET_SCHEMA(Net_compressed_frame, 1,
+    WIRE_FIELD(Net_compressed_frame, type),
+    WIRE_FIELD(Net_compressed_frame, raw_length),
+    WIRE_FIELD(Net_compressed_frame, length));
+
+// replies and handshake, to players and slaves
+NET_SCHEMA(Net_success, 1,
+    WIRE_FIELD(Net_success, type),
+    WIRE_FIELD(Net_success, msg));
+
+NET_SCHEMA(Net_error, 1,
+    WIRE_FIELD(Net_error, type),
+    WIRE_FIELD(Net_error, error));
+
+NET_SCHEMA(Net_protocol_version_request, 1,
+    WIRE_FIELD(Net_protocol_version_request, type),
+    WIRE_FIELD(Net_protocol_version_request, version));
+
+NET_SCHEMA(Net_protocol_version_response, 1,
+    WIRE_FIELD(Net_protocol_version_response, type),
+    WIRE_FIELD(Net_protocol_version_response, version));
+
+// player to slave
+NET_SCHEMA(Net_player_slave_list_sessions_request, 1,
+    WIRE_FIELD(Net_player_slave_list_sessions_request, type));
+
+NET_SCHEMA(Net_player_host_session_request, 1,
+    WIRE_FIELD(Net_player_host_session_request, type),
+    WIRE_FIELD(Net_player_host_session_request, is_private));
+
+NET_SCHEMA(Net_player_slave_join_public_session_request, 1,
+    WIRE_FIELD(Net_player_slave_join_public_session_request, type),
+    WIRE_FIELD(Net_player_slave_join_public_session_request, session_id));
+
+NET_SCHEMA(Net_player_slave_join_private_session_request, 1,
+    WIRE_FIELD(Net_player_slave_join_private_session_request, type),
+    WIRE_FIELD(Net_player_slave_join_private_session_request, code));
+
+NET_SCHEMA(Net_player_leave_session_request, 1,
+    WIRE_FIELD(Net_player_leave_session_request, type),
+    WIRE_FIELD(Net_player_leave_session_request, player_id),
+    WIRE_FIELD(Net_player_leave_session_request, session_id));
+
+NET_SCHEMA(Net_player_set_gamerule_int_request, 1,
+    WIRE_FIELD(Net_player_set_gamerule_int_request, type),
+    WIRE_FIELD(Net_player_set_gamerule_int_request, rule_id),
+    WIRE_FIELD(Net_player_set_gamerule_int_request, rule_value));
+
+NET_SCHEMA(Net_player_start_game_session_request, 1,
+    WIRE_FIELD(Net_player_start_game_session_request, type));
+
+NET_SCHEMA(Net_player_sync_time_request, 1,
+    WIRE_FIELD(Net_player_sync_time_request, type),
+    WIRE_FIELD(Net_player_sync_time_request, t0));
+
+NET_SCHEMA(Net_game_transforms_ack, 1,
+    WIRE_FIELD(Net_game_transforms_ack, type),
+    WIRE_FIELD(Net_game_transforms_ack, sequence));
+
+NET_SCHEMA(Net_session_snapshot_ack, 1,
+    WIRE_FIELD(Net_session_snapshot_ack, type),
+    WIRE_FIELD(Net_session_snapshot_ack, sequence));
+
+NET_SCHEMA(Net_player_set_item_state_request, 1,
+    WIRE_FIELD(Net_player_set_item_state_request, type),
+    WIRE_FIELD(Net_player_set_item_state_request, id),
+    WIRE_FIELD(Net_player_set_item_state_request, state),
+    WIRE_FIELD(Net_player_set_item_state_request, on));
+
+// slave to player
+NET_SCHEMA(Net_session_snapshot, 1,
+    WIRE_FIELD(Net_session_snapshot, type),
+    WIRE_FIELD(Net_session_snapshot, session_timestamp),
+    WIRE_FIELD(Net_session_snapshot, sequence),
+    WIRE_FIELD(Net_session_snapshot, num_items));
+
+NET_SCHEMA(Net_slave_session_item, 1,
+    WIRE_FIELD(Net_slave_session_item, session_id),
+    WIRE_FIELD(Net_slave_session_item, num_players),
+    WIRE_FIELD(Net_slave_session_item, max_players),
+    WIRE_FIELD(Net_slave_session_item, name));
+
+NET_SCHEMA(Net_player_host_session_response, 1,
+    WIRE_FIELD(Net_player_host_session_response, type),
+    WIRE_FIELD(Net_player_host_session_response, code),
+    WIRE_FIELD(Net_player_host_session_response, session_id),
+    WIRE_FIELD(Net_player_host_session_response, max_players));
+
+NET_SCHEMA(Net_player_slave_join_public_session_response, 1,
+    WIRE_FIELD(Net_player_slave_join_public_session_response, type),
+    WIRE_FIELD(Net_player_slave_join_public_session_response, session_id));
+
+NET_SCHEMA(Net_player_slave_join_private_session_response, 1,
+    WIRE_FIELD(Net_player_slave_join_private_session_response, type),
+    WIRE_FIELD(Net_player_slave_join_private_session_response, session_id));
+
+NET_SCHEMA(Net_player_has_left_session, 1,
+    WIRE_FIELD(Net_player_has_left_session, type),
+    WIRE_FIELD(Net_player_has_left_session, player_index),
+    WIRE_FIELD(Net_player_has_left_session, player_id),
+    WIRE_FIELD(Net_player_has_left_session, session_id));
+
+NET_SCHEMA(Net_game_rule_updated, 1,
+    WIRE_FIELD(Net_game_rule_updated, type),
+    WIRE_FIELD(Net_game_rule_updated, rule_id),
+    WIRE_FIELD(Net_game_rule_updated, rule_value));
+
+NET_SCHEMA(Net_player_start_game_session_response, 1,
+    WIRE_FIELD(Net_player_start_game_session_response, type),
+    WIRE_FIELD(Net_player_start_game_session_response, ok),
+    WIRE_FIELD(Net_player_start_game_session_response, start_timestamp));
+
+NET_SCHEMA(Net_game_session_will_start, 1,
+    WIRE_FIELD(Net_game_session_will_start, type),
+    WIRE_FIELD(Net_game_session_will_start, ok),
+    WIRE_FIELD(Net_game_session_will_start, start_timestamp));
+
+NET_SCHEMA(Net_transform_codec_config, 1,
+    WIRE_FIELD(Net_transform_codec_config, type),
+    WIRE_FIELD(Net_transform_codec_config, bounds_min),
+    WIRE_FIELD(Net_transform_codec_config, bounds_max),
+    WIRE_FIELD(Net_transform_codec_config, position_precision),
+    WIRE_FIELD(Net_transform_codec_config, rotation_bits),
+    WIRE_FIELD(Net_transform_codec_config, velocity_enabled),
+    WIRE_FIELD(Net_transform_codec_config, max_speed),
+    WIRE_FIELD(Net_transform_codec_config, velocity_precision));
+
+NET_SCHEMA(Net_game_session_has_started, 1,
+    WIRE_FIELD(Net_game_session_has_started, type),
+    WIRE_FIELD(Net_game_session_has_started, ok),
+    WIRE_FIELD(Net_game_session_has_started, start_timestamp),
+    WIRE_FIELD(Net_game_session_has_started, ticks_per_second));
+
+NET_SCHEMA(Net_game_session_has_ended, 1,
+    WIRE_FIELD(Net_game_session_has_ended, type),
+    WIRE_FIELD(Net_game_session_has_ended, ok));
+
+NET_SCHEMA(Net_session_world_init_item, 1,
+    WIRE_FIELD(Net_session_world_init_item, id),
+    WIRE_FIELD(Net_session_world_init_item, types),
+    WIRE_FIELD(Net_session_world_init_item, states));
+
+NET_SCHEMA(Net_player_sync_time_response, 1,
+    WIRE_FIELD(Net_player_sync_time_response, type),
+    WIRE_FIELD(Net_player_sync_time_response, t0),
+    WIRE_FIELD(Net_player_sync_time_response, t1),
+    WIRE_FIELD(Net_player_sync_time_response, session_time));
+
+NET_SCHEMA(Net_player_set_item_state_response, 1,
+    WIRE_FIELD(Net_player_set_item_state_response, type),
+    WIRE_FIELD(Net_player_set_item_state_response, success),
+    WIRE_FIELD(Net_player_set_item_state_response, id));
+
+NET_SCHEMA(Net_scene_item_state_updated, 1,
+    WIRE_FIELD(Net_scene_item_state_updated, type),
+    WIRE_FIELD(Net_scene_item_state_updated, id),
+    WIRE_FIELD(Net_scene_item_state_updated, state));
+
+// player to master
+NET_SCHEMA(Net_player_slave_node_request, 1,
+    WIRE_FIELD(Net_player_slave_node_request, type));
+
+NET_SCHEMA(Net_player_master_join_private_session_request, 1,
+    WIRE_FIELD(Net_player_master_join_private_session_request, type),
+    WIRE_FIELD(Net_player_master_join_private_session_request, code));
+
+// master to player
+NET_SCHEMA(Net_player_master_join_private_session_response, 1,
+    WIRE_FIELD(Net_player_master_join_private_session_response, type),
+    WIRE_FIELD(Net_player_master_join_private_session_response, slave_id),
+    WIRE_FIELD(Net_player_master_join_private_session_response, tcp_port),
+    WIRE_FIELD(Net_player_master_join_private_session_response, udp_port),
+    WIRE_FIELD(Net_player_master_join_private_session_response, ip));
+
+// between master and slaves
+NET_SCHEMA(Net_authenticate_slave, 1,
+    WIRE_FIELD(Net_authenticate_slave, type),
+    WIRE_FIELD(Net_authenticate_slave, slave_id),
+    WIRE_FIELD(Net_authenticate_slave, master_password));
+
+NET_SCHEMA(Net_slave_config, 1,
+    WIRE_FIELD(Net_slave_config, type),
+    WIRE_FIELD(Net_slave_config, node_id),
+    WIRE_FIELD(Net_slave_config, tcp_port),
+    WIRE_FIELD(Net_slave_config, udp_port),
+    WIRE_FIELD(Net_slave_config, hostname),
+    WIRE_FIELD(Net_slave_config, ip));
+
+NET_SCHEMA(Net_from_slave_sync_session, 1,
+    WIRE_FIELD(Net_from_slave_sync_session, type),
+    WIRE_FIELD(Net_from_slave_sync_session, session_id),
+    WIRE_FIELD(Net_from_slave_sync_session, num_players),
+    WIRE_FIELD(Net_from_slave_sync_session, code));
+
+NET_SCHEMA(Net_slave_health_snapshot, 1,
+    WIRE_FIELD(Net_slave_health_snapshot, type),
+    WIRE_FIELD(Net_slave_health_snapshot, pct_virt_process_ram_used),
+    WIRE_FIELD(Net_slave_health_snapshot, pct_good_vs_lag_ticks),
+    WIRE_FIELD(Net_slave_health_snapshot, avg_tick_idle_time),
+    WIRE_FIELD(Net_slave_health_snapshot, pct_cpu_load_process),
+    WIRE_FIELD(Net_slave_health_snapshot, num_connected_players));
+
+NET_SCHEMA(Net_master_to_slave_command, 1,
+    WIRE_FIELD(Net_master_to_slave_command, type),
+    WIRE_FIELD(Net_master_to_slave_command, command));
+
+// lobby and handshake, mostly empty name and address buffers
+// version 1 is the packed layout, since version 2 they are sent as length prefixed strings,
+// varint ids and avatars without the unused parts
+// the password and the ports are random or large, a varint would make them longer
+WIRE_SCHEMA(Net_authenticate_player, 2,
+    WIRE_FIELD(Net_authenticate_player, type),
+    WIRE_FIELD(Net_authenticate_player, client_password),
+    WIRE_FIELD_UNTIL(Net_authenticate_player, username, 1),
+    WIRE_FIELD_UNTIL(Net_authenticate_player, avatar, 1),
+    WIRE_STRING(Net_authenticate_player, username, 2),
+    WIRE_PACKED(Net_authenticate_player, avatar, 2));
+
+WIRE_SCHEMA(Net_player_has_joined_session, 2,
+    WIRE_FIELD(Net_player_has_joined_session, type),
+    WIRE_FIELD(Net_player_has_joined_session, player_short_id),
+    WIRE_FIELD_UNTIL(Net_player_has_joined_session, session_id, 1),
+    WIRE_FIELD_UNTIL(Net_player_has_joined_session, username, 1),
+    WIRE_FIELD_UNTIL(Net_player_has_joined_session, avatar, 1),
+    WIRE_VARINT(Net_player_has_joined_session, session_id, 2),
+    WIRE_STRING(Net_player_has_joined_session, username, 2),
+    WIRE_PACKED(Net_player_has_joined_session, avatar, 2));
+
+WIRE_SCHEMA(Net_player_slave_node_response, 2,
+    WIRE_FIELD(Net_player_slave_node_response, type),
+    WIRE_FIELD_UNTIL(Net_player_slave_node_response, slave_id, 1),
+    WIRE_VARINT(Net_player_slave_node_response, slave_id, 2),
+    WIRE_FIELD(Net_player_slave_node_response, tcp_port),
+    WIRE_FIELD(Net_player_slave_node_response, udp_port),
+    WIRE_FIELD_UNTIL(Net_player_slave_node_response, ip, 1),
+    WIRE_STRING(Net_player_slave_node_response, ip, 2));
+
+WIRE_SCHEMA(Net_Udp_client_connection_info, 2,
+    WIRE_FIELD(Net_Udp_client_connection_info, type),
+    WIRE_FIELD(Net_Udp_client_connection_info, code),
+    WIRE_FIELD_UNTIL(Net_Udp_client_connection_info, client_id, 1),
+    WIRE_VARINT(Net_Udp_client_connection_info, client_id, 2),
+    WIRE_FIELD(Net_Udp_client_connection_info, port),
+    WIRE_FIELD_UNTIL(Net_Udp_client_connection_info, ip, 1),
+    WIRE_STRING(Net_Udp_client_connection_info, ip, 2));
+
+// version 1 is still the packed struct, the clients that dont ask for a version read it
+static_assert(!WIRE_HOST_LITTLE_ENDIAN || Wire_schema<Net_authenticate_player>::fields::contiguous(0, 1), "Net_authenticate_player version 1 does not match the struct layout");
+static_assert(!WIRE_HOST_LITTLE_ENDIAN || Wire_schema<Net_player_has_joined_session>::fields::contiguous(0, 1), "Net_player_has_joined_session version 1 does not match the struct layout");
+static_assert(!WIRE_HOST_LITTLE_ENDIAN || Wire_schema<Net_player_slave_node_response>::fields::contiguous(0, 1), "Net_player_slave_node_response version 1 does not match the struct layout");
+static_assert(!WIRE_HOST_LITTLE_ENDIAN || Wire_schema<Net_Udp_client_connection_info>::fields::contiguous(0, 1), "Net_Udp_client_connection_info version 1 does not match the struct layout");
+
+// variable length messages, a header with a count and then the elements with their own schema
+// the counts are taken from the vectors so they always match what is written
+
+inline uint32_t wire_encode(const Net_game_config& msg, std::vector<uint8_t>& data, uint32_t off, uint8_t) {
+    uint16_t num_rules = (uint16_t)msg.rules.size();
+    uint32_t size = Wire_codec<uint8_t>::size + Wire_codec<uint16_t>::size * (1 + num_rules);
+
+    if (data.size() < off + size) {
+        data.resize(off + size);
+    }
+
+    uint8_t* out = &data[off];
+    out += Wire_codec<uint8_t>::put(out, msg.type);
+    out += Wire_codec<uint16_t>::put(out, num_rules);
+
+    for (uint16_t i = 0; i < num_rules; ++i) {
+        out += Wire_codec<uint16_t>::put(out, msg.rules[i]);
+    }
+
+    return size;
+}
+
+inline uint32_t wire_encode(const Net_session_world_init& msg, std::vector<uint8_t>& data, uint32_t off, uint8_t version) {
+    uint16_t num_items = (uint16_t)msg.items.size();
+    uint32_t size = Wire_codec<uint8_t>::size + Wire_codec<uint16_t>::size + num_items * wire_largest_size<Net_session_world_init_item>();
+
+    if (data.size() < off + size) {
+        data.resize(off + size);
+    }
+
+    uint8_t* out = &data[off];
+    out += Wire_codec<uint8_t>::put(out, msg.type);
+    out += Wire_codec<uint16_t>::put(out, num_items);
+
+    for (uint16_t i = 0; i < num_items; ++i) {
+        out += wire_encode(msg.items[i], out, version);
+    }
+
+    return (uint32_t)(out - &data[off]);
+}
+
+inline uint32_t wire_encode(const Net_player_slave_list_sessions_response& msg, std::vector<uint8_t>& data, uint32_t off, uint8_t version) {
+    uint8_t num_sessions = (uint8_t)(msg.sessions.size() < UINT8_MAX ? msg.sessions.size() : UINT8_MAX);
+    uint32_t size = Wire_codec<uint8_t>::size * 2 + num_sessions * wire_largest_size<Net_slave_session_item>();
+
+    if (data.size() < off + size) {
+        data.resize(off + size);
+    }
+
+    uint8_t* out = &data[off];
+    out += Wire_codec<uint8_t>::put(out, msg.type);
+    out += Wire_codec<uint8_t>::put(out, num_sessions);
+
+    for (uint8_t i = 0; i < num_sessions; ++i) {
+        out += wire_encode(msg.sessions[i], out, version);
+    }
+
+    return (uint32_t)(out - &data[off]);
+}
@@ -3,8 +3,10 @@
 #include "tcp_server.h"
 #include "udp_server.h"
 #include "net_client.h"
+#include "net_schema.h"
 
 #include <cstdlib>
+#include <algorithm>
 #include <stdio.h>
 #include <string>
 #include <stdlib.h>
@@ -25,7 +27,9 @@ Net_session::Net_session(uint8_t max_players, uint32_t keepalive_seconds, Tcp_se
         _world(std::make_unique<World_instance>()),
         _game_running(false),
         _game_starting(false),
-        _time_since_snapshot(0) {
+        _time_since_snapshot(0),
+        _item_snapshot_interval(1.0),
+        _transform_sequence(0) {
 
     // when an item has had its state updated in the scene
     // we send out to all players which item and which state
@@ -37,7 +41,7 @@ Net_session::Net_session(uint8_t max_players, uint32_t keepalive_seconds, Tcp_se
         updated.id = id;
         updated.state = state;
         
-        broadcast_tcp(&updated, sizeof(Net_scene_item_state_updated));
+        broadcast_reliable(updated);
     });*/
     
     _players.resize(max_players);
@@ -147,18 +151,33 @@ void Net_session::remove_player(Net_client* client) {
     }
 }
 
-void Net_session::broadcast_udp(void* data, uint32_t len) {
-    for (auto& player : _players) {
-        player.client_connection->add_udp_data(data, len);
-    }
-}
+/// <summary>
+/// Everything a player needs when joining, the game config and the state of every scene item
+/// The world is usually larger than a datagram, the reliable channel sends it fragmented
+/// </summary>
+/// <param name="client"></param>
+void Net_session::send_join_state(Net_client* client) {
+    game_config.num_rules = (uint16_t)game_config.rules.size();
 
-void Net_session::broadcast_tcp(void* data, uint32_t len) {
-    for (auto& player : _players) {
-        player.client_connection->add_tcp_data(data, len);
+    client->add_reliable_message(game_config);
+
+    Net_session_world_init init;
+
+    const Scene& scene = _world->scene;
+
+    for (uint32_t i = 0; i < scene.num_items(); ++i) {
+        Net_session_world_init_item init_item;
+        init_item.id = scene.id((uint16_t)i);
+        init_item.types = scene.types((uint16_t)i);
+        init_item.states = scene.states((uint16_t)i);
+
+        init.items.push_back(init_item);
     }
-}
 
+    init.num_items = (uint16_t)init.items.size();
+
+    client->add_reliable_message(init);
+}
 
 Net_client* Net_session::find_client(Net_client* client) const {
     for (auto& player : _players) {
@@ -180,7 +199,11 @@ void Net_session::on_udp_data(const std::vector<uint8_t>& data, int32_t data_len
 }
 
 void Net_session::handle_inc_pos(const std::vector<uint8_t>& data) {
-    Net_pos pos(data, 0);
+    Net_pos pos;
+
+    if (pos.read(data, 0, (int32_t)data.size(), _world->codec) == 0) {
+        return;
+    }
 
     if (_on_pos != nullptr) {
         _on_pos(pos);
@@ -195,8 +218,19 @@ int32_t Net_session::on_tcp_data(const std::vector<uint8_t>& data, uint32_t offs
     return 0;
 }
 
-void Net_session::on_inc_pos(const Net_pos& pos) {
-    _world->on_player_pos(pos);
+void Net_session::on_inc_pos(Net_client* client, const Net_pos& pos) {
+    for (auto& player : _players) {
+        if (player.is_set && player.client_connection == client) {
+            if (player.world_index != pos.player_index) {
+                _world->movement.counters.rejected++;
+                return;
+            }
+
+            // validated and applied when the world steps the tick it is stamped with, see update_game
+            _world->on_player_input(pos);
+            return;
+        }
+    }
 }
 
 void Net_session::set_on_pos(std::function<void(const Net_pos&)> func) {
@@ -213,7 +247,7 @@ bool Net_session::remove_player_and_broadcast(Net_client* client, bool broadcast
 
     if (broadcast) {
         Net_player_has_left_session resp(client->info.player_short_id, client->info.client_id, _id);
-        broadcast_tcp(&resp, sizeof(Net_player_has_joined_session));
+        broadcast_reliable(resp);
     }
 
     return true;
@@ -237,8 +271,8 @@ bool Net_session::add_player_and_broadcast(Net_client* client, bool broadcast, b
 
     if (broadcast) {
         Net_player_has_joined_session resp(_num_players, _id, client->info.username);
-        _num_players++;
-        broadcast_tcp(&resp, sizeof(Net_player_has_joined_session));
+
+        broadcast_reliable(resp);
     }
     
     return true;
@@ -288,13 +322,44 @@ void Net_session::on_game_started(std::chrono::time_point<std::chrono::high_reso
     _game_end_time = std::chrono::high_resolution_clock::now() + std::chrono::seconds(game_config.rules[GameRule::GameSeconds]);
     _last_tick = now;
 
+    // the world keeps the players in slot order so the Net_pos player_index maps directly,
+    // the players of an earlier game are cleared so the indices start over
+    _world->clear_players();
+
+    uint8_t world_index = 0;
+
+    for (int i = 0; i < _players.size(); ++i) {
+        if (_players[i].is_set) {
+            _world->add_player(_players[i].net_player_short_id);
+            _players[i].world_index = world_index++;
+        }
+
+        _players[i].baselines.reset();
+        _players[i].priority.reset();
+    }
+
+    _world->start();
+
+    for (auto& player : _players) {
+        player.items.reset(_world->scene.num_items());
+    }
+
+    // the clients need the quantization settings before the first snapshot arrives
+    Net_transform_codec_config codec_config(_world->codec);
+
     Net_game_session_has_started start;
     start.ok = 1;
     start.start_timestamp = now.time_since_epoch().count();
+    start.ticks_per_second = (uint16_t)_world->get_tick_rate();
 
     // notify all clients that a game has started
     for (int i = 0; i < _players.size(); ++i) {
-        _players[i].client_connection->add_tcp_data(&start, sizeof(Net_game_session_has_started));
+        if (!_players[i].is_set) {
+            continue;
+        }
+
+        _players[i].client_connection->add_reliable_message(codec_config);
+        _players[i].client_connection->add_reliable_message(start);
     }
 }
 
@@ -305,17 +370,71 @@ void Net_session::on_game_started(std::chrono::time_point<std::chrono::high_reso
 void Net_session::on_game_ended(std::chrono::time_point<std::chrono::high_resolution_clock>& now) {
     _game_running = false;
 
+    _world->movement.counters.print("session");
+    _world->inputs.counters.print("session");
+    TRACE("--- Interactions rejected (session): %llu\n", (unsigned long long)_world->interactions_rejected);
+
     Net_game_session_has_ended end;
     end.ok = 1;
     
-    // notify all clients that a game has started
+    // notify all clients that the game has ended
     for (int i = 0; i < _players.size(); ++i) {
-        _players[i].client_connection->add_tcp_data(&end, sizeof(Net_game_session_has_ended));
+        if (_players[i].is_set) {
+            _players[i].client_connection->add_reliable_message(end);
+        }
     }
 }
 
+/// <summary>
+/// Sends every player the item states it hasnt acked, the changes since the last
+/// snapshot are added to what each player is missing
+/// Unacked items are sent again in every snapshot until the player acks one that has them
+/// </summary>
 void Net_session::on_time_for_snapshot() {
-    broadcast_udp(&_snapshot, sizeof(Net_session_snapshot));
+    Item_changes& changes = _world->item_changes;
+
+    Net_session_snapshot snapshot;
+    snapshot.session_timestamp = _session_timestamp;
+    snapshot.sequence = changes.sequence;
+    snapshot.num_items = (uint16_t)changes.states.size();
+
+    // the snapshot has to fit in a datagram next to the datagram header
+    uint32_t budget = UDP_MAX_DATAGRAM_SIZE - sizeof(Net_datagram_header);
+
+    for (auto& player : _players) {
+        if (!player.is_set || player.client_connection == NULL) {
+            continue;
+        }
+
+        player.items.add_changes(changes);
+
+        uint32_t size = item_snapshot_write(snapshot, changes, player.items.dirty, budget, _item_sent, _data_buffer, 0);
+        player.items.store(snapshot.sequence, _item_sent);
+
+        player.client_connection->add_udp_data(&_data_buffer[0], size);
+    }
+
+    changes.next_snapshot();
+}
+
+void Net_session::set_item_snapshot_interval(uint32_t milliseconds) {
+    _item_snapshot_interval = milliseconds / 1000.0;
+}
+
+void Net_session::set_transform_history(uint32_t milliseconds) {
+    _world->history.set_window(milliseconds);
+}
+
+void Net_session::set_tick_rate(uint32_t ticks_per_second) {
+    _world->set_tick_rate(ticks_per_second);
+}
+
+void Net_session::set_dead_reckoning(uint32_t threshold_mm, uint32_t max_interval_ms) {
+    _dead_reckoning.set_thresholds(threshold_mm / 1000.0f, DEAD_RECKONING_ROTATION_THRESHOLD, max_interval_ms);
+}
+
+void Net_session::set_level(std::shared_ptr<const Level> level) {
+    _world->set_level(std::move(level));
 }
 
 void Net_session::update_game(const double delta, std::chrono::time_point<std::chrono::high_resolution_clock>& now) {
@@ -339,7 +458,16 @@ void Net_session::update_game(const double delta, std::chrono::time_point<std::c
     _session_timestamp = (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(now - _game_start_time).count();
     _now = now;
 
-    if (_time_since_snapshot > 1.0f) {
+    // the world steps every tick up to the session time, a fixed length each, so it doesnt
+    // matter how the updates or the inputs fall, an update that is late catches up a few ticks
+    uint32_t target_tick = (uint32_t)((uint64_t)_session_timestamp * _world->get_tick_rate() / 1000);
+    float max_speed = game_config.rules[GameRule::PlayerMovementSpeed] / 1000.0f;
+
+    for (uint32_t steps = 0; _world->get_tick() < target_tick && steps < WORLD_MAX_CATCHUP_STEPS; ++steps) {
+        _world->step(max_speed);
+    }
+
+    if (_time_since_snapshot >= _item_snapshot_interval) {
         _time_since_snapshot = 0.0f;
 
         on_time_for_snapshot();
@@ -351,14 +479,119 @@ void Net_session::update_game(const double delta, std::chrono::time_point<std::c
     }
 }
 
+/// <summary>
+/// Sends the transforms to every player, delta encoded against
+/// the last snapshot each player has acked. Players without an
+/// acked snapshot get a full snapshot
+/// Each player only gets the entities within its area of interest,
+/// distant entities are sent at a lower rate
+/// The entities are ranked on accumulated priority and the snapshot
+/// is filled up to the player budget, the rest wait for the next send
+/// How often a player gets a snapshot and the budget follow the quality of its link
+/// The snapshot is written once per distinct baseline and entity set, see Snapshot_fanout
+/// Entities the client can extrapolate from its baseline are left out, see Dead_reckoning
+/// </summary>
+/// <param name="now"></param>
 void Net_session::send_udp(std::chrono::time_point<std::chrono::high_resolution_clock>& now) {
+    if (!_game_running) {
+        return;
+    }
+
     _world->fill_transform();
+    _world->data_transforms.sequence = _transform_sequence++;
+    _world->data_transforms.session_timestamp = _session_timestamp;
 
-    _world->data_transforms.set_buffer(_data_buffer, 0);
-    uint32_t size = _world->data_transforms.size();
+    _fanout.begin(_world->data_transforms, _world->codec);
 
     for (int i = 0; i < _players.size(); ++i) {
-        _udp_server->send_client(_players[i].client_connection, _data_buffer, size);
+        Net_session_player& player = _players[i];
+
+        if (!player.is_set || player.client_connection == NULL) {
+            continue;
+        }
+
+        Link_quality& link = player.client_connection->link;
+
+        link.update(now);
+
+        if (!link.is_send_due(now)) {
+            continue;
+        }
+
+        _world->interest.gather(player.world_index, _world->data_transforms.sequence, _interest_entities);
+
+        float dt = player.priority.begin(now);
+
+        const Snapshot_baseline* baseline = player.baselines.get_acked();
+        uint32_t num_candidates = 0;
+
+        for (uint8_t entity : _interest_entities) {
+            // the client already has it where it is, nothing to catch up on
+            if (!_dead_reckoning.needs_update(_world->data_transforms, baseline, entity, _world->codec)) {
+                player.priority.sent(entity);
+                continue;
+            }
+
+            player.priority.accumulate(entity, _world->interest.relevance(player.world_index, entity) * dt);
+            _interest_entities[num_candidates++] = entity;
+        }
+
+        _interest_entities.resize(num_candidates);
+
+        player.priority.sort(_interest_entities);
+
+        // players that acked the same snapshot share the entity costs and the encoded snapshot
+        uint32_t group = _fanout.group(baseline);
+
+        // the snapshot has to fit in a datagram next to the datagram header
+        uint32_t budget = std::min(link.budget(), (uint32_t)(UDP_MAX_DATAGRAM_SIZE - sizeof(Net_datagram_header)));
+
+        snapshot_fit_budget(_world->data_transforms, _fanout.entity_bits(group), _interest_entities, budget, _send_entities);
+
+        for (uint8_t entity : _send_entities) {
+            player.priority.sent(entity);
+        }
+
+        uint32_t size = 0;
+        const uint8_t* data = _fanout.encode(group, _send_entities, size);
+
+        player.baselines.store(_world->data_transforms.sequence, _world->data_transforms, _send_entities);
+        link.on_sent(_world->data_transforms.sequence, now);
+
+        // copied into the datagrams of the client, sent with the rest of the tick by Net_client::send_udp_data
+        player.client_connection->add_udp_data((void*)data, size);
+    }
+}
+
+const Transform_codec& Net_session::get_transform_codec() const {
+    return _world->codec;
+}
+
+/// <summary>
+/// The client has received a transform snapshot, we can now use it as the delta baseline
+/// </summary>
+/// <param name="client"></param>
+/// <param name="sequence"></param>
+void Net_session::on_transforms_ack(Net_client* client, uint16_t sequence) {
+    for (auto& player : _players) {
+        if (player.is_set && player.client_connection == client) {
+            player.baselines.ack(sequence);
+            return;
+        }
+    }
+}
+
+/// <summary>
+/// The client has received an item snapshot, the items in it that havent changed since are clean
+/// </summary>
+/// <param name="client"></param>
+/// <param name="sequence"></param>
+void Net_session::on_item_snapshot_ack(Net_client* client, uint16_t sequence) {
+    for (auto& player : _players) {
+        if (player.is_set && player.client_connection == client) {
+            player.items.ack(sequence, _world->item_changes);
+            return;
+        }
     }
 }
 
@@ -374,7 +607,13 @@ bool Net_session::set_game_rule(uint16_t rule_id, uint16_t rule_value) {
 
 void Net_session::msg_item_set(Net_client* client, const Net_player_set_item_state_request& request) {
     Net_player_set_item_state_response resp;
-    
-    _world->set_item_state(request, resp);
-    _world->set_item_snapshot_data(_snapshot.items);
+
+    for (auto& player : _players) {
+        if (player.is_set && player.client_connection == client) {
+            // the change goes out with the next item snapshot, the response tells the player if it was accepted
+            _world->set_item_state(player.world_index, request, resp);
+            client->add_reliable_message(resp);
+            return;
+        }
+    }
 }
@@ -8,10 +8,12 @@
 #include <unordered_map>
 
 #include "net_packet.h"
+#include "net_client.h"
 #include "world_instance.h"
 #include "hash.h"
 #include "net_session_player.h"
 #include "world_snapshot.h"
+#include "dead_reckoning.h"
 
 struct Tcp_server;
 struct Udp_server;
@@ -42,7 +44,8 @@ struct Net_session {
 
     int read();
 
-    void on_inc_pos(const Net_pos& pos);
+    // a client may only move its own player
+    void on_inc_pos(Net_client* client, const Net_pos& pos);
 
     void set_on_pos(std::function<void(const Net_pos&)> func);
 
@@ -60,8 +63,36 @@ struct Net_session {
 
     bool is_empty() const;
 
-    void broadcast_udp(void* data, uint32_t len);
-    void broadcast_tcp(void* data, uint32_t len);
+    // the message is encoded for each player, they can be on different protocol versions
+    template<typename T>
+    void broadcast_udp(const T& msg) {
+        for (auto& player : _players) {
+            if (player.is_set) {
+                player.client_connection->add_udp_message(msg);
+            }
+        }
+    }
+
+    template<typename T>
+    void broadcast_tcp(const T& msg) {
+        for (auto& player : _players) {
+            if (player.is_set) {
+                player.client_connection->add_tcp_message(msg);
+            }
+        }
+    }
+
+    // in game events, reliable and ordered over UDP so a lost TCP segment cant hold up the game
+    template<typename T>
+    void broadcast_reliable(const T& msg) {
+        for (auto& player : _players) {
+            if (player.is_set) {
+                player.client_connection->add_reliable_message(msg);
+            }
+        }
+    }
+
+    void send_join_state(Net_client* client);
 
     Net_client* find_client(Net_client* client) const;
 
@@ -100,6 +131,27 @@ struct Net_session {
 
     void msg_item_set(Net_client* client, const Net_player_set_item_state_request& request);
 
+    void on_transforms_ack(Net_client* client, uint16_t sequence);
+
+    void on_item_snapshot_ack(Net_client* client, uint16_t sequence);
+
+    // how often the changed item states are sent
+    void set_item_snapshot_interval(uint32_t milliseconds);
+
+    // how far back the transforms of the players are kept
+    void set_transform_history(uint32_t milliseconds);
+
+    // how often the world steps, the inputs are stamped with the tick
+    void set_tick_rate(uint32_t ticks_per_second);
+
+    // how far off the client extrapolation of an entity may be before it is sent, and how long it may go unsent
+    void set_dead_reckoning(uint32_t threshold_mm, uint32_t max_interval_ms);
+
+    // the level is shared with the other sessions on it
+    void set_level(std::shared_ptr<const Level> level);
+
+    const Transform_codec& get_transform_codec() const;
+
     Net_game_config game_config;
 private:
 
@@ -125,6 +177,9 @@ private:
     uint32_t _session_timestamp;
 
     double _time_since_snapshot;
+    double _item_snapshot_interval; // seconds
+
+    uint16_t _transform_sequence;
     
     Tcp_server* _tcp_server;
     Udp_server* _udp_server;
@@ -152,5 +207,15 @@ private:
 
     std::vector<uint8_t> _data_buffer;
 
-    Net_session_snapshot _snapshot;
+    // scratch list for the entities a player is interested in, reused every send
+    std::vector<uint8_t> _interest_entities;
+    std::vector<uint8_t> _send_entities;
+
+    // the transform snapshots of a send, written once for the players that get the same bytes
+    Snapshot_fanout _fanout;
+
+    Dead_reckoning _dead_reckoning;
+
+    // scratch set of the items written to a player snapshot
+    Item_bitset _item_sent;
 };
\ No newline at end of file
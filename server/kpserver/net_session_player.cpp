@@ -9,6 +9,7 @@
 Net_session_player::Net_session_player() {
     net_player_short_id = 0;
     entity_session_id = 0;
+    world_index = 0;
     net_session_id = 0;
     net_player_id = 0;
     net_client_id = 0;
@@ -27,6 +28,10 @@ void Net_session_player::assign(const Net_session_player& ref) {
     net_player_short_id = ref.net_player_short_id;
     net_client_id = ref.net_client_id;
     client_connection = ref.client_connection;
+    world_index = ref.world_index;
+    baselines = ref.baselines;
+    items = ref.items;
+    priority = ref.priority;
 
     is_set = true;
 }
@@ -35,6 +40,8 @@ void Net_session_player::assign(uint8_t net_player_short_id_, uint32_t client_id
     net_player_short_id = net_player_short_id_;
     net_client_id = client_id_;
     client_connection = client;
+    baselines.reset();
+    priority.reset();
 
     is_set = true;
 }
@@ -50,11 +57,15 @@ bool Net_session_player::is_valid_for_play() const {
 void Net_session_player::reset() {
     net_player_short_id = 0;
     entity_session_id = 0;
+    world_index = 0;
     net_session_id = 0;
     net_player_id = 0;
     net_client_id = 0;
     node_slave_id = 0;
     client_connection = 0;
+    baselines.reset();
+    items.reset(0);
+    priority.reset();
 
     is_set = false;
 }
\ No newline at end of file
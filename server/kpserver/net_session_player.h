@@ -6,6 +6,9 @@
 #include <vector>
 
 #include "hash.h"
+#include "snapshot_delta.h"
+#include "item_delta.h"
+#include "priority_accumulator.h"
 
 struct Net_client_info;
 struct Net_client;
@@ -23,6 +26,7 @@ struct Net_session_player {
     
     uint8_t net_player_short_id;
     uint16_t entity_session_id;
+    uint8_t world_index; // index of our entity in the World_instance, set when the game starts
     uint32_t net_session_id;
     uint32_t net_player_id;
     uint32_t net_client_id;
@@ -30,5 +34,14 @@ struct Net_session_player {
 
     Net_client* client_connection;
 
+    // the transform snapshots we have sent to this player, used for delta encoding
+    Snapshot_baselines baselines;
+
+    // the item states this player hasnt acked yet
+    Item_baselines items;
+
+    // which entities this player has waited longest for, decides what fits in the budget
+    Priority_accumulator priority;
+
     bool is_set;
 };
\ No newline at end of file
@@ -1,6 +1,8 @@
 #include "net_slave.h"
 
 #include "net_packet.h"
+#include "packet_view.h"
+#include "net_dispatch.h"
 #include "process_stats.h"
 #include "ini_file.h"
 #include "trace.h"
@@ -10,6 +12,7 @@ Net_slave::Net_slave(Ini_file* file, Process_stats* stats)
     :
     _ini_file(file), 
     _stats(stats),
+    _master_protocol_version(NET_PROTOCOL_VERSION_MIN),
     _num_players(0),
     _tick_check(0) {
 
@@ -25,8 +28,15 @@ Net_slave::Net_slave(Ini_file* file, Process_stats* stats)
     });
 
     _tcp.init(_my_node->tcp_port);
+    _tcp.block_list().configure(_my_node->block_ttl_seconds, _my_node->max_connections_per_ip, _my_node->blocked_ranges);
 
     _udp.init(_my_node->udp_port);
+    _udp.set_block_list(&_tcp.block_list());
+
+    _link_settings.min_rate = (float)_my_node->snapshot_rate_min;
+    _link_settings.max_rate = (float)_my_node->ticks_per_second_position_update_sends;
+    _link_settings.min_budget = _my_node->snapshot_budget_min;
+    _link_settings.max_budget = _my_node->snapshot_budget_max;
 
     _udp.set_on_client_data_callback([&](Net_client* client, const std::vector<uint8_t>& data, int32_t data_len){
         on_inc_client_udp_data(client, data, data_len);
@@ -47,26 +57,58 @@ Net_slave::Net_slave(Ini_file* file, Process_stats* stats)
 
 Net_slave::~Net_slave() {}
 
+/// <summary>
+/// Every message the slave accepts, who may send it and on which channel
+/// </summary>
+struct Net_slave_dispatch {
+    static constexpr Net_dispatch_table<Net_slave> table = {
+        // from the master
+        NET_MESSAGE(Net_slave, NetProtocolVersionResponse, Net_protocol_version_response, on_master_protocol_version, NET_CHANNEL_TCP, Master),
+        NET_MESSAGE(Net_slave, NetFromMasterToSlaveCommand, Net_master_to_slave_command, on_master_command, NET_CHANNEL_TCP, Master),
+
+        // player transport and game state over UDP
+        NET_MESSAGE(Net_slave, NetDatagram, Net_datagram_header, on_datagram, NET_CHANNEL_UDP, Player),
+        NET_STREAM(Net_slave, NetReliableMessage, on_reliable_message, NET_CHANNEL_UDP, Player),
+        NET_STREAM(Net_slave, NetFragment, on_fragment_message, NET_CHANNEL_UDP, Player),
+        NET_STREAM(Net_slave, NetPlayerPos, on_player_pos, NET_CHANNEL_UDP, Player),
+        NET_MESSAGE(Net_slave, NetGameTransformsAck, Net_game_transforms_ack, on_transforms_ack, NET_CHANNEL_UDP, Player),
+        NET_MESSAGE(Net_slave, NetSessionSnapshotAck, Net_session_snapshot_ack, on_session_snapshot_ack, NET_CHANNEL_UDP, Player),
+        NET_MESSAGE(Net_slave, NetPlayerSyncTimeRequest, Net_player_sync_time_request, on_sync_time_request, NET_CHANNEL_UDP, Player),
+
+        // player lobby messages over TCP or the reliable channels
+        NET_MESSAGE(Net_slave, NetProtocolVersionRequest, Net_protocol_version_request, on_protocol_version_request, NET_CHANNEL_TCP, Unauthenticated),
+        NET_MESSAGE(Net_slave, NetCompressionRequest, Net_compression_request, on_compression_request, NET_CHANNEL_TCP, Unauthenticated),
+        NET_MESSAGE(Net_slave, NetAuthenticatePlayer, Net_authenticate_player, on_authenticate_player, NET_CHANNEL_TCP, Unauthenticated),
+        NET_MESSAGE(Net_slave, NetPlayerSlaveListSessionsRequest, Net_player_slave_list_sessions_request, on_list_sessions_request, NET_CHANNEL_TCP, Player),
+        NET_MESSAGE(Net_slave, NetPlayerHostSessionRequest, Net_player_host_session_request, on_host_session_request, NET_CHANNEL_TCP, Player),
+        NET_MESSAGE(Net_slave, NetPlayerSlaveJoinPublicSessionRequest, Net_player_slave_join_public_session_request, on_join_public_session_request, NET_CHANNEL_TCP, Player),
+        NET_MESSAGE(Net_slave, NetPlayerSlaveJoinPrivateSessionRequest, Net_player_slave_join_private_session_request, on_join_private_session_request, NET_CHANNEL_TCP, Player),
+        NET_MESSAGE(Net_slave, NetPlayerLeaveSessionRequest, Net_player_leave_session_request, on_leave_session_request, NET_CHANNEL_TCP, Player),
+        NET_MESSAGE(Net_slave, NetPlayerSetGameRuleInt, Net_player_set_gamerule_int_request, on_set_gamerule_int, NET_CHANNEL_TCP, Player),
+        NET_MESSAGE(Net_slave, NetPlayerStartGameSessionRequest, Net_player_start_game_session_request, on_start_game_session_request, NET_CHANNEL_TCP, Player),
+
+        // in game events over TCP or the reliable channels
+        NET_MESSAGE(Net_slave, NetPlayerSetItemStateRequest, Net_player_set_item_state_request, on_set_item_state_request, NET_CHANNEL_TCP, Player)
+    };
+};
+
+constexpr Net_dispatch_table<Net_slave> Net_slave_dispatch::table;
+
+static_assert(Net_slave_dispatch::table.get(MsgType::NetDatagram).size == sizeof(Net_datagram_header), "the dispatch table is built at compile time");
+static_assert(!Net_slave_dispatch::table.has(MsgType::NetAuthenticateSlave), "slaves only authenticate players");
+
 /// <summary>
 /// When we get data from the master socket
 /// </summary>
 /// <param name="data"></param>
 /// <param name="data_len"></param>
 void Net_slave::on_inc_tcp_master_data(const std::vector<uint8_t>& data, int32_t data_len) {
-    if (data_len > 0) {
-        MsgType type = (MsgType)data[0];
-
-        switch (type) {
-            case MsgType::NetFromMasterToSlaveCommand:
-            {
-                Net_master_to_slave_command cmd(data, 0);
-                handle_master_command(cmd);
-                break;
-            }
-            default:
-                TRACE("[NET-SLAVE][UPDATE][ERROR][Unknown message type: %d]\n", type);
-                break;
-            }
+    Packet_reader reader(data, data_len);
+
+    NetDispatchResult result = net_dispatch(Net_slave_dispatch::table, *this, NULL, NET_CHANNEL_TCP, reader, _counters);
+
+    if (result != NetDispatchResult::Done && result != NetDispatchResult::Stopped) {
+        TRACE("[NET-SLAVE][ON-INC-TCP-MASTER-DATA][ERROR][Dropped data from master][%d]\n", (int)result);
     }
 }
 
@@ -78,53 +120,187 @@ void Net_slave::on_inc_tcp_master_data(const std::vector<uint8_t>& data, int32_t
 /// <param name="data_len"></param>
 void Net_slave::on_inc_client_udp_data(Net_client* client, const std::vector<uint8_t>& data, int32_t data_len) {
     // handle incoming UDP data from players
-    int32_t len = data_len;
-    uint32_t off = 0;
+    // a message we cant read drops the rest of the datagram
+    Packet_reader reader(data, data_len);
 
-    while (len > 0) {
-        MsgType type = (MsgType)(uint8_t)data[off];
+    net_dispatch(Net_slave_dispatch::table, *this, client, NET_CHANNEL_UDP, reader, _counters);
+}
 
-        switch (type) {
-        
-            case MsgType::NetPlayerPos:
-            {
-                Net_pos pos(data, off);
+bool Net_slave::on_master_command(Net_client*, const Net_master_to_slave_command& command) {
+    handle_master_command(command);
 
-                off += sizeof(Net_pos);
-                len -= sizeof(Net_pos);
+    return true;
+}
 
-                // we got an updated player position
-                // so we have to update the Net_session_player position values
+bool Net_slave::on_master_protocol_version(Net_client*, const Net_protocol_version_response& resp) {
+    // the master answers with the lower version, but it could be an older master that doesnt know ours
+    _master_protocol_version = net_protocol_version(resp.version);
 
-                _session_id_lookup[client->info.session_id]->on_inc_pos(pos);
+    TRACE("[NET-SLAVE][NetProtocolVersionResponse][Master protocol version: %d]\n", _master_protocol_version);
 
-                break;
-            }
-            // we want this via UDP so we get a more accurate timestamp
-            case MsgType::NetPlayerSyncTimeRequest:
-            {
-                Net_player_sync_time_request req(data, off);
-                off += sizeof(Net_player_sync_time_request);
-                len -= sizeof(Net_player_sync_time_request);
+    authenticate_with_master();
 
-                Net_player_sync_time_response res;
-                res.t0 = req.t0;
-                res.t1 = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    return true;
+}
 
-                res.session_time = _session_id_lookup[client->info.session_id]->get_time();
+uint8_t Net_slave::protocol_version(const Net_client* client) const {
+    return client != NULL ? client->info.protocol_version : _master_protocol_version;
+}
 
-                client->add_tcp_data(&res, sizeof(Net_player_sync_time_response));
+bool Net_slave::on_datagram(Net_client* client, const Net_datagram_header& header) {
+    // a duplicated datagram, we have already handled everything in it
+    return client->reliable.on_header(header);
+}
 
-                break;
-            }
-            case MsgType::NetPlayerChat:
-            {
-                //Net_chat()
-                break;
-            }
-            default: return;
+bool Net_slave::on_reliable_message(Net_client* client, Packet_reader& reader) {
+    const Net_reliable_header* header = reader.view<Net_reliable_header>();
+    const uint8_t* payload = header != NULL ? reader.bytes(header->length) : NULL;
+
+    if (payload == NULL) {
+        return false;
+    }
+
+    client->reliable.on_message(*header, payload);
+
+    deliver_reliable_messages(client);
+
+    return true;
+}
+
+bool Net_slave::on_fragment_message(Net_client* client, Packet_reader& reader) {
+    const Net_fragment_header* header = reader.view<Net_fragment_header>();
+    const uint8_t* payload = header != NULL ? reader.bytes(header->length) : NULL;
+
+    if (payload == NULL) {
+        return false;
+    }
+
+    auto now = std::chrono::high_resolution_clock::now();
+    const std::vector<uint8_t>* message = client->fragments.on_fragment(*header, payload, now);
+
+    if (message != NULL && is_deliverable(*message)) {
+        on_inc_client_udp_data(client, *message, (int32_t)message->size());
+    }
+
+    return true;
+}
+
+bool Net_slave::on_player_pos(Net_client* client, Packet_reader& reader) {
+    if (_session_id_lookup.find(client->info.session_id) == _session_id_lookup.end()) {
+        return false;
+    }
+
+    Net_session* session = _session_id_lookup[client->info.session_id];
+
+    // the transform is bit packed, so the size depends on the session codec
+    Net_pos pos;
+    uint32_t read = pos.read(reader.current(), reader.remaining(), session->get_transform_codec());
+
+    if (read == 0) {
+        TRACE("[NET-SLAVE][NetPlayerPos][ERROR][Truncated packet]\n");
+        return false;
+    }
+
+    reader.skip(read);
+
+    // we got an updated player position
+    // so we have to update the Net_session_player position values
+    session->on_inc_pos(client, pos);
+
+    return true;
+}
+
+bool Net_slave::on_transforms_ack(Net_client* client, const Net_game_transforms_ack& ack) {
+    auto now = std::chrono::high_resolution_clock::now();
+    client->link.on_acked(ack.sequence, now);
+
+    if (_session_id_lookup.find(client->info.session_id) != _session_id_lookup.end()) {
+        _session_id_lookup[client->info.session_id]->on_transforms_ack(client, ack.sequence);
+    }
+
+    return true;
+}
+
+bool Net_slave::on_session_snapshot_ack(Net_client* client, const Net_session_snapshot_ack& ack) {
+    auto session = _session_id_lookup.find(client->info.session_id);
+
+    if (session != _session_id_lookup.end()) {
+        session->second->on_item_snapshot_ack(client, ack.sequence);
+    }
+
+    return true;
+}
+
+// we want this via UDP so we get a more accurate timestamp
+bool Net_slave::on_sync_time_request(Net_client* client, const Net_player_sync_time_request& req) {
+    auto session = _session_id_lookup.find(client->info.session_id);
+
+    if (session == _session_id_lookup.end()) {
+        return true;
+    }
+
+    Net_player_sync_time_response res;
+    res.t0 = req.t0;
+    res.t1 = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+
+    client->link.on_sync_request(req.t0, res.t1);
+
+    res.session_time = session->second->get_time();
+
+    // unordered, a late time sync is worse than one that overtakes another message
+    client->add_reliable_message(res, ReliableChannel::Unordered);
+
+    return true;
+}
+
+/// <summary>
+/// Reliable messages from the client are the same messages it would send over TCP,
+/// so they go through the TCP handler once they are ready to be delivered
+/// </summary>
+/// <param name="client"></param>
+void Net_slave::deliver_reliable_messages(Net_client* client) {
+    while (client->reliable.pop_message(_reliable_buffer)) {
+        if (_reliable_buffer.empty()) {
+            continue;
+        }
+
+        if ((MsgType)_reliable_buffer[0] != MsgType::NetFragment) {
+            on_inc_client_tcp_data(client, _reliable_buffer, (int32_t)_reliable_buffer.size());
+            continue;
         }
+
+        Packet_reader reader(_reliable_buffer, (int32_t)_reliable_buffer.size());
+
+        const Net_fragment_header* header = reader.view<Net_fragment_header>();
+        const uint8_t* payload = header != NULL ? reader.bytes(header->length) : NULL;
+
+        if (payload == NULL) {
+            continue;
+        }
+
+        auto now = std::chrono::high_resolution_clock::now();
+        const std::vector<uint8_t>* message = client->fragments.on_fragment(*header, payload, now);
+
+        if (message != NULL && is_deliverable(*message)) {
+            on_inc_client_tcp_data(client, *message, (int32_t)message->size());
+        }
+    }
+}
+
+/// <summary>
+/// A reassembled message must be a regular message, transport messages
+/// inside it would let a client nest fragments in fragments
+/// </summary>
+/// <param name="message"></param>
+/// <returns></returns>
+bool Net_slave::is_deliverable(const std::vector<uint8_t>& message) const {
+    if (message.empty()) {
+        return false;
     }
+
+    MsgType type = (MsgType)message[0];
+
+    return type != MsgType::NetDatagram && type != MsgType::NetReliableMessage && type != MsgType::NetFragment;
 }
 
 bool Net_slave::find_client(Net_client* client) const {
@@ -220,310 +396,305 @@ void Net_slave::sync_session_with_master(Net_session* session) {
     sync.num_players = session->get_num_players();
     sync.session_id = session->get_id();
 
-    _master_connection.add_data(&sync, sizeof(Net_from_slave_sync_session));
+    add_master_message(sync);
 }
 
 void Net_slave::on_inc_client_tcp_data(Net_client* client, const std::vector<uint8_t>& data, int32_t data_len) {
     // incoming TCP data from clients/players
+    // a message we cant read drops the rest of the data
+    Packet_reader reader(data, data_len);
 
-    MsgType type = MsgType::None;
-    uint32_t off = 0;
-    int32_t len = data_len;
-    
-    if (client->info.type == NetClientType::Unauthenticated) {
+    NetDispatchResult result = net_dispatch(Net_slave_dispatch::table, *this, client, NET_CHANNEL_TCP, reader, _counters);
+
+    if (result == NetDispatchResult::NotAllowed && client->info.type == NetClientType::Unauthenticated) {
         // we only allow authentication packets
-        MsgType type = (MsgType)((uint8_t)data[off]);
-
-        switch (type) {
-            case MsgType::NetAuthenticatePlayer:
-            {
-                Net_authenticate_player auth(data, off);
-                len -= sizeof(Net_authenticate_player);
-                off += sizeof(Net_authenticate_player);
-
-                if (auth.client_password == _my_node->client_password) {
-                    TRACE("[NET-SLAVE][ON-INC-TCP-DATA][NetAuthenticatePlayer][SUCCESS]\n");
-                    client->info.type = NetClientType::Player;
-
-                    Net_success succ(NetSuccessType::None);
-
-                    client->add_tcp_data(&succ, sizeof(Net_success));
-                    break;
-                }
-                else {
-                    TRACE("[NET-SLAVE][ON-INC-TCP-DATA][NetAuthenticatePlayer][FAIL][Invalid password]\n");
-
-                    Net_error err(NetErrorType::InvalidPassword);
-                    
-                    client->add_tcp_data(&err, sizeof(Net_error));
-
-                    _tcp.disconnect(client);
-                    return;
-                }
-                break;
-            }
-            default:
-                // disconnect
-                TRACE("[NET-SLAVE][ON-INC-TCP-DATA][ERROR][Client tried to send message without authenticated state]\n");
-                _tcp.disconnect(client);
-                
-                return;
+        TRACE("[NET-SLAVE][ON-INC-TCP-DATA][ERROR][Client tried to send message without authenticated state]\n");
+        _tcp.disconnect(client);
+    }
+    else if (result == NetDispatchResult::Unknown) {
+        MsgType type = MsgType::None;
+        reader.peek_type(type);
+
+        TRACE("[NET-SLAVE][Uknown message][%d]\n", type);
+    }
+}
+
+bool Net_slave::on_protocol_version_request(Net_client* client, const Net_protocol_version_request& req) {
+    client->info.protocol_version = net_protocol_version(req.version);
+
+    client->add_tcp_message(Net_protocol_version_response(client->info.protocol_version));
+
+    return true;
+}
+
+bool Net_slave::on_compression_request(Net_client* client, const Net_compression_request& req) {
+    client->enable_tcp_compression(req.algorithms);
+
+    return true;
+}
+
+bool Net_slave::on_authenticate_player(Net_client* client, const Net_authenticate_player& auth) {
+    if (auth.client_password != _my_node->client_password) {
+        TRACE("[NET-SLAVE][ON-INC-TCP-DATA][NetAuthenticatePlayer][FAIL][Invalid password]\n");
+
+        Net_error err(NetErrorType::InvalidPassword);
+        
+        client->add_tcp_message(err);
+
+        _tcp.disconnect(client);
+        return false;
+    }
+
+    TRACE("[NET-SLAVE][ON-INC-TCP-DATA][NetAuthenticatePlayer][SUCCESS]\n");
+    client->info.type = NetClientType::Player;
+
+    Net_success succ(NetSuccessType::None);
+
+    client->add_tcp_message(succ);
+
+    return true;
+}
+
+bool Net_slave::on_list_sessions_request(Net_client* client, const Net_player_slave_list_sessions_request&) {
+    // player wants a list of sessions
+    Net_player_slave_list_sessions_response resp;
+    resp.num_sessions = 0;
+    
+    for (auto sess : _public_sessions) {
+        if (sess->is_full() || sess->is_empty()) {
+            continue;
         }
+
+        resp.sessions.push_back(Net_slave_session_item(sess->get_id(), "test", sess->get_num_players(), sess->get_max_players()));
+        resp.num_sessions++;
     }
 
-    while (len > 0) {
-        type = (MsgType)((uint8_t)data[off]);
+    // if theres no sessions, then we send an error?
+    client->add_tcp_message(resp);
 
-        switch (type) {
-            case MsgType::NetPlayerSlaveListSessionsRequest:
-            {
-                // player wants a list of sessions
-                off += sizeof(Net_player_slave_list_sessions_request);
-                len -= sizeof(Net_player_slave_list_sessions_request);
+    return true;
+}
 
-                Net_player_slave_list_sessions_response resp;
-                resp.num_sessions = 0;
-                
-                for (auto sess : _public_sessions) {
-                    if (sess->is_full() || sess->is_empty()) {
-                        continue;
-                    }
+bool Net_slave::on_host_session_request(Net_client* client, const Net_player_host_session_request& req) {
+    Net_session* session = find_client_session(client);
 
-                    resp.sessions.push_back(Net_slave_session_item(sess->get_id(), "test", sess->get_num_players(), sess->get_max_players()));
-                    resp.num_sessions++;
-                }
+    // dont allow a player to create a session if there already is a session associated with that player
+    if (session != NULL) {
+        TRACE("[NET-SLAVE][NetPlayerHostSessionRequest][ERROR][Already have sesssion]\n");
+        Net_error reject(NetErrorType::AlreadyHaveSession);
 
-                client->add_tcp_data(&resp, resp.header_size());
+        client->add_tcp_message(reject);
+        return true;
+    }
 
-                // if theres no sessions, then we send an error?
-                if (resp.num_sessions > 0) {
-                    client->add_tcp_data(&resp.sessions[0], resp.data_size());
-                }
+    // make sure there is an empty session
+    session = find_empty_session();
 
-                break;
-            }
-            case MsgType::NetPlayerHostSessionRequest:
-            {
-                Net_player_host_session_request req(data, off);
-                off += sizeof(Net_player_host_session_request);
-                len -= sizeof(Net_player_host_session_request);
+    if (session == NULL) {
+        TRACE("[NET-SLAVE][NetPlayerHostSessionRequest][ERROR][No available sessions]\n");
+        Net_error reject(NetErrorType::NoAvailableSessions);
 
-                Net_session* session = find_client_session(client);
+        client->add_tcp_message(reject);
+        return true;
+    }
 
-                // dont allow a player to create a session if there already is a session associated with that player
-                if (session != NULL) {
-                    TRACE("[NET-SLAVE][NetPlayerHostSessionRequest][ERROR][Already have sesssion]\n");
-                    Net_error reject(NetErrorType::AlreadyHaveSession);
+    // remove old session lookups
+    reset_session_lookups(session);
+    // generate a new private code
+    session->generate_session_code();
+    // assign the session as public/private
+    set_session_private(session, req.is_private == 1);
+    // add the new session lookups
+    set_session_lookups(session);
+
+    session->add_player_and_broadcast(client, false, true);
+
+    Net_player_host_session_response resp;
+    memcpy(resp.code, session->session_code, 8);
+    resp.session_id = session->get_id();
+    resp.max_players = session->get_max_players();
+    
+    client->add_tcp_message(resp);
 
-                    client->add_tcp_data(&reject, sizeof(Net_error));
-                    continue;
-                }
+    // lastly, notify the master that we have a user in the session
+    sync_session_with_master(session);
 
-                // make sure there is an empty session
-                session = find_empty_session();
+    print_sessions_summary();
 
-                if (session == NULL) {
-                    TRACE("[NET-SLAVE][NetPlayerHostSessionRequest][ERROR][No available sessions]\n");
-                    Net_error reject(NetErrorType::NoAvailableSessions);
+    return true;
+}
 
-                    client->add_tcp_data(&reject, sizeof(Net_error));
-                    continue;
-                }
+bool Net_slave::on_join_public_session_request(Net_client* client, const Net_player_slave_join_public_session_request& sess) {
+    if (_session_id_lookup.find(sess.session_id) == _session_id_lookup.end()) {
+        TRACE("[NET-SLAVE][NetPlayerSlaveJoinPublicSessionRequest][ERROR][Session not found]\n");
+        // session doesnt exist
+        Net_error err(NetErrorType::SessionNotFound);
+        client->add_tcp_message(err);
+        return true;
+    }
 
-                // remove old session lookups
-                reset_session_lookups(session);
-                // generate a new private code
-                session->generate_session_code();
-                // assign the session as public/private
-                set_session_private(session, req.is_private == 1);
-                // add the new session lookups
-                set_session_lookups(session);
+    Net_session* session = _session_id_lookup[sess.session_id];
 
-                session->add_player_and_broadcast(client, false, true);
+    if (session->is_full()) {
+        TRACE("[NET-SLAVE][NetPlayerSlaveJoinPublicSessionRequest][ERROR][Session is full]\n");
 
-                Net_player_host_session_response resp;
-                memcpy(resp.code, session->session_code, 8);
-                resp.session_id = session->get_id();
-                resp.max_players = session->get_max_players();
-                
-                client->add_tcp_data(&resp, sizeof(Net_player_host_session_response));
+        Net_error err(NetErrorType::SessionIsFull);
+        client->add_tcp_message(err);
+        return true;
+    }
 
-                // lastly, notify the master that we have a user in the session
-                sync_session_with_master(session);
+    Net_player_slave_join_public_session_response resp;
+    resp.session_id = session->get_id();
 
-                print_sessions_summary();
+    client->add_tcp_message(resp);
 
-                break;
-            }
-            case MsgType::NetPlayerSlaveJoinPublicSessionRequest:
-            {
-                Net_player_slave_join_public_session_request sess(data, off);
-                off += sizeof(Net_player_slave_join_public_session_request);
-                len -= sizeof(Net_player_slave_join_public_session_request);
+    // will assign session_id on client
+    session->add_player_and_broadcast(client, true, false);
 
-                if (_session_id_lookup.find(sess.session_id) == _session_id_lookup.end()) {
-                    TRACE("[NET-SLAVE][NetPlayerSlaveJoinPublicSessionRequest][ERROR][Session not found]\n");
-                    // session doesnt exist
-                    Net_error err(NetErrorType::SessionNotFound);
-                    client->add_tcp_data(&err, sizeof(Net_error));
-                    continue;
-                }
+    // also send out the game config and the world to the player that joined
+    session->send_join_state(client);
 
-                Net_session* session = _session_id_lookup[sess.session_id];
+    sync_session_with_master(session);
 
-                if (session->is_full()) {
-                    TRACE("[NET-SLAVE][NetPlayerSlaveJoinPublicSessionRequest][ERROR][Session is full]\n");
+    print_sessions_summary();
 
-                    Net_error err(NetErrorType::SessionIsFull);
-                    client->add_tcp_data(&err, sizeof(Net_error));
-                    continue;
-                }
+    return true;
+}
 
-                Net_player_slave_join_public_session_response resp;
-                resp.session_id = session->get_id();
+bool Net_slave::on_join_private_session_request(Net_client* client, const Net_player_slave_join_private_session_request& sess) {
+    // when a player tries to join a session
+    mmh::Hash_key key(sess.code);
 
-                client->add_tcp_data(&resp, sizeof(Net_player_slave_join_public_session_response));
+    if (_session_code_lookup.find(key.hash) == _session_code_lookup.end()) {
+        TRACE("[NET-SLAVE][NetPlayerSlaveJoinPrivateSessionRequest][ERROR][Session not found]\n");
 
-                // will assign session_id on client
-                session->add_player_and_broadcast(client, true, false);
+        // session doesnt exist
+        Net_error err(NetErrorType::SessionNotFound);
+        client->add_tcp_message(err);
+        return true;
+    }
 
-                // also send out the game config to the player that joined
-                client->add_tcp_data(&_session_id_lookup[client->info.session_id]->game_config, _session_id_lookup[client->info.session_id]->game_config.size());
+    // we found the session
+    Net_session* session = _session_code_lookup[key.hash];
+        
+    if (session->is_full()) {
+        TRACE("[NET-SLAVE][NetPlayerSlaveJoinPrivateSessionRequest][ERROR][Session is full]\n");
 
-                sync_session_with_master(session);
+        Net_error err(NetErrorType::SessionIsFull);
 
-                print_sessions_summary();
+        client->add_tcp_message(err);
+        return true;
+    }
 
-                break;
-            }
-            case MsgType::NetPlayerSlaveJoinPrivateSessionRequest:
-            {
-                // when a player tries to join a session
-                Net_player_slave_join_private_session_request sess(data, off);
-                off += sizeof(Net_player_slave_join_private_session_request);
-                len -= sizeof(Net_player_slave_join_private_session_request);
+    Net_player_slave_join_private_session_response resp;
+    resp.session_id = session->get_id();
+    
+    client->add_tcp_message(resp);
 
-                mmh::Hash_key key(sess.code);
+    // send out Net_player_has_joined_session to all players in session
+    session->add_player_and_broadcast(client, true, false);
 
-                if (_session_code_lookup.find(key.hash) == _session_code_lookup.end()) {
-                    TRACE("[NET-SLAVE][NetPlayerSlaveJoinPrivateSessionRequest][ERROR][Session not found]\n");
+    // also send out the game config and the world to the player that joined
+    session->send_join_state(client);
 
-                    // session doesnt exist
-                    Net_error err(NetErrorType::SessionNotFound);
-                    client->add_tcp_data(&err, sizeof(Net_error));
-                    continue;
-                }
+    sync_session_with_master(session);
 
-                // we found the session
-                Net_session* session = _session_code_lookup[key.hash];
-                    
-                if (session->is_full()) {
-                    TRACE("[NET-SLAVE][NetPlayerSlaveJoinPrivateSessionRequest][ERROR][Session is full]\n");
+    print_sessions_summary();
+    
+    return true;
+}
 
-                    Net_error err(NetErrorType::SessionIsFull);
+bool Net_slave::on_leave_session_request(Net_client* client, const Net_player_leave_session_request& req) {
+    // when a player wants to leave a session
+    if (_session_id_lookup.find(req.session_id) == _session_id_lookup.end()) {
+        TRACE("[NET-SLAVE][NetPlayerLeaveSessionRequest][ERROR][Session not found]\n");
 
-                    client->add_tcp_data(&err, sizeof(Net_error));
-                    continue;
-                }
+        Net_error err(NetErrorType::SessionNotFound);
+        client->add_tcp_message(err);
+        
+        return true;
+    }
 
-                Net_player_slave_join_private_session_response resp;
-                resp.session_id = session->get_id();
-                
-                client->add_tcp_data(&resp, sizeof(Net_player_slave_join_private_session_response));
+    Net_session* session = _session_id_lookup[req.session_id];
+    session->remove_player_and_broadcast(client, true);
+    
+    client->reset_session();
 
-                // send out Net_player_has_joined_session to all players in session
-                session->add_player_and_broadcast(client, true, false);
+    Net_success success(NetSuccessType::None);
+    client->add_tcp_message(success);
 
-                // also send out the game config to the player that joined
-                client->add_tcp_data(&_session_id_lookup[client->info.session_id]->game_config, _session_id_lookup[client->info.session_id]->game_config.size());
+    sync_session_with_master(session);
 
-                sync_session_with_master(session);
+    print_sessions_summary();
 
-                print_sessions_summary();
-                
-                break;
-            }
-            case MsgType::NetPlayerLeaveSessionRequest:
-            {
-                // when a player wants to leave a session
-                Net_player_leave_session_request req(data, off);
-                off += sizeof(Net_player_leave_session_request);
-                len -= sizeof(Net_player_leave_session_request);
+    return true;
+}
 
-                if (_session_id_lookup.find(req.session_id) == _session_id_lookup.end()) {
-                    TRACE("[NET-SLAVE][NetPlayerLeaveSessionRequest][ERROR][Session not found]\n");
+bool Net_slave::on_set_gamerule_int(Net_client* client, const Net_player_set_gamerule_int_request& gamerule) {
+    auto session = _session_id_lookup.find(client->info.session_id);
 
-                    Net_error err(NetErrorType::SessionNotFound);
-                    client->add_tcp_data(&err, sizeof(Net_error));
-                    
-                    break;
-                }
+    if (session == _session_id_lookup.end()) {
+        TRACE("[NET-SLAVE][NetPlayerSetGameRuleInt][ERROR][Session not found]\n");
+        return true;
+    }
 
-                Net_session* session = _session_id_lookup[req.session_id];
-                session->remove_player_and_broadcast(client, true);
-                
-                client->reset_session();
+    // When a gamerule is being set by the owner
+    Net_game_rule_updated rule;
+    rule.rule_id = gamerule.rule_id;
+    rule.rule_value = gamerule.rule_value;
 
-                Net_success success(NetSuccessType::None);
-                client->add_tcp_data(&success, sizeof(Net_success));
+    session->second->set_game_rule(rule.rule_id, rule.rule_value);
 
-                sync_session_with_master(session);
+    // broadcasts the rule change to all players
+    session->second->broadcast_reliable(rule);
 
-                print_sessions_summary();
-                break;
-            }
-            case MsgType::NetPlayerSetGameRuleInt:
-            {
-                // When a gamerule is being set by the owner
-                Net_player_set_gamerule_int_request gamerule(data, off);
-                off += sizeof(Net_player_set_gamerule_int_request);
-                len -= sizeof(Net_player_set_gamerule_int_request);
+    return true;
+}
 
-                Net_game_rule_updated rule;
-                rule.rule_id = gamerule.rule_id;
-                rule.rule_value = gamerule.rule_value;
+bool Net_slave::on_start_game_session_request(Net_client* client, const Net_player_start_game_session_request&) {
+    auto session = _session_id_lookup.find(client->info.session_id);
 
-                _session_id_lookup[client->info.session_id]->set_game_rule(rule.rule_id, rule.rule_value);
+    if (session == _session_id_lookup.end()) {
+        TRACE("[NET-SLAVE][NetPlayerStartGameSessionRequest][ERROR][Session not found]\n");
+        return true;
+    }
 
-                // broadcasts the rule change to all players
-                _session_id_lookup[client->info.session_id]->broadcast_tcp(&rule, sizeof(Net_game_rule_updated));
+    Net_player_start_game_session_response res;
+    res.ok = 1;
+    res.start_timestamp = -5;
 
-                break;
-            }
-            case MsgType::NetPlayerStartGameSessionRequest:
-            {
-                Net_player_start_game_session_request req(data, off);
-                off += sizeof(Net_player_start_game_session_request);
-                len -= sizeof(Net_player_start_game_session_request);
-                
-                Net_player_start_game_session_response res;
-                res.ok = 1;
-                res.start_timestamp = -5;
 
+    if (session->second->can_game_be_started()) {
+        session->second->start_game_in_seconds(5);
 
-                if (_session_id_lookup[client->info.session_id]->can_game_be_started()) {
-                    _session_id_lookup[client->info.session_id]->start_game_in_seconds(5);
+        Net_game_session_will_start start;
+        start.ok = 1;
+        start.start_timestamp = -5;
 
-                    Net_game_session_will_start start;
-                    start.ok = 1;
-                    start.start_timestamp = -5;
+        // broadcast game start event to all players
+        session->second->broadcast_reliable(start);
+    }
+    else {
+        res.ok = 0;
+    }
 
-                    // broadcast game start event to all players
-                    _session_id_lookup[client->info.session_id]->broadcast_tcp(&start, sizeof(Net_game_session_will_start));
-                }
-                else {
-                    res.ok = 0;
-                }
+    client->add_tcp_message(res);
 
-                client->add_tcp_data(&res, sizeof(Net_player_start_game_session_response));
+    return true;
+}
 
-                break;
-            }
-            default:
-                TRACE("[NET-SLAVE][Uknown message][%d]\n", type);
-                break;
-        }
+bool Net_slave::on_set_item_state_request(Net_client* client, const Net_player_set_item_state_request& req) {
+    auto session = _session_id_lookup.find(client->info.session_id);
+
+    if (session == _session_id_lookup.end()) {
+        TRACE("[NET-SLAVE][NetPlayerSetItemStateRequest][ERROR][Session not found]\n");
+        return true;
     }
+
+    // the range check is in the world, the response says if the state was set
+    session->second->msg_item_set(client, req);
+
+    return true;
 }
 
 bool Net_slave::init() {
@@ -547,6 +718,21 @@ bool Net_slave::validate_ini() {
     return true;
 }
 
+/// <summary>
+/// The level is mapped once and every session shares it, so creating a session
+/// doesnt touch the level data until a game starts on it
+/// </summary>
+bool Net_slave::load_level() {
+    if (_my_node->level_file.empty()) {
+        TRACE("[SLAVE][LOAD_LEVEL] No level_file in the ini, the sessions have no items\n");
+        return true;
+    }
+
+    _level = Level::load(_my_node->level_file);
+
+    return _level != nullptr;
+}
+
 /// <summary>
 /// Create our sessions during startup, If all sessions are marked as running
 /// then we dont allow player host requests on this node.
@@ -554,6 +740,12 @@ bool Net_slave::validate_ini() {
 /// amount of sessions available on the node
 /// </summary>
 void Net_slave::setup_sessions() {
+    // without a level file the sessions get an empty level
+    if (_level == nullptr) {
+        auto level = std::make_shared<Level>();
+        level->build();
+        _level = level;
+    }
 
     for (int i = 0; i < _my_node->max_sessions; ++i) {
         auto sess = std::make_unique<Net_session>(
@@ -561,6 +753,11 @@ void Net_slave::setup_sessions() {
             _my_node->keepalive_time_seconds,
             &_tcp,
             &_udp);
+        sess->set_item_snapshot_interval(_my_node->item_snapshot_interval_ms);
+        sess->set_transform_history(_my_node->transform_history_ms);
+        sess->set_tick_rate(_my_node->ticks_per_second_internal);
+        sess->set_dead_reckoning(_my_node->dead_reckoning_threshold_mm, _my_node->dead_reckoning_max_interval_ms);
+        sess->set_level(_level);
         _sessions.push_back(std::move(sess));
     }
 }
@@ -605,16 +802,18 @@ void Net_slave::on_client_connect(Net_client* client) {
     player->net_client_id = client->info.client_id;
     _client_id_lookup[client->info.client_id] = player;
 
+    client->link.configure(_link_settings);
+
     _udp.establish_client_connection(client);
 
     // send a request to the client to connect to our UDP port
     Net_Udp_client_connection_info udpconn;
+    udpconn.code = client->info.udp_code;
     udpconn.client_id = client->info.client_id;
-    memset(udpconn.ip, 0, 64);
-    strcpy(udpconn.ip, _my_node->ip.c_str());
+    strncpy(udpconn.ip, _my_node->ip.c_str(), 63);
     udpconn.port = _my_node->udp_port;
-    
-    client->add_tcp_data((void*)&udpconn, sizeof(Net_Udp_client_connection_info));
+
+    client->add_tcp_message(udpconn);
 }
 
 /// <summary>
@@ -675,10 +874,9 @@ void Net_slave::handle_master_command(const Net_master_to_slave_command& command
                 0,
                 _num_players); // cpu load isnt working
 
-            msg.set_buffer(_data_buffer, 0);
             msg.print();
 
-            _master_connection.add_data(&msg, sizeof(Net_slave_health_snapshot));
+            add_master_message(msg);
 
             break;
         }
@@ -708,11 +906,13 @@ void Net_slave::print_stats() {
         ((snapshot.ram_virt_process_used_bytes / 1000)),
         ((snapshot.ram_virt_total_bytes / 1000)),
         ((snapshot.ram_virt_used_bytes / 1000)));
+
+    _counters.print("slave");
 }
 
 /// <summary>
-/// Initiate the connection to our master. We also send our authentication so
-/// the master can mark this connection as a slave connection
+/// Initiate the connection to our master. We also ask for the protocol version,
+/// the authentication is sent when the master answers
 /// </summary>
 /// <returns></returns>
 bool Net_slave::connect_to_master() {
@@ -725,12 +925,26 @@ bool Net_slave::connect_to_master() {
         return false;
     }
 
-    // the first thing we need to send is a authentication packet 
-    // that authenticates with the master
+    // the first thing we need to send is the protocol version, the authentication
+    // goes out in the version the master answers with
+    _master_protocol_version = NET_PROTOCOL_VERSION_MIN;
+
+    Net_protocol_version_request version;
+    add_master_message(version);
+
+    TRACE("[NET-SLAVE][INIT][Protocol version request sent]\n");
+
+    return true;
+}
+
+/// <summary>
+/// Authenticates with the master so it can mark this connection as a slave connection,
+/// then sends our configuration
+/// </summary>
+void Net_slave::authenticate_with_master() {
     Net_authenticate_slave reg(_my_node->id, _master.node->master_password);
-    reg.set_buffer(_data_buffer, 0);
 
-    _master_connection.add_data(&reg, sizeof(Net_authenticate_slave));
+    add_master_message(reg);
     
     TRACE("[NET-SLAVE][INIT][Authentication packet sent]\n");
 
@@ -746,20 +960,7 @@ bool Net_slave::connect_to_master() {
     config.udp_port = _my_node->udp_port;
     config.node_id = _my_node->id;
     
-    _master_connection.add_data(&config, sizeof(Net_slave_config));
-    
-    /*
-    
-    config.set_buffer(_data_buffer, sizeof(Net_slave_config));
-
-    if (!_master_connection.send_data(_data_buffer, sizeof(Net_slave_config))) {
-        TRACE("[NET-SLAVE][INIT][ERROR][Unable to send slave config]\n");
-        return false;
-    }
-    
-    */
-
-    return true;
+    add_master_message(config);
 }
 
 /// <summary>
@@ -795,6 +996,9 @@ void Net_slave::update() {
         _sessions[i]->send_udp(now);
     }
 
+    // reliable messages, resends and acks for everything we got this tick
+    _udp.send_client_data(now);
+
     // read/send data from the master socket
     _master_connection.update();
 
@@ -13,6 +13,7 @@
 #include "net_session.h"
 #include "net_session_player.h"
 #include "net_packet.h"
+#include "net_dispatch.h"
 #include "process_stats.h"
 
 struct Ini_file;
@@ -28,18 +29,49 @@ struct Net_slave {
 
     bool init();
     void update();
+    // maps the level file from the ini, before setup_sessions()
+    bool load_level();
     void setup_sessions();
     void print_sessions() const;
     void print_sessions_summary() const;
     bool validate_ini();
 
     void set_session_private(Net_session* session, bool priv);
+
+    // the version the messages of client are read in, the one the master answered with for NULL
+    uint8_t protocol_version(const Net_client* client) const;
 private:
     void on_inc_tcp_master_data(const std::vector<uint8_t>& data, int32_t data_len);
     void on_inc_client_udp_data(Net_client* client, const std::vector<uint8_t>& data, int32_t data_len);
     void on_inc_client_tcp_data(Net_client* client, const std::vector<uint8_t>& data, int32_t data_len);
+
+    // message handlers, registered in Net_slave_dispatch
+    // returning false stops reading the rest of the data
+    bool on_master_command(Net_client* client, const Net_master_to_slave_command& command);
+    bool on_master_protocol_version(Net_client* client, const Net_protocol_version_response& resp);
+    bool on_datagram(Net_client* client, const Net_datagram_header& header);
+    bool on_reliable_message(Net_client* client, Packet_reader& reader);
+    bool on_fragment_message(Net_client* client, Packet_reader& reader);
+    bool on_player_pos(Net_client* client, Packet_reader& reader);
+    bool on_transforms_ack(Net_client* client, const Net_game_transforms_ack& ack);
+    bool on_session_snapshot_ack(Net_client* client, const Net_session_snapshot_ack& ack);
+    bool on_sync_time_request(Net_client* client, const Net_player_sync_time_request& req);
+    bool on_protocol_version_request(Net_client* client, const Net_protocol_version_request& req);
+    bool on_compression_request(Net_client* client, const Net_compression_request& req);
+    bool on_authenticate_player(Net_client* client, const Net_authenticate_player& auth);
+    bool on_list_sessions_request(Net_client* client, const Net_player_slave_list_sessions_request& req);
+    bool on_host_session_request(Net_client* client, const Net_player_host_session_request& req);
+    bool on_join_public_session_request(Net_client* client, const Net_player_slave_join_public_session_request& sess);
+    bool on_join_private_session_request(Net_client* client, const Net_player_slave_join_private_session_request& sess);
+    bool on_leave_session_request(Net_client* client, const Net_player_leave_session_request& req);
+    bool on_set_gamerule_int(Net_client* client, const Net_player_set_gamerule_int_request& gamerule);
+    bool on_start_game_session_request(Net_client* client, const Net_player_start_game_session_request& req);
+    bool on_set_item_state_request(Net_client* client, const Net_player_set_item_state_request& req);
+
     void on_client_connect(Net_client* client);
     void on_client_disconnect(Net_client* client);
+    void deliver_reliable_messages(Net_client* client);
+    bool is_deliverable(const std::vector<uint8_t>& message) const;
     void handle_master_command(const Net_master_to_slave_command& command);
     void print_stats();
     bool connect_to_master();
@@ -49,9 +81,22 @@ private:
 
     void sync_session_with_master(Net_session* session);
 
+    // sends the authentication and the configuration once the protocol version is settled
+    void authenticate_with_master();
+
+    // encoded in the protocol version the master answered with
+    template<typename T>
+    void add_master_message(const T& msg) {
+        uint32_t len = wire_encode(msg, _data_buffer, 0, _master_protocol_version);
+
+        _master_connection.add_data(&_data_buffer[0], (int32_t)len);
+    }
+
     void reset_session_lookups(Net_session* session);
 
     void set_session_lookups(Net_session* session);
+
+    friend struct Net_slave_dispatch;
     
     Tcp_server                                  _tcp;
     Udp_server                                  _udp;
@@ -60,11 +105,17 @@ private:
     Net_master_info                             _master;
     Ini_node*                                   _my_node;
 
+    Link_settings                               _link_settings;
+
     Process_stats*                              _stats;
 
     Tcp_client                                  _master_connection;
+    uint8_t                                     _master_protocol_version;
 
     std::vector<uint8_t>                        _data_buffer;
+    std::vector<uint8_t>                        _reliable_buffer;
+
+    Net_message_counters                        _counters;
 
     std::chrono::time_point<std::chrono::high_resolution_clock> _next_slave_report;
 
@@ -76,6 +127,9 @@ private:
 
     std::vector<std::unique_ptr<Net_session>>   _sessions;
 
+    // loaded once, every session plays on it
+    std::shared_ptr<const Level>                _level;
+
     std::vector<Net_session*>                   _private_sessions;
     std::vector<Net_session*>                   _public_sessions;
 
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <stdint.h>
+#include <type_traits>
+#include <vector>
+
+#include "net_packet.h"
+
+/// <summary>
+/// Only messages declared with NET_WIRE_MESSAGE can be viewed in place
+/// </summary>
+template<typename T>
+struct Net_wire_message : std::false_type {};
+
+/// <summary>
+/// Declares a fixed size message that is read in place from the receive buffers
+/// the struct must be packed (no padding, alignment 1), must not need a constructor
+/// to be valid and must have the size the clients put on the wire
+/// </summary>
+#define NET_WIRE_MESSAGE(T, size) \
+    static_assert(std::is_trivially_copyable<T>::value, #T " must be trivially copyable to be read in place"); \
+    static_assert(alignof(T) == 1, #T " must be packed to be read in place"); \
+    static_assert(sizeof(T) == size, #T " does not match its size on the wire"); \
+    template<> struct Net_wire_message<T> : std::true_type {}
+
+/// <summary>
+/// Reads messages straight out of a received buffer, nothing is copied
+/// + peek_type() gives the type of the next message
+/// + view<T>() returns the next message and moves past it
+/// + bytes() does the same for a payload of a given length
+/// + current() and skip() for messages that are read by their own bounds checked reader
+/// a read past the end of the data returns NULL and fails every read after it,
+/// the pointers are valid as long as the buffer is not modified
+/// </summary>
+struct Packet_reader {
+    // inline, the reader is on the path of every received message
+    Packet_reader(const uint8_t* data, uint32_t len) : _data(data), _len(len), _off(0), _failed(false) {}
+
+    // len is the number of received bytes, the buffer is often larger than that
+    Packet_reader(const std::vector<uint8_t>& data, int32_t len) : _data(data.data()), _len(0), _off(0), _failed(false) {
+        // never trust the length more than the buffer
+        if (len > 0) {
+            _len = (uint32_t)len < data.size() ? (uint32_t)len : (uint32_t)data.size();
+        }
+    }
+
+    bool peek_type(MsgType& type) const {
+        if (_failed || _off >= _len) {
+            return false;
+        }
+
+        type = (MsgType)_data[_off];
+
+        return true;
+    }
+
+    template<typename T>
+    const T* view() {
+        static_assert(Net_wire_message<T>::value, "declare the message with NET_WIRE_MESSAGE before viewing it");
+
+        return reinterpret_cast<const T*>(bytes(sizeof(T)));
+    }
+
+    const uint8_t* bytes(uint32_t len) {
+        if (_failed || len > _len - _off) {
+            _failed = true;
+            return NULL;
+        }
+
+        const uint8_t* ptr = _data + _off;
+        _off += len;
+
+        return ptr;
+    }
+
+    bool skip(uint32_t len) {
+        return bytes(len) != NULL;
+    }
+
+    // for readers of variable length data that found it invalid
+    void fail() {
+        _failed = true;
+    }
+
+    // the unread data, for messages with their own bounds checked reader
+    const uint8_t* current() const { return _data + _off; }
+
+    uint32_t offset() const { return _off; }
+    uint32_t remaining() const { return _len - _off; }
+    bool failed() const { return _failed; }
+
+private:
+    const uint8_t*  _data;
+    uint32_t        _len;
+    uint32_t        _off;
+    bool            _failed;
+};
+
+// transport
+NET_WIRE_MESSAGE(Net_datagram_header, 13);
+NET_WIRE_MESSAGE(Net_reliable_header, 6);
+NET_WIRE_MESSAGE(Net_fragment_header, 7);
+NET_WIRE_MESSAGE(Net_Udp_establish, 7);
+NET_WIRE_MESSAGE(Net_compression_request, 2);
+NET_WIRE_MESSAGE(Net_protocol_version_request, 2);
+NET_WIRE_MESSAGE(Net_protocol_version_response, 2);
+
+// player to slave
+NET_WIRE_MESSAGE(Net_player_slave_list_sessions_request, 1);
+NET_WIRE_MESSAGE(Net_player_host_session_request, 2);
+NET_WIRE_MESSAGE(Net_player_slave_join_public_session_request, 5);
+NET_WIRE_MESSAGE(Net_player_slave_join_private_session_request, 9);
+NET_WIRE_MESSAGE(Net_player_leave_session_request, 9);
+NET_WIRE_MESSAGE(Net_player_set_gamerule_int_request, 5);
+NET_WIRE_MESSAGE(Net_player_start_game_session_request, 1);
+NET_WIRE_MESSAGE(Net_player_sync_time_request, 9);
+NET_WIRE_MESSAGE(Net_game_transforms_ack, 3);
+NET_WIRE_MESSAGE(Net_session_snapshot_ack, 3);
+NET_WIRE_MESSAGE(Net_player_set_item_state_request, 5);
+
+// player to master
+NET_WIRE_MESSAGE(Net_player_slave_node_request, 1);
+NET_WIRE_MESSAGE(Net_player_master_join_private_session_request, 9);
+
+// between master and slaves
+NET_WIRE_MESSAGE(Net_authenticate_slave, 13);
+NET_WIRE_MESSAGE(Net_slave_config, 137);
+NET_WIRE_MESSAGE(Net_from_slave_sync_session, 14);
+NET_WIRE_MESSAGE(Net_slave_health_snapshot, 17);
+NET_WIRE_MESSAGE(Net_master_to_slave_command, 2);
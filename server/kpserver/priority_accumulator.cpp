@@ -0,0 +1,45 @@
+#include "priority_accumulator.h"
+
+#include <algorithm>
+
+Priority_accumulator::Priority_accumulator() : _has_sent(false) {
+    _priority.resize(256, 0.0f);
+}
+
+void Priority_accumulator::reset() {
+    std::fill(_priority.begin(), _priority.end(), 0.0f);
+
+    _has_sent = false;
+}
+
+float Priority_accumulator::begin(std::chrono::time_point<std::chrono::high_resolution_clock>& now) {
+    float dt = 0.0f;
+
+    if (_has_sent) {
+        dt = std::chrono::duration<float>(now - _last_send).count();
+    }
+
+    _last_send = now;
+    _has_sent = true;
+
+    return dt;
+}
+
+void Priority_accumulator::accumulate(uint8_t entity, float amount) {
+    _priority[entity] += amount;
+}
+
+void Priority_accumulator::sort(std::vector<uint8_t>& entities) const {
+    // stable so equal priorities keep the index order and the result is deterministic
+    std::stable_sort(entities.begin(), entities.end(), [this](uint8_t a, uint8_t b) {
+        return _priority[a] > _priority[b];
+    });
+}
+
+void Priority_accumulator::sent(uint8_t entity) {
+    _priority[entity] = 0.0f;
+}
+
+float Priority_accumulator::get(uint8_t entity) const {
+    return _priority[entity];
+}
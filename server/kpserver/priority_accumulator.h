@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <chrono>
+
+/// <summary>
+/// Per client priority of every entity in the session
+/// + Each send the candidate entities gain relevance * seconds since the last send
+/// + The entities are sent highest priority first until the byte budget is used up
+/// + Sent entities drop back to zero, the rest keep their priority so they
+///   win a slot in a later snapshot instead of being starved
+/// </summary>
+struct Priority_accumulator {
+    Priority_accumulator();
+
+    void reset();
+
+    // returns the seconds since the previous call, 0 on the first call
+    float begin(std::chrono::time_point<std::chrono::high_resolution_clock>& now);
+
+    void accumulate(uint8_t entity, float amount);
+
+    // sorts the entities on priority, highest first
+    void sort(std::vector<uint8_t>& entities) const;
+
+    void sent(uint8_t entity);
+
+    float get(uint8_t entity) const;
+
+private:
+    std::vector<float> _priority;
+
+    bool _has_sent;
+
+    std::chrono::time_point<std::chrono::high_resolution_clock> _last_send;
+};
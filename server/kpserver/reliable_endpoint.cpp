@@ -0,0 +1,318 @@
+#include "reliable_endpoint.h"
+
+#include <string.h>
+
+#include "net_schema.h"
+#include "trace.h"
+
+typedef std::chrono::high_resolution_clock Reliable_clock;
+
+Reliable_endpoint::Reliable_endpoint() {
+    for (auto& channel : _channels) {
+        channel.sent.resize(RELIABLE_WINDOW);
+        channel.recv.resize(RELIABLE_WINDOW);
+    }
+
+    _packets.resize(RELIABLE_PACKET_HISTORY);
+
+    reset();
+}
+
+void Reliable_endpoint::reset() {
+    for (auto& channel : _channels) {
+        channel.send_next = 0;
+        channel.send_oldest = 0;
+        channel.recv_base = 0;
+
+        for (auto& msg : channel.sent) {
+            msg.used = false;
+        }
+
+        for (auto& msg : channel.recv) {
+            msg.received = false;
+        }
+
+        channel.backlog.clear();
+    }
+
+    for (auto& packet : _packets) {
+        packet.used = false;
+    }
+
+    _sequence = 0;
+    _has_remote = false;
+    _ack_pending = false;
+    _remote_sequence = 0;
+    _remote_bits = 0;
+
+    _delivered.clear();
+}
+
+bool Reliable_endpoint::send(ReliableChannel channel, const void* data, uint32_t len) {
+    // a message must fit in a single datagram
+    if (len == 0 || len > UDP_MAX_DATAGRAM_SIZE - sizeof(Net_datagram_header) - sizeof(Net_reliable_header)) {
+        TRACE("[RELIABLE][SEND][ERROR][Message too large: %d]\n", len);
+        return false;
+    }
+
+    Channel& ch = _channels[(int)channel];
+
+    // the window is full, wait for acks
+    if ((uint16_t)(ch.send_next - ch.send_oldest) >= RELIABLE_WINDOW || !ch.backlog.empty()) {
+        ch.backlog.emplace_back((const uint8_t*)data, (const uint8_t*)data + len);
+        return true;
+    }
+
+    queue(ch, (const uint8_t*)data, len);
+
+    return true;
+}
+
+void Reliable_endpoint::queue(Channel& channel, const uint8_t* data, uint32_t len) {
+    Sent_message& msg = channel.sent[channel.send_next % RELIABLE_WINDOW];
+
+    msg.used = true;
+    msg.has_sent = false;
+    msg.id = channel.send_next;
+    msg.data.assign(data, data + len);
+
+    channel.send_next++;
+}
+
+bool Reliable_endpoint::is_due(const Sent_message& msg, std::chrono::time_point<std::chrono::high_resolution_clock>& now, float resend_ms) const {
+    if (!msg.used) {
+        return false;
+    }
+
+    if (!msg.has_sent) {
+        return true;
+    }
+
+    return std::chrono::duration<float, std::milli>(now - msg.last_sent).count() >= resend_ms;
+}
+
+bool Reliable_endpoint::wants_to_send(std::chrono::time_point<std::chrono::high_resolution_clock>& now, float resend_ms) const {
+    if (_ack_pending) {
+        return true;
+    }
+
+    for (const auto& channel : _channels) {
+        for (uint16_t id = channel.send_oldest; id != channel.send_next; ++id) {
+            if (is_due(channel.sent[id % RELIABLE_WINDOW], now, resend_ms)) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+uint32_t Reliable_endpoint::write_packet(std::vector<uint8_t>& data, uint32_t off, uint32_t max_size, std::chrono::time_point<std::chrono::high_resolution_clock>& now, float resend_ms) {
+    if (data.size() < off + max_size) {
+        data.resize(off + max_size);
+    }
+
+    Net_datagram_header header;
+    header.sequence = _sequence++;
+    header.ack = _remote_sequence;
+    header.ack_bits = _remote_bits;
+    header.timestamp = (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+    wire_encode(header, data, off);
+
+    _ack_pending = false;
+
+    Sent_packet& packet = _packets[header.sequence % RELIABLE_PACKET_HISTORY];
+    packet.used = true;
+    packet.sequence = header.sequence;
+    packet.num_messages = 0;
+
+    uint32_t pos = off + sizeof(Net_datagram_header);
+    uint32_t end = off + max_size;
+
+    for (uint8_t c = 0; c < (uint8_t)ReliableChannel::NumChannels; ++c) {
+        Channel& channel = _channels[c];
+
+        for (uint16_t id = channel.send_oldest; id != channel.send_next; ++id) {
+            Sent_message& msg = channel.sent[id % RELIABLE_WINDOW];
+
+            if (!is_due(msg, now, resend_ms)) {
+                continue;
+            }
+
+            if (packet.num_messages == RELIABLE_MAX_MESSAGES_PER_PACKET) {
+                return pos;
+            }
+
+            // a smaller message further on might still fit
+            if (pos + sizeof(Net_reliable_header) + msg.data.size() > end) {
+                continue;
+            }
+
+            Net_reliable_header rh;
+            rh.channel = c;
+            rh.message_id = msg.id;
+            rh.length = (uint16_t)msg.data.size();
+            wire_encode(rh, data, pos);
+            pos += sizeof(Net_reliable_header);
+
+            memcpy(&data[pos], msg.data.data(), msg.data.size());
+            pos += (uint32_t)msg.data.size();
+
+            msg.has_sent = true;
+            msg.last_sent = now;
+
+            packet.messages[packet.num_messages].channel = c;
+            packet.messages[packet.num_messages].id = msg.id;
+            packet.num_messages++;
+        }
+    }
+
+    return pos;
+}
+
+bool Reliable_endpoint::on_header(const Net_datagram_header& header) {
+    // what we have received, sent back as acks
+    if (!_has_remote) {
+        _has_remote = true;
+        _remote_sequence = header.sequence;
+        _remote_bits = 0;
+    }
+    else if (sequence_greater_than(header.sequence, _remote_sequence)) {
+        uint16_t shift = header.sequence - _remote_sequence;
+
+        // the previous newest moves into the bitfield at bit shift - 1
+        if (shift < 32) {
+            _remote_bits = (_remote_bits << shift) | (1u << (shift - 1));
+        }
+        else {
+            _remote_bits = shift == 32 ? (1u << 31) : 0;
+        }
+
+        _remote_sequence = header.sequence;
+    }
+    else {
+        uint16_t diff = _remote_sequence - header.sequence;
+
+        if (diff == 0 || diff > 32 || (_remote_bits & (1u << (diff - 1))) != 0) {
+            return false;
+        }
+
+        _remote_bits |= 1u << (diff - 1);
+    }
+
+    _ack_pending = true;
+
+    // what the other side has received from us
+    ack_packet(header.ack);
+
+    for (uint32_t i = 0; i < 32; ++i) {
+        if (header.ack_bits & (1u << i)) {
+            ack_packet(header.ack - 1 - (uint16_t)i);
+        }
+    }
+
+    return true;
+}
+
+void Reliable_endpoint::ack_packet(uint16_t sequence) {
+    Sent_packet& packet = _packets[sequence % RELIABLE_PACKET_HISTORY];
+
+    if (!packet.used || packet.sequence != sequence) {
+        return;
+    }
+
+    packet.used = false;
+
+    for (uint8_t i = 0; i < packet.num_messages; ++i) {
+        ack_message(packet.messages[i].channel, packet.messages[i].id);
+    }
+}
+
+void Reliable_endpoint::ack_message(uint8_t c, uint16_t id) {
+    Channel& channel = _channels[c];
+    Sent_message& msg = channel.sent[id % RELIABLE_WINDOW];
+
+    if (!msg.used || msg.id != id) {
+        return;
+    }
+
+    msg.used = false;
+
+    // move the window forward and let the backlog in
+    while (channel.send_oldest != channel.send_next && !channel.sent[channel.send_oldest % RELIABLE_WINDOW].used) {
+        channel.send_oldest++;
+    }
+
+    while (!channel.backlog.empty() && (uint16_t)(channel.send_next - channel.send_oldest) < RELIABLE_WINDOW) {
+        const std::vector<uint8_t>& next = channel.backlog.front();
+
+        queue(channel, next.data(), (uint32_t)next.size());
+        channel.backlog.pop_front();
+    }
+}
+
+void Reliable_endpoint::on_message(const Net_reliable_header& header, const uint8_t* data) {
+    if (header.channel >= (uint8_t)ReliableChannel::NumChannels) {
+        return;
+    }
+
+    Channel& channel = _channels[header.channel];
+
+    // already delivered, or too far ahead for our window
+    if ((uint16_t)(header.message_id - channel.recv_base) >= RELIABLE_WINDOW) {
+        return;
+    }
+
+    Received_message& msg = channel.recv[header.message_id % RELIABLE_WINDOW];
+
+    if (msg.received) {
+        return;
+    }
+
+    msg.received = true;
+    msg.id = header.message_id;
+
+    if (header.channel == (uint8_t)ReliableChannel::Ordered) {
+        msg.data.assign(data, data + header.length);
+        return;
+    }
+
+    _delivered.emplace_back(data, data + header.length);
+
+    // the unordered channel only keeps the received flags to drop duplicates
+    while (channel.recv[channel.recv_base % RELIABLE_WINDOW].received) {
+        channel.recv[channel.recv_base % RELIABLE_WINDOW].received = false;
+        channel.recv_base++;
+    }
+}
+
+bool Reliable_endpoint::pop_message(std::vector<uint8_t>& out) {
+    if (!_delivered.empty()) {
+        out.swap(_delivered.front());
+        _delivered.pop_front();
+        return true;
+    }
+
+    Channel& channel = _channels[(int)ReliableChannel::Ordered];
+    Received_message& msg = channel.recv[channel.recv_base % RELIABLE_WINDOW];
+
+    if (!msg.received) {
+        return false;
+    }
+
+    out.swap(msg.data);
+    msg.received = false;
+    channel.recv_base++;
+
+    return true;
+}
+
+uint32_t Reliable_endpoint::num_pending() const {
+    uint32_t n = 0;
+
+    for (const auto& channel : _channels) {
+        n += (uint16_t)(channel.send_next - channel.send_oldest) + (uint32_t)channel.backlog.size();
+    }
+
+    return n;
+}
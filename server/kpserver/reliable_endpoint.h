@@ -0,0 +1,118 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <deque>
+#include <chrono>
+
+#include "net_packet.h"
+
+#define UDP_MAX_DATAGRAM_SIZE           1200    // stays below the common internet MTU
+#define RELIABLE_PACKET_HISTORY         256     // sent datagrams we remember which messages they carried
+#define RELIABLE_WINDOW                 256     // messages in flight per channel, the rest wait in the backlog
+#define RELIABLE_MAX_MESSAGES_PER_PACKET 32
+
+enum class ReliableChannel {
+    Ordered = 0,    // delivered once and in the order they were sent
+    Unordered,      // delivered once, as soon as they arrive
+    NumChannels
+};
+
+/// <summary>
+/// The reliable part of a UDP connection
+/// + Every datagram gets a sequence number and carries the ack of the newest datagram
+///   we received together with a bitfield of the 32 before it
+/// + Each datagram remembers which reliable messages it carried, when it is acked
+///   so are the messages
+/// + Messages that have not been acked within the resend timeout are sent again in the next datagram
+/// + The receiving side drops duplicates and, on the ordered channel, holds messages back
+///   until the ones before them have arrived
+/// </summary>
+struct Reliable_endpoint {
+    Reliable_endpoint();
+
+    void reset();
+
+    // queues a message, data must be a complete message
+    bool send(ReliableChannel channel, const void* data, uint32_t len);
+
+    // true if there are messages to (re)send or acks the other side is waiting for
+    bool wants_to_send(std::chrono::time_point<std::chrono::high_resolution_clock>& now, float resend_ms) const;
+
+    // writes the datagram header and as many due messages as fit in max_size, returns the offset after the last byte written
+    uint32_t write_packet(std::vector<uint8_t>& data, uint32_t off, uint32_t max_size, std::chrono::time_point<std::chrono::high_resolution_clock>& now, float resend_ms);
+
+    // call for every datagram header we receive, returns false for a duplicate or very old datagram
+    bool on_header(const Net_datagram_header& header);
+
+    // the message data is copied, take the deliverable messages with pop_message
+    void on_message(const Net_reliable_header& header, const uint8_t* data);
+
+    bool pop_message(std::vector<uint8_t>& out);
+
+    uint32_t num_pending() const;
+
+private:
+    struct Sent_message {
+        bool        used;
+        bool        has_sent;
+        uint16_t    id;
+
+        std::vector<uint8_t> data;
+
+        std::chrono::time_point<std::chrono::high_resolution_clock> last_sent;
+    };
+
+    struct Received_message {
+        bool        received;
+        uint16_t    id;
+
+        std::vector<uint8_t> data;
+    };
+
+    struct Message_ref {
+        uint8_t     channel;
+        uint16_t    id;
+    };
+
+    struct Sent_packet {
+        bool        used;
+        uint16_t    sequence;
+        uint8_t     num_messages;
+
+        Message_ref messages[RELIABLE_MAX_MESSAGES_PER_PACKET];
+    };
+
+    struct Channel {
+        uint16_t    send_next;      // id of the next message we queue
+        uint16_t    send_oldest;    // oldest id that has not been acked
+        uint16_t    recv_base;      // oldest id we have not received (or delivered on the ordered channel)
+
+        std::vector<Sent_message>       sent;
+        std::vector<Received_message>   recv;
+
+        std::deque<std::vector<uint8_t>> backlog;
+    };
+
+    bool is_due(const Sent_message& msg, std::chrono::time_point<std::chrono::high_resolution_clock>& now, float resend_ms) const;
+
+    void queue(Channel& channel, const uint8_t* data, uint32_t len);
+
+    void ack_packet(uint16_t sequence);
+
+    void ack_message(uint8_t channel, uint16_t id);
+
+    Channel     _channels[(int)ReliableChannel::NumChannels];
+
+    std::vector<Sent_packet> _packets;
+
+    uint16_t    _sequence;
+
+    bool        _has_remote;
+    bool        _ack_pending;
+    uint16_t    _remote_sequence;
+    uint32_t    _remote_bits;
+
+    // unordered messages ready to be delivered
+    std::deque<std::vector<uint8_t>> _delivered;
+};
@@ -0,0 +1,283 @@
+#include "snapshot_delta.h"
+
+#include <string.h>
+#include <algorithm>
+
+Snapshot_baselines::Snapshot_baselines() {
+    _ring.resize(SNAPSHOT_BASELINE_RING_SIZE);
+}
+
+bool Snapshot_baseline::same_as(const Snapshot_baseline& other) const {
+    if (sequence != other.sequence || num_players != other.num_players || known != other.known) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < num_players; ++i) {
+        const Transform_q& a = player_transforms[i];
+        const Transform_q& b = other.player_transforms[i];
+
+        if (known[i] && (!a.pos_equals(b) || !a.rot_equals(b) || !a.vel_equals(b) || timestamps[i] != other.timestamps[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void Snapshot_baselines::store(uint16_t sequence, const Net_game_transforms_snapshot& snapshot, const std::vector<uint8_t>& entities) {
+    Snapshot_baseline& slot = _ring[sequence % SNAPSHOT_BASELINE_RING_SIZE];
+
+    // start from what the snapshot was delta encoded against (assignments reuse the slot capacity)
+    if (_acked.is_set && _acked.num_players == snapshot.num_players) {
+        slot.player_transforms = _acked.player_transforms;
+        slot.known = _acked.known;
+        slot.timestamps = _acked.timestamps;
+    }
+    else {
+        slot.player_transforms.resize(snapshot.num_players);
+        slot.known.assign(snapshot.num_players, 0);
+        slot.timestamps.assign(snapshot.num_players, 0);
+    }
+
+    for (uint8_t index : entities) {
+        slot.player_transforms[index] = snapshot.player_transforms[index];
+        slot.known[index] = 1;
+        slot.timestamps[index] = snapshot.session_timestamp;
+    }
+
+    slot.sequence = sequence;
+    slot.num_players = snapshot.num_players;
+    slot.is_set = true;
+}
+
+void Snapshot_baselines::ack(uint16_t sequence) {
+    const Snapshot_baseline& slot = _ring[sequence % SNAPSHOT_BASELINE_RING_SIZE];
+
+    // the slot has been overwritten by a newer snapshot, ignore the old ack
+    if (!slot.is_set || slot.sequence != sequence) {
+        return;
+    }
+
+    // acks can arrive out of order, only move forward
+    if (_acked.is_set && !sequence_greater_than(sequence, _acked.sequence)) {
+        return;
+    }
+
+    _acked = slot;
+}
+
+const Snapshot_baseline* Snapshot_baselines::get_acked() const {
+    if (!_acked.is_set) {
+        return NULL;
+    }
+
+    return &_acked;
+}
+
+void Snapshot_baselines::reset() {
+    for (auto& slot : _ring) {
+        slot.is_set = false;
+    }
+
+    _acked.is_set = false;
+}
+
+uint32_t snapshot_write_delta(const Net_game_transforms_snapshot& snapshot, const Snapshot_baseline* baseline, const std::vector<uint8_t>& entities, const Transform_codec& codec, std::vector<uint8_t>& data, uint32_t offset) {
+    // we cant delta against a baseline with another set of players
+    if (baseline != NULL && baseline->num_players != snapshot.num_players) {
+        baseline = NULL;
+    }
+
+    uint16_t baseline_sequence = baseline != NULL ? baseline->sequence : SNAPSHOT_NO_BASELINE;
+
+    uint32_t header_size = snapshot.header_size();
+
+    if (data.size() < offset + header_size) {
+        data.resize(offset + header_size);
+    }
+
+    uint32_t pos = offset;
+
+    data[pos] = snapshot.type;
+    pos += sizeof(uint8_t);
+    memcpy(&data[pos], &snapshot.sequence, sizeof(uint16_t));
+    pos += sizeof(uint16_t);
+    memcpy(&data[pos], &baseline_sequence, sizeof(uint16_t));
+    pos += sizeof(uint16_t);
+    memcpy(&data[pos], &snapshot.session_timestamp, sizeof(uint32_t));
+    pos += sizeof(uint32_t);
+    data[pos++] = snapshot.num_players;
+    data[pos++] = snapshot.num_items;
+
+    Bit_writer writer(data, pos);
+
+    uint32_t index_bits = bits_required(snapshot.num_players);
+
+    writer.write_bits((uint32_t)entities.size(), index_bits);
+
+    for (uint8_t i : entities) {
+        const Transform_q& cur = snapshot.player_transforms[i];
+        const Transform_q* base = baseline != NULL && baseline->known[i] ? &baseline->player_transforms[i] : NULL;
+
+        writer.write_bits(i, index_bits);
+
+        bool pos_changed = base == NULL || !cur.pos_equals(*base);
+        bool rot_changed = base == NULL || !cur.rot_equals(*base);
+
+        writer.write_bool(pos_changed);
+
+        if (pos_changed) {
+            codec.write_position(writer, cur);
+        }
+
+        writer.write_bool(rot_changed);
+
+        if (rot_changed) {
+            codec.write_rotation(writer, cur);
+        }
+
+        if (codec.velocity_enabled) {
+            bool vel_changed = base == NULL || !cur.vel_equals(*base);
+
+            writer.write_bool(vel_changed);
+
+            if (vel_changed) {
+                writer.write_bool(cur.has_velocity);
+
+                if (cur.has_velocity) {
+                    codec.write_velocity(writer, cur);
+                }
+            }
+        }
+    }
+
+    return header_size + writer.flush();
+}
+
+uint32_t snapshot_entity_bits(const Net_game_transforms_snapshot& snapshot, const Snapshot_baseline* baseline, uint8_t entity, const Transform_codec& codec) {
+    if (baseline != NULL && baseline->num_players != snapshot.num_players) {
+        baseline = NULL;
+    }
+
+    const Transform_q& cur = snapshot.player_transforms[entity];
+    const Transform_q* base = baseline != NULL && baseline->known[entity] ? &baseline->player_transforms[entity] : NULL;
+
+    // index, pos changed and rot changed
+    uint32_t bits = bits_required(snapshot.num_players) + 2;
+
+    if (base == NULL || !cur.pos_equals(*base)) {
+        bits += codec.position_bits[0] + codec.position_bits[1] + codec.position_bits[2];
+    }
+
+    if (base == NULL || !cur.rot_equals(*base)) {
+        bits += 2 + codec.rotation_bits * 3;
+    }
+
+    if (codec.velocity_enabled) {
+        bits += 1;
+
+        if (base == NULL || !cur.vel_equals(*base)) {
+            bits += 1 + (cur.has_velocity ? codec.velocity_bits * 3 : 0);
+        }
+    }
+
+    return bits;
+}
+
+void snapshot_fit_budget(const Net_game_transforms_snapshot& snapshot, const std::vector<uint32_t>& entity_bits, const std::vector<uint8_t>& candidates, uint32_t budget, std::vector<uint8_t>& out) {
+    out.clear();
+
+    uint32_t used_bits = snapshot.header_size() * 8 + bits_required(snapshot.num_players);
+    uint32_t budget_bits = budget * 8;
+
+    for (uint8_t entity : candidates) {
+        uint32_t bits = entity_bits[entity];
+
+        // a lower priority entity with a small delta can still fit, so keep looking
+        if (used_bits + bits > budget_bits) {
+            continue;
+        }
+
+        used_bits += bits;
+        out.push_back(entity);
+    }
+
+    std::sort(out.begin(), out.end());
+}
+
+Snapshot_fanout::Snapshot_fanout() : _snapshot(NULL), _codec(NULL), _num_groups(0), _num_encodings(0), _data_pos(0) {}
+
+void Snapshot_fanout::begin(const Net_game_transforms_snapshot& snapshot, const Transform_codec& codec) {
+    _snapshot = &snapshot;
+    _codec = &codec;
+    _num_groups = 0;
+    _num_encodings = 0;
+    _data_pos = 0;
+}
+
+uint32_t Snapshot_fanout::group(const Snapshot_baseline* baseline) {
+    // snapshot_write_delta writes a full snapshot for a baseline with another set of players
+    if (baseline != NULL && baseline->num_players != _snapshot->num_players) {
+        baseline = NULL;
+    }
+
+    for (uint32_t i = 0; i < _num_groups; ++i) {
+        const Snapshot_baseline* other = _groups[i].baseline;
+
+        if (other == baseline || (other != NULL && baseline != NULL && other->same_as(*baseline))) {
+            return i;
+        }
+    }
+
+    if (_groups.size() <= _num_groups) {
+        _groups.resize(_num_groups + 1);
+    }
+
+    Group& group = _groups[_num_groups];
+    group.baseline = baseline;
+    group.entity_bits.resize(_snapshot->num_players);
+
+    for (uint8_t entity = 0; entity < _snapshot->num_players; ++entity) {
+        group.entity_bits[entity] = snapshot_entity_bits(*_snapshot, baseline, entity, *_codec);
+    }
+
+    return _num_groups++;
+}
+
+const std::vector<uint32_t>& Snapshot_fanout::entity_bits(uint32_t group) const {
+    return _groups[group].entity_bits;
+}
+
+const uint8_t* Snapshot_fanout::encode(uint32_t group, const std::vector<uint8_t>& entities, uint32_t& size) {
+    for (uint32_t i = 0; i < _num_encodings; ++i) {
+        const Encoding& encoding = _encodings[i];
+
+        if (encoding.group == group && encoding.entities == entities) {
+            size = encoding.size;
+            return &_data[encoding.offset];
+        }
+    }
+
+    if (_encodings.size() <= _num_encodings) {
+        _encodings.resize(_num_encodings + 1);
+    }
+
+    Encoding& encoding = _encodings[_num_encodings++];
+    encoding.group = group;
+    encoding.entities = entities;
+    encoding.offset = _data_pos;
+    encoding.size = snapshot_write_delta(*_snapshot, _groups[group].baseline, entities, *_codec, _data, _data_pos);
+
+    _data_pos += encoding.size;
+    size = encoding.size;
+
+    return &_data[encoding.offset];
+}
+
+uint32_t Snapshot_fanout::num_groups() const {
+    return _num_groups;
+}
+
+uint32_t Snapshot_fanout::num_encodings() const {
+    return _num_encodings;
+}
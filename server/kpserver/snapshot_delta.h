@@ -0,0 +1,135 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "net_packet.h"
+
+#define SNAPSHOT_BASELINE_RING_SIZE 32
+
+/// <summary>
+/// A transform snapshot that we have sent to a client
+/// kept around so we can delta encode against it once the client acks it
+/// </summary>
+struct Snapshot_baseline {
+    uint16_t                sequence;
+    uint8_t                 num_players;
+    bool                    is_set;
+
+    // what the client has for each entity after applying this snapshot,
+    // entities it has never received are not known and are sent in full
+    std::vector<Transform_q> player_transforms;
+    std::vector<uint8_t>     known;
+
+    // the session timestamp of the snapshot each entity was last sent in, the client extrapolates from it
+    std::vector<uint32_t>    timestamps;
+
+    Snapshot_baseline() : sequence(0), num_players(0), is_set(false) {}
+
+    // the client has the same state for every entity, snapshots delta encoded against either are the same
+    bool same_as(const Snapshot_baseline& other) const;
+};
+
+/// <summary>
+/// Per client ring of the most recently sent transform snapshots
+/// + store() every snapshot we send, only the entities that were sent are
+///   updated, the others keep the values of the acked snapshot it was delta encoded against
+/// + ack() when the client tells us which sequence it received
+/// + get_acked() gives the newest acked snapshot to delta against,
+///   or NULL when we need to send a full snapshot
+/// </summary>
+struct Snapshot_baselines {
+    Snapshot_baselines();
+
+    void store(uint16_t sequence, const Net_game_transforms_snapshot& snapshot, const std::vector<uint8_t>& entities);
+
+    void ack(uint16_t sequence);
+
+    const Snapshot_baseline* get_acked() const;
+
+    void reset();
+
+private:
+    std::vector<Snapshot_baseline> _ring;
+
+    // copied out of the ring so a slow acking client doesnt lose its baseline when the ring wraps
+    Snapshot_baseline _acked;
+};
+
+/// <summary>
+/// Writes the entities of the snapshot to data, delta encoded against baseline
+/// entities are the indices the recipient is interested in, sorted ascending
+/// baseline can be NULL, then the entities are written in full
+/// returns the number of bytes written
+///
+/// Wire format:
+/// type | sequence (u16) | baseline (u16, SNAPSHOT_NO_BASELINE if full) | session timestamp (u32) | num_players | num_items
+/// followed by a bitstream:
+/// entity count, then per entity:
+/// index, pos changed bit [position], rot changed bit [rotation], vel changed bit [velocity] (only if the codec has velocity)
+/// count and index use bits_required(num_players) bits, a changed velocity starts with the has velocity bit
+/// </summary>
+uint32_t snapshot_write_delta(const Net_game_transforms_snapshot& snapshot, const Snapshot_baseline* baseline, const std::vector<uint8_t>& entities, const Transform_codec& codec, std::vector<uint8_t>& data, uint32_t offset);
+
+/// <summary>
+/// The number of bits the entity takes in a snapshot written by snapshot_write_delta
+/// </summary>
+uint32_t snapshot_entity_bits(const Net_game_transforms_snapshot& snapshot, const Snapshot_baseline* baseline, uint8_t entity, const Transform_codec& codec);
+
+/// <summary>
+/// Picks entities from candidates, in order, as long as the snapshot stays within budget bytes
+/// entity_bits is the snapshot_entity_bits of every entity against the baseline the snapshot is written against
+/// candidates should be sorted on priority, out is sorted on index so it can be passed to snapshot_write_delta
+/// </summary>
+void snapshot_fit_budget(const Net_game_transforms_snapshot& snapshot, const std::vector<uint32_t>& entity_bits, const std::vector<uint8_t>& candidates, uint32_t budget, std::vector<uint8_t>& out);
+
+/// <summary>
+/// Writes the snapshot of a send once per distinct baseline and entity set instead of once per player
+/// most players have acked the same snapshot, so they share a baseline, and players that see the
+/// same entities get the same bytes
+/// + begin() once per send with the snapshot that goes out
+/// + group() gives the group of a player baseline, a new group if no other player has the same baseline
+/// + entity_bits() is the cost of every entity against the group baseline, computed once per group
+/// + encode() writes the snapshot for the group and entity set, or returns the one already written,
+///   the datagram header each client puts in front of it is the only per client part
+/// </summary>
+struct Snapshot_fanout {
+    Snapshot_fanout();
+
+    void begin(const Net_game_transforms_snapshot& snapshot, const Transform_codec& codec);
+
+    uint32_t group(const Snapshot_baseline* baseline);
+
+    const std::vector<uint32_t>& entity_bits(uint32_t group) const;
+
+    // the returned data is valid until the next encode()
+    const uint8_t* encode(uint32_t group, const std::vector<uint8_t>& entities, uint32_t& size);
+
+    uint32_t num_groups() const;
+    uint32_t num_encodings() const;
+
+private:
+    struct Group {
+        const Snapshot_baseline*    baseline;
+        std::vector<uint32_t>       entity_bits;
+    };
+
+    struct Encoding {
+        uint32_t                    group;
+        std::vector<uint8_t>        entities;
+        uint32_t                    offset;
+        uint32_t                    size;
+    };
+
+    const Net_game_transforms_snapshot* _snapshot;
+    const Transform_codec*              _codec;
+
+    // only the first _num_groups and _num_encodings are used in this send, the rest keep their capacity
+    std::vector<Group>      _groups;
+    std::vector<Encoding>   _encodings;
+    uint32_t                _num_groups;
+    uint32_t                _num_encodings;
+
+    std::vector<uint8_t>    _data;
+    uint32_t                _data_pos;
+};
@@ -0,0 +1,204 @@
+#include "spatial_grid.h"
+
+#include <cmath>
+#include <algorithm>
+
+Spatial_grid::Spatial_grid()
+    :   _cell_size(SPATIAL_CELL_SIZE),
+        _inv_cell_size(1.0f / SPATIAL_CELL_SIZE),
+        _bucket_mask(0),
+        _num_inserted(0) {
+
+}
+
+void Spatial_grid::reset(uint32_t num_objects, float cell_size) {
+    _cell_size = cell_size;
+    _inv_cell_size = 1.0f / cell_size;
+
+    // about two buckets per object so the lists stay short
+    uint32_t num_buckets = 16;
+
+    while (num_buckets < num_objects * 2) {
+        num_buckets *= 2;
+    }
+
+    _bucket_mask = num_buckets - 1;
+    _buckets.assign(num_buckets, SPATIAL_NO_OBJECT);
+
+    _pos.assign(num_objects, glm::vec3(0, 0, 0));
+    _cell.assign(num_objects, glm::ivec3(0, 0, 0));
+    _next.assign(num_objects, SPATIAL_NO_OBJECT);
+    _prev.assign(num_objects, SPATIAL_NO_OBJECT);
+    _inserted.assign(num_objects, 0);
+    _num_inserted = 0;
+}
+
+glm::ivec3 Spatial_grid::cell_of(const glm::vec3& pos) const {
+    return glm::ivec3(
+        (int32_t)floorf(pos.x * _inv_cell_size),
+        (int32_t)floorf(pos.y * _inv_cell_size),
+        (int32_t)floorf(pos.z * _inv_cell_size));
+}
+
+uint32_t Spatial_grid::bucket_of(const glm::ivec3& cell) const {
+    return (((uint32_t)cell.x * 73856093u) ^ ((uint32_t)cell.y * 19349663u) ^ ((uint32_t)cell.z * 83492791u)) & _bucket_mask;
+}
+
+void Spatial_grid::link(uint16_t object) {
+    uint32_t bucket = bucket_of(_cell[object]);
+    uint16_t head = _buckets[bucket];
+
+    _prev[object] = SPATIAL_NO_OBJECT;
+    _next[object] = head;
+
+    if (head != SPATIAL_NO_OBJECT) {
+        _prev[head] = object;
+    }
+
+    _buckets[bucket] = object;
+}
+
+void Spatial_grid::unlink(uint16_t object) {
+    uint16_t prev = _prev[object];
+    uint16_t next = _next[object];
+
+    if (prev != SPATIAL_NO_OBJECT) {
+        _next[prev] = next;
+    }
+    else {
+        _buckets[bucket_of(_cell[object])] = next;
+    }
+
+    if (next != SPATIAL_NO_OBJECT) {
+        _prev[next] = prev;
+    }
+}
+
+void Spatial_grid::update(uint16_t object, const glm::vec3& pos) {
+    if (object >= _pos.size()) {
+        return;
+    }
+
+    glm::ivec3 cell = cell_of(pos);
+
+    _pos[object] = pos;
+
+    if (!_inserted[object]) {
+        _inserted[object] = 1;
+        _num_inserted++;
+        _cell[object] = cell;
+        link(object);
+        return;
+    }
+
+    if (cell != _cell[object]) {
+        unlink(object);
+        _cell[object] = cell;
+        link(object);
+    }
+}
+
+void Spatial_grid::remove(uint16_t object) {
+    if (!contains(object)) {
+        return;
+    }
+
+    unlink(object);
+
+    _inserted[object] = 0;
+    _num_inserted--;
+}
+
+template<typename Visit>
+void Spatial_grid::visit_box(const glm::vec3& min, const glm::vec3& max, Visit visit) const {
+    glm::ivec3 c0 = cell_of(min);
+    glm::ivec3 c1 = cell_of(max);
+
+    uint64_t num_cells = (uint64_t)(c1.x - c0.x + 1) * (uint64_t)(c1.y - c0.y + 1) * (uint64_t)(c1.z - c0.z + 1);
+
+    // a large box over few objects, looking at every object is cheaper than every cell
+    if (num_cells > _num_inserted) {
+        for (uint32_t i = 0; i < _pos.size(); ++i) {
+            if (_inserted[i]) {
+                visit((uint16_t)i);
+            }
+        }
+
+        return;
+    }
+
+    glm::ivec3 cell;
+
+    for (cell.z = c0.z; cell.z <= c1.z; ++cell.z) {
+        for (cell.y = c0.y; cell.y <= c1.y; ++cell.y) {
+            for (cell.x = c0.x; cell.x <= c1.x; ++cell.x) {
+                for (uint16_t o = _buckets[bucket_of(cell)]; o != SPATIAL_NO_OBJECT; o = _next[o]) {
+                    // other cells hash to the same bucket
+                    if (_cell[o] == cell) {
+                        visit(o);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void Spatial_grid::query_radius(const glm::vec3& center, float radius, std::vector<uint16_t>& out) const {
+    float radius_sq = radius * radius;
+    glm::vec3 r(radius, radius, radius);
+
+    visit_box(center - r, center + r, [&](uint16_t o) {
+        glm::vec3 d = _pos[o] - center;
+
+        if (d.x * d.x + d.y * d.y + d.z * d.z <= radius_sq) {
+            out.push_back(o);
+        }
+    });
+}
+
+void Spatial_grid::query_box(const glm::vec3& min, const glm::vec3& max, std::vector<uint16_t>& out) const {
+    visit_box(min, max, [&](uint16_t o) {
+        const glm::vec3& p = _pos[o];
+
+        if (p.x >= min.x && p.y >= min.y && p.z >= min.z && p.x <= max.x && p.y <= max.y && p.z <= max.z) {
+            out.push_back(o);
+        }
+    });
+}
+
+void Spatial_grid::nearest(const glm::vec3* points, uint32_t count, uint32_t k, float max_radius, uint16_t* out) {
+    for (uint32_t i = 0; i < count; ++i) {
+        const glm::vec3& point = points[i];
+
+        // grows the radius until k objects are in it, the k nearest are then among them
+        float radius = std::min(_cell_size, max_radius);
+
+        for (;;) {
+            _found.clear();
+            query_radius(point, radius, _found);
+
+            if (_found.size() >= k || radius >= max_radius) {
+                break;
+            }
+
+            radius = std::min(radius * 2.0f, max_radius);
+        }
+
+        _sorted.resize(_found.size());
+
+        for (uint32_t f = 0; f < _found.size(); ++f) {
+            glm::vec3 d = _pos[_found[f]] - point;
+            _sorted[f] = std::make_pair(d.x * d.x + d.y * d.y + d.z * d.z, _found[f]);
+        }
+
+        uint32_t num = std::min(k, (uint32_t)_sorted.size());
+
+        std::partial_sort(_sorted.begin(), _sorted.begin() + num, _sorted.end());
+
+        uint16_t* dst = out + (size_t)i * k;
+
+        for (uint32_t n = 0; n < k; ++n) {
+            dst[n] = n < num ? _sorted[n].second : SPATIAL_NO_OBJECT;
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+#define SPATIAL_CELL_SIZE   4.0f    // meters, about the range of an interaction
+#define SPATIAL_NO_OBJECT   0xffff
+
+/// <summary>
+/// A uniform grid of cells hashed into a table of buckets, so it needs no bounds
+/// + reset() with the number of objects, the objects are the indices below it
+/// + update() when an object moves, it is only relinked when it changes cell
+/// + query_radius(), query_box() append the objects in range, in no particular order
+/// + nearest() the k nearest objects for a batch of points
+/// The buckets are lists through the objects, the cell of each object is kept so two cells
+/// in the same bucket arent mixed up. A query visits the cells it covers, or every
+/// object when that is less work
+/// </summary>
+struct Spatial_grid {
+    Spatial_grid();
+
+    void reset(uint32_t num_objects, float cell_size = SPATIAL_CELL_SIZE);
+
+    // inserts the object the first time
+    void update(uint16_t object, const glm::vec3& pos);
+
+    void remove(uint16_t object);
+
+    bool contains(uint16_t object) const { return object < _inserted.size() && _inserted[object] != 0; }
+
+    const glm::vec3& position(uint16_t object) const { return _pos[object]; }
+
+    void query_radius(const glm::vec3& center, float radius, std::vector<uint16_t>& out) const;
+
+    void query_box(const glm::vec3& min, const glm::vec3& max, std::vector<uint16_t>& out) const;
+
+    // out[i * k .. i * k + k] is the nearest objects to points[i] within max_radius, closest first,
+    // SPATIAL_NO_OBJECT where there are fewer than k
+    void nearest(const glm::vec3* points, uint32_t count, uint32_t k, float max_radius, uint16_t* out);
+
+    uint32_t num_objects() const { return (uint32_t)_pos.size(); }
+
+private:
+    glm::ivec3 cell_of(const glm::vec3& pos) const;
+
+    uint32_t bucket_of(const glm::ivec3& cell) const;
+
+    void link(uint16_t object);
+
+    void unlink(uint16_t object);
+
+    // calls visit for every object in a cell that overlaps the box
+    template<typename Visit>
+    void visit_box(const glm::vec3& min, const glm::vec3& max, Visit visit) const;
+
+    float                   _cell_size;
+    float                   _inv_cell_size;
+    uint32_t                _bucket_mask;
+
+    std::vector<uint16_t>   _buckets;
+
+    std::vector<glm::vec3>  _pos;
+    std::vector<glm::ivec3> _cell;
+    std::vector<uint16_t>   _next;
+    std::vector<uint16_t>   _prev;
+    std::vector<uint8_t>    _inserted;
+    uint32_t                _num_inserted;
+
+    // scratch for nearest()
+    std::vector<uint16_t>   _found;
+    std::vector<std::pair<float, uint16_t>> _sorted;
+};
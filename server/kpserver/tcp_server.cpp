@@ -24,7 +24,6 @@ void connection_info(struct sockaddr_in& client, Net_client_info& info)
 Tcp_server::Tcp_server() 
     :   _max_clients(10000),
         _port(0),
-        _clear_tick_counter(0),
         _master_socket(0),
         _addrlen(0),
         _on_connect(nullptr),
@@ -148,11 +147,10 @@ bool Tcp_server::init(uint16_t port) {
 
 int Tcp_server::read() {
     
-    // clear our block list every once in a while
-    if (_clear_tick_counter++ > 100) {
-        _blocked_clients.clear();
-        _clear_tick_counter = 0;
-    }
+    auto now = std::chrono::high_resolution_clock::now();
+
+    // drop the block list entries that have expired
+    _block_list.update(now);
 
     //set of socket descriptors
     fd_set readfds;
@@ -213,8 +211,10 @@ int Tcp_server::read() {
         connection_info(_address, info);
         info.tcp_socket = new_socket;
 
-        if (_blocked_clients.find(info.int_ip) != _blocked_clients.end()) {
-            TRACE("Client is blocked\n");
+        bool blocked = _block_list.is_blocked(info.int_ip);
+
+        if (blocked || !_block_list.try_add_connection(info.int_ip)) {
+            TRACE(blocked ? "Client is blocked\n" : "Client has too many connections\n");
 #ifdef WIN32
             shutdown(new_socket, SD_BOTH);
             closesocket(new_socket);
@@ -261,8 +261,8 @@ int Tcp_server::read() {
             }
 
             if (valread == 1024) { // force shutdown for buffer overflow
+                _block_list.block(client->info.int_ip);
                 disconnect(client);
-                _blocked_clients[client->info.int_ip] = true;
                 --i;
                 continue;
             }
@@ -272,8 +272,8 @@ int Tcp_server::read() {
 
                 if (!client->log_activity()) { // force shutdown for package flooding
                     TRACE("Disconnect due to packet flooding\n");
+                    _block_list.block(client->info.int_ip);
                     disconnect(client);
-                    _blocked_clients[client->info.int_ip] = true;
                     --i;
                     continue;
                 }
@@ -296,6 +296,8 @@ void Tcp_server::disconnect(Net_client* client) {
         _on_disconnect(client);
     }
 
+    _block_list.remove_connection(client->info.int_ip);
+
     for (int i = 0; i < _clients.size(); ++i) {
         if (_clients[i].get() == client) {
             _clients.erase(_clients.begin() + i);
@@ -304,6 +306,10 @@ void Tcp_server::disconnect(Net_client* client) {
     }
 }
 
+Ip_block_list& Tcp_server::block_list() {
+    return _block_list;
+}
+
 void Tcp_server::send_client_data() {
     for (int i = 0; i < _clients.size(); ++i) {
         _clients[i]->send_tcp_data();
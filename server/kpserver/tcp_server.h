@@ -47,6 +47,7 @@
 #include <unordered_map>
 
 #include "net_client.h"
+#include "ip_block_list.h"
 
 
 
@@ -74,6 +75,8 @@ struct Tcp_server {
     bool send_data_to_all(const std::vector<uint8_t>& data, size_t len);
 
     void disconnect(Net_client* client);
+
+    Ip_block_list& block_list();
 private:
     void print_error();
 
@@ -85,7 +88,6 @@ private:
     int _addrlen;
     
     int _max_clients;
-    int _clear_tick_counter;
 
     std::vector<std::unique_ptr<Net_client>> _clients;
 
@@ -93,7 +95,7 @@ private:
     std::function<void(Net_client*)> _on_disconnect;
     std::function<void(Net_client*, const std::vector<uint8_t>& data, int32_t len)> _on_data;
 
-    std::unordered_map<uint64_t, bool> _blocked_clients;
+    Ip_block_list _block_list;
 
     std::vector<uint8_t> _data_buffer;
 };
\ No newline at end of file
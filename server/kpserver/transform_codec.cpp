@@ -0,0 +1,423 @@
+#include "transform_codec.h"
+
+#include <cmath>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define QUAT_SSE 1
+#include <emmintrin.h>
+#endif
+
+#define QUAT_COMPONENT_RANGE 0.707106781f // the three smallest components are within [-1/sqrt(2), 1/sqrt(2)]
+
+void quat_compress(const glm::quat& q, uint32_t bits, uint8_t& index, uint16_t out[3]) {
+    // Determine the index of the largest (absolute value) element in the Quaternion.
+    // We will transmit only the three smallest elements, and reconstruct the largest
+    // element during decoding.
+    uint8_t largest = 0;
+    float largest_abs = fabsf(q[0]);
+
+    for (int i = 1; i < 4; ++i) {
+        float ab = fabsf(q[i]);
+
+        if (ab > largest_abs) {
+            largest = i;
+            largest_abs = ab;
+        }
+    }
+
+    // (x,y,z,w) and (-x,-y,-z,-w) represent the same rotation, so we flip
+    // the quaternion to make the omitted element positive
+    float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+    float max_value = (float)((1u << bits) - 1);
+    float scale = max_value / (2.0f * QUAT_COMPONENT_RANGE);
+
+    int j = 0;
+
+    for (int i = 0; i < 4; ++i) {
+        if (i == largest) {
+            continue;
+        }
+
+        float v = (q[i] * sign + QUAT_COMPONENT_RANGE) * scale + 0.5f;
+
+        v = v < 0.0f ? 0.0f : (v > max_value ? max_value : v);
+
+        out[j++] = (uint16_t)v;
+    }
+
+    index = largest;
+}
+
+glm::quat quat_decompress(uint8_t index, const uint16_t in[3], uint32_t bits) {
+    float max_value = (float)((1u << bits) - 1);
+    float inv_scale = (2.0f * QUAT_COMPONENT_RANGE) / max_value;
+
+    float a = (float)in[0] * inv_scale - QUAT_COMPONENT_RANGE;
+    float b = (float)in[1] * inv_scale - QUAT_COMPONENT_RANGE;
+    float c = (float)in[2] * inv_scale - QUAT_COMPONENT_RANGE;
+    float d = sqrtf(std::max(0.0f, 1.0f - (a * a + b * b + c * c)));
+
+    glm::quat q;
+    int j = 0;
+    float v[3] = { a, b, c };
+
+    for (int i = 0; i < 4; ++i) {
+        q[i] = (i == index) ? d : v[j++];
+    }
+
+    return q;
+}
+
+#ifdef QUAT_SSE
+static_assert(sizeof(glm::quat) == 4 * sizeof(float), "the batch functions load quaternions as four floats");
+
+// a where mask is set, else b
+static inline __m128 quat_select(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline __m128i quat_select(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+#endif
+
+void quat_compress_batch(const glm::quat* q, uint32_t count, uint32_t bits, uint8_t* index, uint16_t* out) {
+    uint32_t i = 0;
+
+#ifdef QUAT_SSE
+    float max_value = (float)((1u << bits) - 1);
+    float scale = max_value / (2.0f * QUAT_COMPONENT_RANGE);
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 sign_mask = _mm_castsi128_ps(_mm_set1_epi32((int)0x80000000));
+    const __m128 range = _mm_set1_ps(QUAT_COMPONENT_RANGE);
+    const __m128 scale4 = _mm_set1_ps(scale);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 max4 = _mm_set1_ps(max_value);
+
+    alignas(16) int32_t largest_out[4];
+    alignas(16) int32_t values[3][4];
+
+    for (; i + 4 <= count; i += 4) {
+        // one component of the four quaternions per register
+        __m128 c0 = _mm_loadu_ps(&q[i][0]);
+        __m128 c1 = _mm_loadu_ps(&q[i + 1][0]);
+        __m128 c2 = _mm_loadu_ps(&q[i + 2][0]);
+        __m128 c3 = _mm_loadu_ps(&q[i + 3][0]);
+
+        _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+        // the first largest wins a tie, like the scalar loop
+        __m128 largest_abs = _mm_and_ps(c0, abs_mask);
+        __m128 largest_value = c0;
+        __m128i largest = _mm_setzero_si128();
+
+        __m128 c[4] = { c0, c1, c2, c3 };
+
+        for (int k = 1; k < 4; ++k) {
+            __m128 ab = _mm_and_ps(c[k], abs_mask);
+            __m128 greater = _mm_cmpgt_ps(ab, largest_abs);
+
+            largest_abs = quat_select(greater, ab, largest_abs);
+            largest_value = quat_select(greater, c[k], largest_value);
+            largest = quat_select(_mm_castps_si128(greater), _mm_set1_epi32(k), largest);
+        }
+
+        // multiplying by -1 is flipping the sign bit
+        __m128 flip = _mm_and_ps(_mm_cmplt_ps(largest_value, zero), sign_mask);
+
+        // the three components that are left, in order
+        __m128 skip0 = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_setzero_si128()));
+        __m128 skip1 = _mm_castsi128_ps(_mm_cmplt_epi32(largest, _mm_set1_epi32(2)));
+        __m128 skip2 = _mm_castsi128_ps(_mm_cmplt_epi32(largest, _mm_set1_epi32(3)));
+
+        __m128 smallest[3] = {
+            quat_select(skip0, c1, c0),
+            quat_select(skip1, c2, c1),
+            quat_select(skip2, c3, c2)
+        };
+
+        for (int k = 0; k < 3; ++k) {
+            __m128 v = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_xor_ps(smallest[k], flip), range), scale4), half);
+
+            v = _mm_min_ps(_mm_max_ps(v, zero), max4);
+
+            _mm_store_si128((__m128i*)values[k], _mm_cvttps_epi32(v));
+        }
+
+        _mm_store_si128((__m128i*)largest_out, largest);
+
+        for (int lane = 0; lane < 4; ++lane) {
+            index[i + lane] = (uint8_t)largest_out[lane];
+            out[(i + lane) * 3] = (uint16_t)values[0][lane];
+            out[(i + lane) * 3 + 1] = (uint16_t)values[1][lane];
+            out[(i + lane) * 3 + 2] = (uint16_t)values[2][lane];
+        }
+    }
+#endif
+
+    for (; i < count; ++i) {
+        quat_compress(q[i], bits, index[i], &out[i * 3]);
+    }
+}
+
+void quat_decompress_batch(const uint8_t* index, const uint16_t* in, uint32_t count, uint32_t bits, glm::quat* out) {
+    uint32_t i = 0;
+
+#ifdef QUAT_SSE
+    float max_value = (float)((1u << bits) - 1);
+    float inv_scale = (2.0f * QUAT_COMPONENT_RANGE) / max_value;
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 range = _mm_set1_ps(QUAT_COMPONENT_RANGE);
+    const __m128 inv_scale4 = _mm_set1_ps(inv_scale);
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 v[3];
+
+        for (int k = 0; k < 3; ++k) {
+            __m128i raw = _mm_setr_epi32(in[i * 3 + k], in[(i + 1) * 3 + k], in[(i + 2) * 3 + k], in[(i + 3) * 3 + k]);
+
+            v[k] = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(raw), inv_scale4), range);
+        }
+
+        __m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(v[0], v[0]), _mm_mul_ps(v[1], v[1])), _mm_mul_ps(v[2], v[2]));
+        __m128 d = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(one, sum), zero));
+
+        __m128i largest = _mm_setr_epi32(index[i], index[i + 1], index[i + 2], index[i + 3]);
+
+        __m128 is0 = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_setzero_si128()));
+        __m128 is1 = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_set1_epi32(1)));
+        __m128 is2 = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_set1_epi32(2)));
+        __m128 is3 = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_set1_epi32(3)));
+
+        // the components after the largest move up one place
+        __m128 c0 = quat_select(is0, d, v[0]);
+        __m128 c1 = quat_select(is0, v[0], quat_select(is1, d, v[1]));
+        __m128 c2 = quat_select(_mm_or_ps(is0, is1), v[1], quat_select(is2, d, v[2]));
+        __m128 c3 = quat_select(is3, d, v[2]);
+
+        _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+        _mm_storeu_ps(&out[i][0], c0);
+        _mm_storeu_ps(&out[i + 1][0], c1);
+        _mm_storeu_ps(&out[i + 2][0], c2);
+        _mm_storeu_ps(&out[i + 3][0], c3);
+    }
+#endif
+
+    for (; i < count; ++i) {
+        out[i] = quat_decompress(index[i], &in[i * 3], bits);
+    }
+}
+
+Transform_codec::Transform_codec()
+    :   bounds_min(-128.0f, -16.0f, -128.0f),
+        bounds_max(128.0f, 16.0f, 128.0f),
+        position_precision(0.02f),
+        rotation_bits(9),
+        velocity_enabled(false),
+        max_speed(16.0f),
+        velocity_precision(0.05f) {
+
+    update_bits();
+}
+
+void Transform_codec::set_bounds(const glm::vec3& min, const glm::vec3& max) {
+    bounds_min = min;
+    bounds_max = max;
+
+    update_bits();
+}
+
+void Transform_codec::set_position_precision(float meters) {
+    position_precision = meters;
+
+    update_bits();
+}
+
+void Transform_codec::set_rotation_bits(uint32_t bits) {
+    rotation_bits = bits < 2 ? 2 : (bits > 16 ? 16 : bits);
+}
+
+void Transform_codec::set_velocity(bool enabled, float max_speed_, float precision) {
+    velocity_enabled = enabled;
+    max_speed = max_speed_;
+    velocity_precision = precision;
+
+    update_bits();
+}
+
+void Transform_codec::update_bits() {
+    for (int i = 0; i < 3; ++i) {
+        float size = bounds_max[i] - bounds_min[i];
+
+        position_max[i] = size > 0.0f ? (uint32_t)ceilf(size / position_precision) : 0;
+        position_bits[i] = bits_required(position_max[i]);
+    }
+
+    velocity_max = (uint32_t)ceilf((2.0f * max_speed) / velocity_precision);
+    velocity_bits = bits_required(velocity_max);
+}
+
+void Transform_codec::quantize(const glm::vec3& pos, const glm::quat& rot, Transform_q& out) const {
+    quantize_position(pos, out);
+
+    quat_compress(rot, rotation_bits, out.rot_index, out.rot);
+}
+
+void Transform_codec::quantize_position(const glm::vec3& pos, Transform_q& out) const {
+    for (int i = 0; i < 3; ++i) {
+        float v = (pos[i] - bounds_min[i]) / position_precision + 0.5f;
+
+        v = v < 0.0f ? 0.0f : v;
+        out.pos[i] = std::min((uint32_t)v, position_max[i]);
+    }
+}
+
+void Transform_codec::quantize_velocity(const glm::vec3& vel, Transform_q& out) const {
+    for (int i = 0; i < 3; ++i) {
+        float v = (vel[i] + max_speed) / velocity_precision + 0.5f;
+
+        v = v < 0.0f ? 0.0f : v;
+        out.vel[i] = std::min((uint32_t)v, velocity_max);
+    }
+
+    out.has_velocity = true;
+}
+
+glm::vec3 Transform_codec::position(const Transform_q& q) const {
+    return glm::vec3(
+        bounds_min.x + (float)q.pos[0] * position_precision,
+        bounds_min.y + (float)q.pos[1] * position_precision,
+        bounds_min.z + (float)q.pos[2] * position_precision);
+}
+
+glm::quat Transform_codec::rotation(const Transform_q& q) const {
+    return quat_decompress(q.rot_index, q.rot, rotation_bits);
+}
+
+glm::vec3 Transform_codec::velocity(const Transform_q& q) const {
+    if (!q.has_velocity) {
+        return glm::vec3(0, 0, 0);
+    }
+
+    return glm::vec3(
+        (float)q.vel[0] * velocity_precision - max_speed,
+        (float)q.vel[1] * velocity_precision - max_speed,
+        (float)q.vel[2] * velocity_precision - max_speed);
+}
+
+void Transform_codec::write_position(Bit_writer& writer, const Transform_q& q) const {
+    writer.write_bits(q.pos[0], position_bits[0]);
+    writer.write_bits(q.pos[1], position_bits[1]);
+    writer.write_bits(q.pos[2], position_bits[2]);
+}
+
+void Transform_codec::write_rotation(Bit_writer& writer, const Transform_q& q) const {
+    writer.write_bits(q.rot_index, 2);
+    writer.write_bits(q.rot[0], rotation_bits);
+    writer.write_bits(q.rot[1], rotation_bits);
+    writer.write_bits(q.rot[2], rotation_bits);
+}
+
+void Transform_codec::write_velocity(Bit_writer& writer, const Transform_q& q) const {
+    writer.write_bits(q.vel[0], velocity_bits);
+    writer.write_bits(q.vel[1], velocity_bits);
+    writer.write_bits(q.vel[2], velocity_bits);
+}
+
+bool Transform_codec::read_position(Bit_reader& reader, Transform_q& q) const {
+    for (int i = 0; i < 3; ++i) {
+        if (!reader.read_bits(position_bits[i], q.pos[i])) {
+            return false;
+        }
+
+        // a malicious client can send values outside the level
+        q.pos[i] = std::min(q.pos[i], position_max[i]);
+    }
+
+    return true;
+}
+
+bool Transform_codec::read_rotation(Bit_reader& reader, Transform_q& q) const {
+    uint32_t v = 0;
+
+    if (!reader.read_bits(2, v)) {
+        return false;
+    }
+
+    q.rot_index = (uint8_t)v;
+
+    for (int i = 0; i < 3; ++i) {
+        if (!reader.read_bits(rotation_bits, v)) {
+            return false;
+        }
+
+        q.rot[i] = (uint16_t)v;
+    }
+
+    return true;
+}
+
+bool Transform_codec::read_velocity(Bit_reader& reader, Transform_q& q) const {
+    for (int i = 0; i < 3; ++i) {
+        if (!reader.read_bits(velocity_bits, q.vel[i])) {
+            return false;
+        }
+
+        q.vel[i] = std::min(q.vel[i], velocity_max);
+    }
+
+    q.has_velocity = true;
+
+    return true;
+}
+
+void Transform_codec::write(Bit_writer& writer, const Transform_q& q) const {
+    write_position(writer, q);
+    write_rotation(writer, q);
+
+    if (velocity_enabled) {
+        writer.write_bool(q.has_velocity);
+
+        if (q.has_velocity) {
+            write_velocity(writer, q);
+        }
+    }
+}
+
+bool Transform_codec::read(Bit_reader& reader, Transform_q& q) const {
+    if (!read_position(reader, q) || !read_rotation(reader, q)) {
+        return false;
+    }
+
+    q.has_velocity = false;
+
+    if (velocity_enabled) {
+        bool has_velocity = false;
+
+        if (!reader.read_bool(has_velocity)) {
+            return false;
+        }
+
+        if (has_velocity && !read_velocity(reader, q)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+uint32_t Transform_codec::max_transform_bits() const {
+    uint32_t bits = position_bits[0] + position_bits[1] + position_bits[2] + 2 + rotation_bits * 3;
+
+    if (velocity_enabled) {
+        bits += 1 + velocity_bits * 3;
+    }
+
+    return bits;
+}
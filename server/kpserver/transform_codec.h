@@ -0,0 +1,119 @@
+#pragma once
+
+#include <stdint.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "bitstream.h"
+
+/// <summary>
+/// A quantized transform, this is what we store, compare and send
+/// Floats are only used when we need to do math on the values
+/// </summary>
+struct Transform_q {
+    uint32_t    pos[3];
+    uint8_t     rot_index;  // index of the omitted (largest) quaternion component
+    uint16_t    rot[3];     // the three smallest components
+    uint32_t    vel[3];     // offset binary, 0 is -max_speed
+    bool        has_velocity;
+
+    Transform_q() : rot_index(3), has_velocity(false) {
+        pos[0] = pos[1] = pos[2] = 0;
+        rot[0] = rot[1] = rot[2] = 0;
+        vel[0] = vel[1] = vel[2] = 0;
+    }
+
+    bool pos_equals(const Transform_q& other) const {
+        return pos[0] == other.pos[0] && pos[1] == other.pos[1] && pos[2] == other.pos[2];
+    }
+
+    bool rot_equals(const Transform_q& other) const {
+        return rot_index == other.rot_index && rot[0] == other.rot[0] && rot[1] == other.rot[1] && rot[2] == other.rot[2];
+    }
+
+    bool vel_equals(const Transform_q& other) const {
+        return has_velocity == other.has_velocity && vel[0] == other.vel[0] && vel[1] == other.vel[1] && vel[2] == other.vel[2];
+    }
+};
+
+/// <summary>
+/// Smallest three quaternion compression, each of the three smallest components
+/// is stored in bits bits, the index of the largest in 2 bits
+/// </summary>
+void quat_compress(const glm::quat& q, uint32_t bits, uint8_t& index, uint16_t out[3]);
+
+glm::quat quat_decompress(uint8_t index, const uint16_t in[3], uint32_t bits);
+
+/// <summary>
+/// quat_compress and quat_decompress of count quaternions, four at a time with SSE2
+/// branch free, the results are bit exact with the scalar functions
+/// the components are three per quaternion, in and out hold count * 3 values
+/// </summary>
+void quat_compress_batch(const glm::quat* q, uint32_t count, uint32_t bits, uint8_t* index, uint16_t* out);
+
+void quat_decompress_batch(const uint8_t* index, const uint16_t* in, uint32_t count, uint32_t bits, glm::quat* out);
+
+/// <summary>
+/// Describes how transforms are quantized and bit packed
+/// + Position is bounded by the level bounds and stored with a fixed precision,
+///   the bit width per axis is derived from the size of the level
+/// + Rotation is smallest three with rotation_bits per component
+/// + Velocity is optional and sent only when the transform has it and the codec enables it
+///
+/// Both sides must use the same settings, the server sends them with Net_transform_codec_config
+/// </summary>
+struct Transform_codec {
+    Transform_codec();
+
+    void set_bounds(const glm::vec3& min, const glm::vec3& max);
+
+    void set_position_precision(float meters);
+
+    void set_rotation_bits(uint32_t bits);
+
+    void set_velocity(bool enabled, float max_speed, float precision);
+
+    void quantize(const glm::vec3& pos, const glm::quat& rot, Transform_q& out) const;
+
+    void quantize_position(const glm::vec3& pos, Transform_q& out) const;
+
+    void quantize_velocity(const glm::vec3& vel, Transform_q& out) const;
+
+    glm::vec3 position(const Transform_q& q) const;
+
+    glm::quat rotation(const Transform_q& q) const;
+
+    glm::vec3 velocity(const Transform_q& q) const;
+
+    void write_position(Bit_writer& writer, const Transform_q& q) const;
+    void write_rotation(Bit_writer& writer, const Transform_q& q) const;
+    void write_velocity(Bit_writer& writer, const Transform_q& q) const;
+
+    bool read_position(Bit_reader& reader, Transform_q& q) const;
+    bool read_rotation(Bit_reader& reader, Transform_q& q) const;
+    bool read_velocity(Bit_reader& reader, Transform_q& q) const;
+
+    // a complete transform, a velocity flag bit is written if velocity is enabled
+    void write(Bit_writer& writer, const Transform_q& q) const;
+    bool read(Bit_reader& reader, Transform_q& q) const;
+
+    uint32_t max_transform_bits() const;
+
+    glm::vec3   bounds_min;
+    glm::vec3   bounds_max;
+    float       position_precision;
+
+    uint32_t    rotation_bits;
+
+    bool        velocity_enabled;
+    float       max_speed;
+    float       velocity_precision;
+
+    uint32_t    position_bits[3];
+    uint32_t    position_max[3];
+    uint32_t    velocity_bits;
+    uint32_t    velocity_max;
+
+private:
+    void update_bits();
+};
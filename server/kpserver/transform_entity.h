@@ -3,6 +3,7 @@
 #include <stdint.h>
 
 #include "net_packet.h"
+#include "transform_codec.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 
@@ -12,18 +13,19 @@ struct Transform_entity {
     
     glm::vec3 pos;
     glm::quat rot;
+    glm::vec3 vel;
 
-    std::vector<uint8_t> raw_pos_data;
+    // the quantized transform, forwarded as is to the other players
+    Transform_q q;
 
     Transform_entity(uint16_t id);
     
     virtual ~Transform_entity();
 
-    void set_inc_pos(const Net_pos& pos);
+    void set_inc_pos(const Net_pos& pos, const Transform_codec& codec);
 
-    void set_out_pos(Net_pos& netpos);
+    // same as set_inc_pos with the rotation already decoded
+    void set_inc_pos(const Net_pos& pos, const glm::quat& rotation, const Transform_codec& codec);
 
-    void fill_data(std::vector<uint8_t>& data, uint32_t offset);
-
-    void quat_to_data(std::vector<uint8_t>& data, uint32_t offset);
+    void set_out_pos(Net_pos& netpos, const Transform_codec& codec);
 };
\ No newline at end of file
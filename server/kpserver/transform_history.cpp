@@ -0,0 +1,113 @@
+#include "transform_history.h"
+
+Transform_history::Transform_history() : _window(0), _capacity(0), _mask(0), _latest(0) {
+    set_window(TRANSFORM_HISTORY_WINDOW_MS);
+}
+
+void Transform_history::set_window(uint32_t milliseconds) {
+    _window = milliseconds;
+
+    uint32_t samples = (uint32_t)(((uint64_t)milliseconds * TRANSFORM_HISTORY_RATE + 999) / 1000);
+
+    // two samples are needed to interpolate, a power of two so the ring index is a mask
+    _capacity = 2;
+
+    while (_capacity < samples) {
+        _capacity <<= 1;
+    }
+
+    _mask = _capacity - 1;
+
+    reset((uint32_t)_head.size());
+}
+
+void Transform_history::reset(uint32_t num_entities) {
+    _latest = 0;
+
+    _head.assign(num_entities, 0);
+    _count.assign(num_entities, 0);
+
+    _timestamps.assign(num_entities * _capacity, 0);
+    _positions.assign(num_entities * _capacity, glm::vec3(0, 0, 0));
+    _rotations.assign(num_entities * _capacity, glm::quat(1, 0, 0, 0));
+}
+
+void Transform_history::record(uint32_t entity, uint32_t timestamp, const glm::vec3& pos, const glm::quat& rot) {
+    if (entity >= _head.size()) {
+        return;
+    }
+
+    uint32_t count = _count[entity];
+    uint32_t index;
+
+    if (count > 0 && timestamp <= _timestamps[slot(entity, count - 1)]) {
+        // more than one transform in the same tick, the last one wins
+        if (timestamp < _timestamps[slot(entity, count - 1)]) {
+            return;
+        }
+
+        index = slot(entity, count - 1);
+    }
+    else {
+        index = entity * _capacity + _head[entity];
+
+        _head[entity] = (_head[entity] + 1) & _mask;
+
+        if (count < _capacity) {
+            _count[entity]++;
+        }
+    }
+
+    _timestamps[index] = timestamp;
+    _positions[index] = pos;
+    _rotations[index] = rot;
+
+    if (timestamp > _latest) {
+        _latest = timestamp;
+    }
+}
+
+bool Transform_history::sample(uint32_t entity, uint32_t timestamp, glm::vec3& pos, glm::quat& rot) const {
+    if (entity >= _head.size() || _count[entity] == 0) {
+        return false;
+    }
+
+    // a client cant ask us to go further back than the window
+    if (_latest > _window && timestamp < _latest - _window) {
+        timestamp = _latest - _window;
+    }
+
+    // the first sample newer than the timestamp
+    uint32_t low = 0;
+    uint32_t high = _count[entity];
+
+    while (low < high) {
+        uint32_t mid = (low + high) / 2;
+
+        if (_timestamps[slot(entity, mid)] <= timestamp) {
+            low = mid + 1;
+        }
+        else {
+            high = mid;
+        }
+    }
+
+    if (low == 0 || low == _count[entity]) {
+        uint32_t index = slot(entity, low == 0 ? 0 : low - 1);
+
+        pos = _positions[index];
+        rot = _rotations[index];
+
+        return true;
+    }
+
+    uint32_t from = slot(entity, low - 1);
+    uint32_t to = slot(entity, low);
+
+    float t = (float)(timestamp - _timestamps[from]) / (float)(_timestamps[to] - _timestamps[from]);
+
+    pos = glm::mix(_positions[from], _positions[to], t);
+    rot = glm::slerp(_rotations[from], _rotations[to], t);
+
+    return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#define TRANSFORM_HISTORY_WINDOW_MS 1000    // default, set from the ini
+#define TRANSFORM_HISTORY_RATE      60      // samples per second the ring is sized for
+
+/// <summary>
+/// The last transforms of every entity with the session timestamp they arrived at,
+/// so the server can tell where an entity was when a client saw it
+/// + record() every transform that arrives, timestamps must not go backwards
+/// + sample() interpolates the transform at a timestamp, a binary search in the ring of the entity
+/// Every entity has a fixed ring of samples, the rings are laid out as separate arrays of
+/// timestamps, positions and rotations so the search only touches the timestamps.
+/// The ring holds TRANSFORM_HISTORY_RATE samples per second of the window, an entity that
+/// sends faster than that has a shorter history. Timestamps older than the window are clamped
+/// </summary>
+struct Transform_history {
+    Transform_history();
+
+    // how far back sample() can go
+    void set_window(uint32_t milliseconds);
+
+    // clears the history and sizes the rings, memory is num_entities * capacity samples
+    void reset(uint32_t num_entities);
+
+    void record(uint32_t entity, uint32_t timestamp, const glm::vec3& pos, const glm::quat& rot);
+
+    // false when there is no sample of the entity, before the first and after the last sample
+    // the transform is clamped to that sample
+    bool sample(uint32_t entity, uint32_t timestamp, glm::vec3& pos, glm::quat& rot) const;
+
+    uint32_t count(uint32_t entity) const { return _count[entity]; }
+    uint32_t capacity() const { return _capacity; }
+    uint32_t window() const { return _window; }
+
+private:
+    // the slot of the nth oldest sample of the entity
+    uint32_t slot(uint32_t entity, uint32_t nth) const {
+        return entity * _capacity + ((_head[entity] - _count[entity] + nth) & _mask);
+    }
+
+    uint32_t    _window;
+    uint32_t    _capacity; // power of two
+    uint32_t    _mask;
+    uint32_t    _latest; // newest timestamp of any entity
+
+    std::vector<uint32_t>   _head; // the slot the next sample goes in
+    std::vector<uint32_t>   _count;
+
+    // entity e owns the slots e * _capacity .. (e + 1) * _capacity
+    std::vector<uint32_t>   _timestamps;
+    std::vector<glm::vec3>  _positions;
+    std::vector<glm::quat>  _rotations;
+};
@@ -33,12 +33,14 @@
 
 #include "net_session_player.h"
 #include "net_packet.h"
+#include "net_schema.h"
 
 #include "trace.h"
 
 Udp_server::Udp_server()
 	:	_port(0),
 		_socket(-1),
+		_block_list(nullptr),
 		_on_client_data(nullptr),
 		_on_client_connect(nullptr)
 	{
@@ -243,6 +245,14 @@ int Udp_server::read() {
 #else 
 	while ((nbytes = recvfrom(_socket, (char*)&_recv_buffer[0], _recv_buffer.size(), 0, (struct sockaddr*) &client_addr, (socklen_t*)&client_addr_len)) >= 0) {
 #endif
+		uint16_t port = ntohs(client_addr.sin_port);
+		uint32_t ip = (uint32_t)ntohl(client_addr.sin_addr.s_addr);
+
+		// drop blocked sources before we do any lookups or parsing
+		if (_block_list != nullptr && _block_list->is_blocked(ip)) {
+			continue;
+		}
+
 		MsgType type = (MsgType)((uint8_t)_recv_buffer[0]);
 
 		if (type == MsgType::NetUDPEstablish) {
@@ -250,28 +260,37 @@ int Udp_server::read() {
 			// We previously requested that the client send this message via our TCP server
 			// using a Net_Udp_client_connection_info packet, where we sent the client code and
 			// client id
-			Net_Udp_establish est(_recv_buffer, 0);
-			
-			uint16_t port = ntohs(client_addr.sin_port);
-			uint32_t ip = (uint32_t)ntohl(client_addr.sin_addr.s_addr);
+			Packet_reader reader(_recv_buffer, nbytes);
+			Net_Udp_establish storage;
+			const Net_Udp_establish* est = wire_view(reader, storage);
+
+			if (est == NULL) {
+				continue;
+			}
 
 			// fill the IP and port in a wider integer
 			uint64_t quick_hash = ((uint64_t)ip << 16) + port;
 
 			// fetch the client based on client_id
-			if (_client_id_map.find(est.client_id) == _client_id_map.end()) {
+			if (_client_id_map.find(est->client_id) == _client_id_map.end()) {
 				// we didnt find a client, so this is weird
 				return 0;
 			}
 
-			auto client = _client_id_map[est.client_id];
+			auto client = _client_id_map[est->client_id];
 			
 			// make sure the code matches
-			if (client->info.udp_code != est.code) {
+			if (client->info.udp_code != est->code) {
 				TRACE("Code mismatch\n");
 				return 0;
 			}
 
+			// a new UDP connection starts its sequence numbers over
+			if (!client->info.udp_established) {
+				client->reliable.reset();
+				client->fragments.reset();
+			}
+
 			// assign the address structs
 			memcpy(&client->info.udp_addr, &client_addr, sizeof(client_addr));
 			client->info.udp_addr_len = client_addr_len;
@@ -283,15 +302,12 @@ int Udp_server::read() {
 
 			// notifiy our listeners on the new UDP client connection
 			if (_on_client_connect != nullptr) {
-				_on_client_connect(_client_hash_map[quick_hash], est);
+				_on_client_connect(_client_hash_map[quick_hash], *est);
 			}
 
 			return 0;
 		}
 
-		uint16_t port = ntohs(client_addr.sin_port);
-		uint32_t ip = (uint32_t)ntohl(client_addr.sin_addr.s_addr);
-
 		// find the client by IP+Port
 		uint64_t quick_hash = ((uint64_t)ip << 16) + port;
 
@@ -320,6 +336,15 @@ void Udp_server::remove_client(Net_client* client) {
 	}
 }
 
+/// <summary>
+/// The block list is owned by the TCP server, we only read from it
+/// so blocked sources are dropped as early as possible
+/// </summary>
+/// <param name="block_list"></param>
+void Udp_server::set_block_list(const Ip_block_list* block_list) {
+	_block_list = block_list;
+}
+
 /// <summary>
 /// When we want to send out data to all players within a session
 /// </summary>
@@ -360,6 +385,12 @@ int Udp_server::send(const std::vector<Net_client*>& clients, const std::vector<
 	return 0;
 }
 
+void Udp_server::send_client_data(std::chrono::time_point<std::chrono::high_resolution_clock>& now) {
+	for (auto& client : _client_hash_map) {
+		client.second->send_udp_data(this, now);
+	}
+}
+
 int Udp_server::get_port() const {
 	return _port;
 }
\ No newline at end of file
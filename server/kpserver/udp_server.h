@@ -40,8 +40,10 @@
 #include <functional>
 #include <memory>
 #include <unordered_map>
+#include <chrono>
 #include "net_client.h"
 #include "net_packet.h"
+#include "ip_block_list.h"
 
 ///
 /// Handles the position messages
@@ -75,6 +77,11 @@ struct Udp_server {
 
     void remove_client(Net_client* client);
 
+    void set_block_list(const Ip_block_list* block_list);
+
+    // flushes the queued UDP data of every established client, call once per tick
+    void send_client_data(std::chrono::time_point<std::chrono::high_resolution_clock>& now);
+
     int read();
 
 private:
@@ -88,6 +95,8 @@ private:
 
     std::vector<uint8_t> _recv_buffer;
 
+    const Ip_block_list* _block_list;
+
     std::function<void(Net_client*, const Net_Udp_establish&)> _on_client_connect;
     std::function<void(Net_client*, const std::vector<uint8_t>&, int32_t)> _on_client_data;
 
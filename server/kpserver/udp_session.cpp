@@ -22,16 +22,11 @@ void Udp_session::on_pos_inc_data(const Net_pos& pos) {
         return;
     }
 
-    // update the player position
-    player->second->last_pos.x = ((float)pos.pos[0] / 100.0f);
-    player->second->last_pos.y = ((float)pos.pos[1] / 100.0f);
-    player->second->last_pos.z = ((float)pos.pos[2] / 100.0f);
-
-    // update the player rotation
-    player->second->last_rot.x = ((float)pos.rot[0] / 100.0f);
-    player->second->last_rot.y = ((float)pos.rot[1] / 100.0f);
-    player->second->last_rot.z = ((float)pos.rot[2] / 100.0f);
-    player->second->last_rot.w = ((float)pos.rot[3] / 100.0f);
+    const Transform_codec& codec = _net_session->get_transform_codec();
+
+    // update the player position and rotation
+    player->second->last_pos = codec.position(pos.transform);
+    player->second->last_rot = codec.rotation(pos.transform);
 
     // store the timestamp of the last message
     player->second->last_input_ts = std::chrono::high_resolution_clock::now();
@@ -0,0 +1,876 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <type_traits>
+#include <vector>
+
+#include "packet_view.h"
+
+// the wire format is little endian, on little endian hosts with a matching
+// struct layout a message can be read in place
+#if defined(_WIN32) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define WIRE_HOST_LITTLE_ENDIAN 1
+#else
+#define WIRE_HOST_LITTLE_ENDIAN 0
+#endif
+
+#define WIRE_MAX_OPTIONAL_FIELDS 8
+
+/// <summary>
+/// Encoding of a single field value
+/// + fixed codecs always take size bytes and can be read with get() from a checked block
+/// + variable codecs take between size and max_size bytes and are read with read()
+/// + raw codecs put the value on the wire exactly as it is in memory on little endian hosts
+/// put returns the number of bytes written, read returns false on truncated or invalid data
+/// </summary>
+template<typename V, typename Enable = void>
+struct Wire_codec;
+
+/// <summary>
+/// Little endian integers
+/// </summary>
+template<typename V>
+struct Wire_codec<V, typename std::enable_if<std::is_integral<V>::value>::type> {
+    typedef typename std::make_unsigned<V>::type U;
+
+    static constexpr bool fixed = true;
+    static constexpr bool raw = true;
+    static constexpr uint32_t size = sizeof(V);
+    static constexpr uint32_t max_size = sizeof(V);
+
+    static uint32_t encoded_size(const V&) { return size; }
+
+    // the host order is the wire order on little endian hosts, big endian hosts go byte by byte
+    static uint32_t put(uint8_t* out, const V& v) {
+#if WIRE_HOST_LITTLE_ENDIAN
+        memcpy(out, &v, sizeof(V));
+#else
+        U u = (U)v;
+
+        for (uint32_t i = 0; i < sizeof(V); ++i) {
+            out[i] = (uint8_t)(u >> (8 * i));
+        }
+#endif
+        return size;
+    }
+
+    static void get(const uint8_t* in, V& v) {
+#if WIRE_HOST_LITTLE_ENDIAN
+        memcpy(&v, in, sizeof(V));
+#else
+        U u = 0;
+
+        for (uint32_t i = 0; i < sizeof(V); ++i) {
+            u |= (U)((U)in[i] << (8 * i));
+        }
+
+        v = (V)u;
+#endif
+    }
+
+    static bool read(Packet_reader& reader, V& v) {
+        const uint8_t* in = reader.bytes(size);
+
+        if (in == NULL) {
+            return false;
+        }
+
+        get(in, v);
+
+        return true;
+    }
+
+    static bool is_zero(const V& v) {
+        return v == V();
+    }
+};
+
+/// <summary>
+/// IEEE floats, sent as their little endian bit pattern
+/// </summary>
+template<typename V>
+struct Wire_codec<V, typename std::enable_if<std::is_floating_point<V>::value>::type> {
+    typedef typename std::conditional<sizeof(V) == 4, uint32_t, uint64_t>::type Bits;
+
+    static constexpr bool fixed = true;
+    static constexpr bool raw = true;
+    static constexpr uint32_t size = sizeof(V);
+    static constexpr uint32_t max_size = sizeof(V);
+
+    static uint32_t encoded_size(const V&) { return size; }
+
+    static uint32_t put(uint8_t* out, const V& v) {
+        Bits bits;
+        memcpy(&bits, &v, sizeof(V));
+
+        return Wire_codec<Bits>::put(out, bits);
+    }
+
+    static void get(const uint8_t* in, V& v) {
+        Bits bits;
+        Wire_codec<Bits>::get(in, bits);
+        memcpy(&v, &bits, sizeof(V));
+    }
+
+    static bool read(Packet_reader& reader, V& v) {
+        const uint8_t* in = reader.bytes(size);
+
+        if (in == NULL) {
+            return false;
+        }
+
+        get(in, v);
+
+        return true;
+    }
+
+    static bool is_zero(const V& v) {
+        return v == V();
+    }
+};
+
+/// <summary>
+/// Fixed size arrays, every element is sent
+/// </summary>
+template<typename V, size_t N>
+struct Wire_codec<V[N], void> {
+    static constexpr bool fixed = true;
+    static constexpr bool raw = true;
+    static constexpr uint32_t size = Wire_codec<V>::size * N;
+    static constexpr uint32_t max_size = size;
+
+    static uint32_t encoded_size(const V (&)[N]) { return size; }
+
+    static uint32_t put(uint8_t* out, const V (&v)[N]) {
+        if (sizeof(V) == 1) {
+            memcpy(out, v, N);
+            return size;
+        }
+
+        for (size_t i = 0; i < N; ++i) {
+            Wire_codec<V>::put(out + i * sizeof(V), v[i]);
+        }
+
+        return size;
+    }
+
+    static void get(const uint8_t* in, V (&v)[N]) {
+        if (sizeof(V) == 1) {
+            memcpy(v, in, N);
+            return;
+        }
+
+        for (size_t i = 0; i < N; ++i) {
+            Wire_codec<V>::get(in + i * sizeof(V), v[i]);
+        }
+    }
+
+    static bool read(Packet_reader& reader, V (&v)[N]) {
+        const uint8_t* in = reader.bytes(size);
+
+        if (in == NULL) {
+            return false;
+        }
+
+        get(in, v);
+
+        return true;
+    }
+
+    static bool is_zero(const V (&v)[N]) {
+        for (size_t i = 0; i < N; ++i) {
+            if (!Wire_codec<V>::is_zero(v[i])) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+};
+
+constexpr uint32_t wire_varint_max_size(uint64_t max_value) {
+    return max_value < 0x80 ? 1 : 1 + wire_varint_max_size(max_value >> 7);
+}
+
+inline uint32_t wire_varint_size(uint64_t v) {
+    uint32_t size = 1;
+
+    while (v >= 0x80) {
+        v >>= 7;
+        size++;
+    }
+
+    return size;
+}
+
+/// <summary>
+/// LEB128, 7 bits per byte with the high bit set on every byte but the last
+/// </summary>
+inline uint32_t wire_put_varint(uint8_t* out, uint64_t v) {
+    uint32_t size = 0;
+
+    while (v >= 0x80) {
+        out[size++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+
+    out[size++] = (uint8_t)v;
+
+    return size;
+}
+
+/// <summary>
+/// Reads a varint that must fit in max_value
+/// fails the reader on truncated data, on values that dont fit and on overlong encodings
+/// </summary>
+inline bool wire_read_varint(Packet_reader& reader, uint64_t max_value, uint64_t& v) {
+    const uint8_t* in = reader.current();
+    uint32_t max_size = wire_varint_max_size(max_value);
+    uint32_t len = reader.remaining() < max_size ? reader.remaining() : max_size;
+
+    v = 0;
+
+    for (uint32_t i = 0; i < len; ++i) {
+        v |= (uint64_t)(in[i] & 0x7f) << (7 * i);
+
+        if ((in[i] & 0x80) == 0) {
+            // a zero last byte means the sender padded the value, there is only one valid encoding
+            // the tenth byte of a 64 bit value only has one bit left
+            if ((in[i] == 0 && i > 0) || (i == 9 && in[i] > 1) || v > max_value) {
+                break;
+            }
+
+            return reader.skip(i + 1);
+        }
+    }
+
+    reader.fail();
+
+    return false;
+}
+
+/// <summary>
+/// Unsigned integers as varints, for ids and counts that are usually small
+/// </summary>
+template<typename V>
+struct Wire_varint {
+    static_assert(std::is_integral<V>::value && std::is_unsigned<V>::value, "use Wire_zigzag for signed values");
+
+    static constexpr bool fixed = false;
+    static constexpr bool raw = false;
+    static constexpr uint32_t size = 1;
+    static constexpr uint32_t max_size = wire_varint_max_size((V)~(V)0);
+
+    static uint32_t encoded_size(const V& v) { return wire_varint_size(v); }
+
+    static uint32_t put(uint8_t* out, const V& v) {
+        return wire_put_varint(out, v);
+    }
+
+    static bool read(Packet_reader& reader, V& v) {
+        uint64_t value;
+
+        if (!wire_read_varint(reader, (V)~(V)0, value)) {
+            return false;
+        }
+
+        v = (V)value;
+
+        return true;
+    }
+
+    static bool is_zero(const V& v) {
+        return v == 0;
+    }
+};
+
+/// <summary>
+/// Signed integers as zigzag varints, small negative values stay small
+/// 0 -> 0, -1 -> 1, 1 -> 2, -2 -> 3 ...
+/// </summary>
+template<typename V>
+struct Wire_zigzag {
+    static_assert(std::is_integral<V>::value && std::is_signed<V>::value, "use Wire_varint for unsigned values");
+
+    typedef typename std::make_unsigned<V>::type U;
+
+    static constexpr bool fixed = false;
+    static constexpr bool raw = false;
+    static constexpr uint32_t size = 1;
+    static constexpr uint32_t max_size = Wire_varint<U>::max_size;
+
+    static U encode(V v) {
+        return (U)((U)v << 1) ^ (U)(v < 0 ? ~(U)0 : 0);
+    }
+
+    static V decode(U u) {
+        return (V)((u >> 1) ^ (U)(0 - (u & 1)));
+    }
+
+    static uint32_t encoded_size(const V& v) { return wire_varint_size(encode(v)); }
+
+    static uint32_t put(uint8_t* out, const V& v) {
+        return wire_put_varint(out, encode(v));
+    }
+
+    static bool read(Packet_reader& reader, V& v) {
+        U u;
+
+        if (!Wire_varint<U>::read(reader, u)) {
+            return false;
+        }
+
+        v = decode(u);
+
+        return true;
+    }
+
+    static bool is_zero(const V& v) {
+        return v == 0;
+    }
+};
+
+/// <summary>
+/// A NUL terminated char[N] as a varint length and the characters
+/// the receiver always gets a terminated string with the rest of the buffer zeroed,
+/// a length that doesnt leave room for the terminator is invalid
+/// </summary>
+template<typename A>
+struct Wire_string;
+
+template<size_t N>
+struct Wire_string<char[N]> {
+    static_assert(N > 0, "the string needs room for its terminator");
+
+    static constexpr bool fixed = false;
+    static constexpr bool raw = false;
+    static constexpr uint32_t size = 1;
+    static constexpr uint32_t max_size = wire_varint_max_size(N - 1) + N - 1;
+
+    static uint32_t length(const char (&v)[N]) {
+        const char* end = (const char*)memchr(v, 0, N - 1);
+
+        return end != NULL ? (uint32_t)(end - v) : (uint32_t)(N - 1);
+    }
+
+    static uint32_t encoded_size(const char (&v)[N]) {
+        uint32_t len = length(v);
+
+        return wire_varint_size(len) + len;
+    }
+
+    static uint32_t put(uint8_t* out, const char (&v)[N]) {
+        uint32_t len = length(v);
+        uint32_t size = wire_put_varint(out, len);
+
+        memcpy(out + size, v, len);
+
+        return size + len;
+    }
+
+    static bool read(Packet_reader& reader, char (&v)[N]) {
+        uint64_t len;
+
+        if (!wire_read_varint(reader, N - 1, len)) {
+            return false;
+        }
+
+        const uint8_t* in = reader.bytes((uint32_t)len);
+
+        if (in == NULL) {
+            return false;
+        }
+
+        memcpy(v, in, (size_t)len);
+        memset(v + len, 0, N - (size_t)len);
+
+        return true;
+    }
+
+    static bool is_zero(const char (&v)[N]) {
+        return v[0] == 0;
+    }
+};
+
+/// <summary>
+/// An unsigned array as a varint count and varint elements, trailing zeros are left out
+/// for arrays that are mostly empty or hold small values, like the avatar parts
+/// </summary>
+template<typename A>
+struct Wire_packed;
+
+template<typename V, size_t N>
+struct Wire_packed<V[N]> {
+    static constexpr bool fixed = false;
+    static constexpr bool raw = false;
+    static constexpr uint32_t size = 1;
+    static constexpr uint32_t max_size = wire_varint_max_size(N) + N * Wire_varint<V>::max_size;
+
+    static uint32_t count(const V (&v)[N]) {
+        uint32_t count = N;
+
+        while (count > 0 && v[count - 1] == 0) {
+            count--;
+        }
+
+        return count;
+    }
+
+    static uint32_t encoded_size(const V (&v)[N]) {
+        uint32_t num = count(v);
+        uint32_t size = wire_varint_size(num);
+
+        for (uint32_t i = 0; i < num; ++i) {
+            size += wire_varint_size(v[i]);
+        }
+
+        return size;
+    }
+
+    static uint32_t put(uint8_t* out, const V (&v)[N]) {
+        uint32_t num = count(v);
+        uint32_t size = wire_put_varint(out, num);
+
+        for (uint32_t i = 0; i < num; ++i) {
+            size += wire_put_varint(out + size, v[i]);
+        }
+
+        return size;
+    }
+
+    static bool read(Packet_reader& reader, V (&v)[N]) {
+        uint64_t num;
+
+        if (!wire_read_varint(reader, N, num)) {
+            return false;
+        }
+
+        for (uint32_t i = 0; i < (uint32_t)num; ++i) {
+            if (!Wire_varint<V>::read(reader, v[i])) {
+                return false;
+            }
+        }
+
+        for (size_t i = (size_t)num; i < N; ++i) {
+            v[i] = 0;
+        }
+
+        return true;
+    }
+
+    static bool is_zero(const V (&v)[N]) {
+        return count(v) == 0;
+    }
+};
+
+/// <summary>
+/// One field of a message schema
+/// + Since is the message version that added the field, older versions dont have it on the wire
+/// + Until is the last message version that has the field, a field whose encoding changed is
+///   listed twice, the old encoding until the version before and the new one since it
+/// + Optional fields are only written when they arent zero, a presence mask after the
+///   required fields says which ones follow
+/// + Codec is how the value is encoded, the plain little endian Wire_codec by default
+/// </summary>
+template<typename T, typename V, V T::*Member, uint32_t Offset, uint8_t Since, bool Optional, typename Codec = Wire_codec<V>, uint8_t Until = 0xff>
+struct Wire_field {
+    static constexpr uint32_t size = Codec::size;
+    static constexpr uint32_t max_size = Codec::max_size;
+    static constexpr bool fixed = Codec::fixed;
+    static constexpr bool raw = Codec::raw && Codec::size == sizeof(V);
+    static constexpr uint32_t offset = Offset;
+    static constexpr uint8_t since = Since;
+    static constexpr uint8_t until = Until;
+    static constexpr bool optional = Optional;
+
+    static uint32_t encoded_size(const T& msg) {
+        V v;
+        load(msg, v);
+
+        return Codec::encoded_size(v);
+    }
+
+    static uint32_t put(uint8_t* out, const T& msg) {
+        V v;
+        load(msg, v);
+
+        return Codec::put(out, v);
+    }
+
+    // only for fixed fields, from a block that was bounds checked for all of them
+    static void get(const uint8_t* in, T& msg) {
+        get(in, msg, std::integral_constant<bool, Codec::fixed>());
+    }
+
+    static bool read(Packet_reader& reader, T& msg) {
+        V v;
+
+        if (!Codec::read(reader, v)) {
+            return false;
+        }
+
+        store(msg, v);
+
+        return true;
+    }
+
+    static void clear(T& msg) {
+        memset((uint8_t*)&msg + Offset, 0, sizeof(V));
+    }
+
+    static bool is_zero(const T& msg) {
+        V v;
+        load(msg, v);
+
+        return Codec::is_zero(v);
+    }
+
+private:
+    // the messages are packed, a reference to a member can be unaligned,
+    // so the value goes through a local, the copies are optimized away
+    static void load(const T& msg, V& v) {
+        memcpy(&v, (const uint8_t*)&msg + Offset, sizeof(V));
+    }
+
+    static void store(T& msg, const V& v) {
+        memcpy((uint8_t*)&msg + Offset, &v, sizeof(V));
+    }
+
+    static void get(const uint8_t* in, T& msg, std::true_type) {
+        V v;
+        Codec::get(in, v);
+        store(msg, v);
+    }
+
+    static void get(const uint8_t*, T&, std::false_type) {}
+};
+
+#define WIRE_FIELD_CODEC(T, member, codec, version, optional) Wire_field<T, decltype(T::member), &T::member, offsetof(T, member), version, optional, codec>
+#define WIRE_FIELD_RANGE(T, member, codec, since, until) Wire_field<T, decltype(T::member), &T::member, offsetof(T, member), since, false, codec, until>
+
+#define WIRE_FIELD(T, member) WIRE_FIELD_CODEC(T, member, Wire_codec<decltype(T::member)>, 1, false)
+#define WIRE_FIELD_SINCE(T, member, version) WIRE_FIELD_CODEC(T, member, Wire_codec<decltype(T::member)>, version, false)
+#define WIRE_OPTIONAL(T, member, version) WIRE_FIELD_CODEC(T, member, Wire_codec<decltype(T::member)>, version, true)
+#define WIRE_FIELD_UNTIL(T, member, version) WIRE_FIELD_RANGE(T, member, Wire_codec<decltype(T::member)>, 1, version)
+
+// compact fields, for messages where most of a fixed buffer is usually empty
+#define WIRE_VARINT(T, member, version) WIRE_FIELD_CODEC(T, member, Wire_varint<decltype(T::member)>, version, false)
+#define WIRE_ZIGZAG(T, member, version) WIRE_FIELD_CODEC(T, member, Wire_zigzag<decltype(T::member)>, version, false)
+#define WIRE_STRING(T, member, version) WIRE_FIELD_CODEC(T, member, Wire_string<decltype(T::member)>, version, false)
+#define WIRE_PACKED(T, member, version) WIRE_FIELD_CODEC(T, member, Wire_packed<decltype(T::member)>, version, false)
+
+/// <summary>
+/// Compile time walk over the fields of a schema, everything is inlined into straight line code
+/// </summary>
+template<typename T, typename... Fields>
+struct Wire_fields;
+
+template<typename T>
+struct Wire_fields<T> {
+    static constexpr uint32_t required_size(uint8_t) { return 0; }
+    static constexpr uint32_t required_max_size(uint8_t) { return 0; }
+    static constexpr uint32_t optional_size(uint8_t) { return 0; }
+    static constexpr uint32_t num_optional(uint8_t) { return 0; }
+    static constexpr bool fixed(uint8_t) { return true; }
+    static constexpr bool contiguous(uint32_t offset, uint8_t) { return offset == sizeof(T); }
+
+    static uint32_t encoded_required_size(const T&, uint8_t) { return 0; }
+    static uint32_t present_size(const T&, uint8_t) { return 0; }
+    static uint32_t put_required(uint8_t*, const T&, uint8_t) { return 0; }
+    static void clear(T&) {}
+    static void get_required(const uint8_t*, T&, uint8_t) {}
+    static bool read_required(Packet_reader&, T&, uint8_t) { return true; }
+    static uint32_t put_optional(uint8_t*, const T&, uint8_t, uint8_t&, uint32_t) { return 0; }
+    static bool get_optional(Packet_reader&, T&, uint8_t, uint8_t, uint32_t) { return true; }
+};
+
+template<typename T, typename F, typename... Rest>
+struct Wire_fields<T, F, Rest...> {
+    typedef Wire_fields<T, Rest...> Next;
+
+    static constexpr bool on_wire(uint8_t version) {
+        return F::since <= version && version <= F::until;
+    }
+
+    static constexpr bool required(uint8_t version) {
+        return on_wire(version) && !F::optional;
+    }
+
+    static constexpr uint32_t required_size(uint8_t version) {
+        return (required(version) ? F::size : 0) + Next::required_size(version);
+    }
+
+    static constexpr uint32_t required_max_size(uint8_t version) {
+        return (required(version) ? F::max_size : 0) + Next::required_max_size(version);
+    }
+
+    static constexpr uint32_t optional_size(uint8_t version) {
+        return (on_wire(version) && F::optional ? F::max_size : 0) + Next::optional_size(version);
+    }
+
+    static constexpr uint32_t num_optional(uint8_t version) {
+        return (on_wire(version) && F::optional ? 1 : 0) + Next::num_optional(version);
+    }
+
+    // every required field has a fixed size, they can be read from one bounds checked block
+    static constexpr bool fixed(uint8_t version) {
+        return (!required(version) || F::fixed) && Next::fixed(version);
+    }
+
+    // the fields on the wire are laid out exactly like the struct
+    static constexpr bool contiguous(uint32_t offset, uint8_t version) {
+        return !on_wire(version) ? Next::contiguous(offset, version) :
+            required(version) && F::raw && F::offset == offset && Next::contiguous(offset + F::size, version);
+    }
+
+    static uint32_t encoded_required_size(const T& msg, uint8_t version) {
+        uint32_t size = required(version) ? F::encoded_size(msg) : 0;
+
+        return size + Next::encoded_required_size(msg, version);
+    }
+
+    static uint32_t present_size(const T& msg, uint8_t version) {
+        uint32_t size = on_wire(version) && F::optional && !F::is_zero(msg) ? F::encoded_size(msg) : 0;
+
+        return size + Next::present_size(msg, version);
+    }
+
+    static uint32_t put_required(uint8_t* out, const T& msg, uint8_t version) {
+        uint32_t size = required(version) ? F::put(out, msg) : 0;
+
+        return size + Next::put_required(out + size, msg, version);
+    }
+
+    // zeroes every field before a decode, the ones the sender doesnt have stay zero,
+    // a field listed for two versions is only cleared here and not over the value just read
+    static void clear(T& msg) {
+        F::clear(msg);
+        Next::clear(msg);
+    }
+
+    static void get_required(const uint8_t* in, T& msg, uint8_t version) {
+        if (required(version)) {
+            F::get(in, msg);
+            in += F::size;
+        }
+
+        Next::get_required(in, msg, version);
+    }
+
+    // the same as get_required for layouts with variable fields, every field checks its own bounds
+    static bool read_required(Packet_reader& reader, T& msg, uint8_t version) {
+        if (required(version) && !F::read(reader, msg)) {
+            return false;
+        }
+
+        return Next::read_required(reader, msg, version);
+    }
+
+    static uint32_t put_optional(uint8_t* out, const T& msg, uint8_t version, uint8_t& mask, uint32_t bit) {
+        if (!on_wire(version) || !F::optional) {
+            return Next::put_optional(out, msg, version, mask, bit);
+        }
+
+        uint32_t size = 0;
+
+        if (!F::is_zero(msg)) {
+            size = F::put(out, msg);
+            mask |= (uint8_t)(1 << bit);
+        }
+
+        return size + Next::put_optional(out + size, msg, version, mask, bit + 1);
+    }
+
+    static bool get_optional(Packet_reader& reader, T& msg, uint8_t version, uint8_t mask, uint32_t bit) {
+        if (!on_wire(version) || !F::optional) {
+            return Next::get_optional(reader, msg, version, mask, bit);
+        }
+
+        if ((mask & (1 << bit)) && !F::read(reader, msg)) {
+            return false;
+        }
+
+        return Next::get_optional(reader, msg, version, mask, bit + 1);
+    }
+};
+
+/// <summary>
+/// The schema of a message, declared with WIRE_SCHEMA
+/// </summary>
+template<typename T>
+struct Wire_schema;
+
+/// <summary>
+/// Declares the wire layout of T at version, fields are written in the order they are listed
+/// new fields are added at the end with WIRE_FIELD_SINCE or WIRE_OPTIONAL and a bumped version,
+/// a field that changes its encoding keeps the old one with an until version
+/// </summary>
+#define WIRE_SCHEMA(T, version_, ...) \
+    template<> struct Wire_schema<T> { \
+        static constexpr uint8_t version = version_; \
+        typedef Wire_fields<T, __VA_ARGS__> fields; \
+    }
+
+/// <summary>
+/// The smallest size of T on the wire, all optional fields left out
+/// </summary>
+template<typename T>
+constexpr uint32_t wire_min_size(uint8_t version = Wire_schema<T>::version) {
+    return Wire_schema<T>::fields::required_size(version) + (Wire_schema<T>::fields::num_optional(version) > 0 ? 1 : 0);
+}
+
+/// <summary>
+/// The largest size of T on the wire, for sizing encode buffers
+/// </summary>
+template<typename T>
+constexpr uint32_t wire_max_size(uint8_t version = Wire_schema<T>::version) {
+    return Wire_schema<T>::fields::required_max_size(version) + (Wire_schema<T>::fields::num_optional(version) > 0 ? 1 : 0) +
+        Wire_schema<T>::fields::optional_size(version);
+}
+
+/// <summary>
+/// The smallest size of T on the wire at any of its versions, the bounds check before a decode
+/// </summary>
+template<typename T>
+constexpr uint32_t wire_smallest_size() {
+    uint32_t size = wire_min_size<T>(1);
+
+    for (uint8_t version = 2; version <= Wire_schema<T>::version; ++version) {
+        size = wire_min_size<T>(version) < size ? wire_min_size<T>(version) : size;
+    }
+
+    return size;
+}
+
+/// <summary>
+/// The largest size of T on the wire at any of its versions, fits the encode of every version
+/// </summary>
+template<typename T>
+constexpr uint32_t wire_largest_size() {
+    uint32_t size = wire_max_size<T>(1);
+
+    for (uint8_t version = 2; version <= Wire_schema<T>::version; ++version) {
+        size = wire_max_size<T>(version) > size ? wire_max_size<T>(version) : size;
+    }
+
+    return size;
+}
+
+/// <summary>
+/// True when the current version of T can be viewed in place instead of decoded
+/// </summary>
+template<typename T>
+constexpr bool wire_in_place() {
+    return WIRE_HOST_LITTLE_ENDIAN && Wire_schema<T>::fields::contiguous(0, Wire_schema<T>::version);
+}
+
+template<typename T>
+uint32_t wire_size(const T& msg, uint8_t version = Wire_schema<T>::version) {
+    typedef typename Wire_schema<T>::fields Fields;
+
+    if (Fields::fixed(version) && Fields::num_optional(version) == 0) {
+        return Fields::required_size(version);
+    }
+
+    return Fields::encoded_required_size(msg, version) + (Fields::num_optional(version) > 0 ? 1 : 0) + Fields::present_size(msg, version);
+}
+
+/// <summary>
+/// Writes msg to out, which must have room for wire_size(msg) bytes, wire_max_size<T>() always fits
+/// returns the number of bytes written
+/// </summary>
+template<typename T>
+uint32_t wire_encode(const T& msg, uint8_t* out, uint8_t version = Wire_schema<T>::version) {
+    typedef typename Wire_schema<T>::fields Fields;
+
+    static_assert(Fields::num_optional(Wire_schema<T>::version) <= WIRE_MAX_OPTIONAL_FIELDS, "the presence mask is a single byte");
+
+    uint32_t size = Fields::put_required(out, msg, version);
+
+    if (Fields::num_optional(version) == 0) {
+        return size;
+    }
+
+    uint8_t mask = 0;
+    uint32_t optional = Fields::put_optional(out + size + 1, msg, version, mask, 0);
+
+    out[size] = mask;
+
+    return size + 1 + optional;
+}
+
+/// <summary>
+/// Writes msg at off, growing data if needed
+/// returns the number of bytes written
+/// </summary>
+template<typename T>
+uint32_t wire_encode(const T& msg, std::vector<uint8_t>& data, uint32_t off, uint8_t version = Wire_schema<T>::version) {
+    uint32_t size = wire_size(msg, version);
+
+    if (data.size() < off + size) {
+        data.resize(off + size);
+    }
+
+    return wire_encode(msg, &data[off], version);
+}
+
+/// <summary>
+/// Reads the next message from the reader into msg
+/// returns false if the message is truncated or a variable field is invalid
+/// </summary>
+template<typename T>
+bool wire_decode(Packet_reader& reader, T& msg, uint8_t version = Wire_schema<T>::version) {
+    typedef typename Wire_schema<T>::fields Fields;
+
+    // optional, or not on the wire at the version of the sender,
+    // get_optional fills in the optional fields that are present
+    Fields::clear(msg);
+
+    if (Fields::fixed(version)) {
+        const uint8_t* in = reader.bytes(Fields::required_size(version));
+
+        if (in == NULL) {
+            return false;
+        }
+
+        Fields::get_required(in, msg, version);
+    }
+    else if (!Fields::read_required(reader, msg, version)) {
+        return false;
+    }
+
+    if (Fields::num_optional(version) == 0) {
+        return true;
+    }
+
+    const uint8_t* mask = reader.bytes(1);
+
+    return mask != NULL && Fields::get_optional(reader, msg, version, *mask, 0);
+}
+
+template<typename T>
+const T* wire_view_current(Packet_reader& reader, T&, std::true_type) {
+    return reader.view<T>();
+}
+
+// the layout differs from the wire, these messages have no NET_WIRE_MESSAGE to be viewed with
+template<typename T>
+const T* wire_view_current(Packet_reader& reader, T& storage, std::false_type) {
+    return wire_decode(reader, storage) ? &storage : NULL;
+}
+
+/// <summary>
+/// The next message in the reader, sent at version
+/// in place when it is the current layout and the struct matches it, otherwise decoded into storage
+/// returns NULL if the message is truncated
+/// </summary>
+template<typename T>
+const T* wire_view(Packet_reader& reader, T& storage, uint8_t version = Wire_schema<T>::version) {
+    if (version < Wire_schema<T>::version) {
+        return wire_decode(reader, storage, version) ? &storage : NULL;
+    }
+
+    return wire_view_current(reader, storage, std::integral_constant<bool, wire_in_place<T>()>());
+}
@@ -2,24 +2,128 @@
 
 #include "net_session_rules.h"
 
-World_instance::World_instance() : _time(0) {
+World_instance::World_instance() : interactions_rejected(0), _tick(0), _ticks_per_second(WORLD_TICKS_PER_SECOND) {
     data_transforms.num_items = 0;
     data_transforms.num_players = 0;
 
-    scene.on_item_states_updated = [&](uint16_t id, uint8_t states) {
-        _on_item_states_updated(id, states);
-    };
+    interest.set_bounds(codec.bounds_min, codec.bounds_max);
 }
 
 World_instance::~World_instance() {
 
 }
 
-void World_instance::on_player_pos(const Net_pos& pos) {
-    
-    _players_by_index[pos.player_index]->pos = pos.to_vec3();
-    _players_by_index[pos.player_index]->rot = pos.to_quat();
+void World_instance::on_player_input(const Net_pos& pos) {
+    // the tick is sent as its low 16 bits, it is taken as the closest one to the world tick
+    int64_t tick = (int64_t)_tick + (int16_t)(pos.tick - (uint16_t)_tick);
 
+    if (tick < 0) {
+        inputs.counters.late++;
+        return;
+    }
+
+    inputs.push(pos.player_index, (uint32_t)tick, pos, _tick);
+}
+
+void World_instance::step(float max_speed) {
+    uint32_t timestamp = tick_timestamp(_tick);
+
+    for (uint32_t i = 0; i < _pending_pos.size(); ++i) {
+        const Net_pos* pos = inputs.pop((uint8_t)i, _tick);
+
+        if (pos == nullptr) {
+            continue;
+        }
+
+        _pending_pos[i] = *pos;
+
+        movement.push((uint8_t)i, codec.position(pos->transform), timestamp);
+    }
+
+    apply_player_pos(max_speed);
+
+    // the item changes of the tick go through the circuit in one pass
+    update_items();
+
+    _tick++;
+}
+
+void World_instance::set_tick_rate(uint32_t ticks_per_second) {
+    _ticks_per_second = ticks_per_second == 0 ? WORLD_TICKS_PER_SECOND : ticks_per_second;
+}
+
+uint32_t World_instance::tick_timestamp(uint32_t tick) const {
+    return (uint32_t)((uint64_t)tick * 1000 / _ticks_per_second);
+}
+
+void World_instance::apply_player_pos(float max_speed) {
+    movement.validate(max_speed);
+
+    const std::vector<uint8_t>& pending = movement.pending();
+    uint32_t count = (uint32_t)pending.size();
+
+    // the rotations of the tick are decoded in one batch
+    _rot_index.resize(count);
+    _rot_data.resize(count * 3);
+    _rot.resize(count);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const Transform_q& q = _pending_pos[pending[i]].transform;
+
+        _rot_index[i] = q.rot_index;
+        memcpy(&_rot_data[i * 3], q.rot, 3 * sizeof(uint16_t));
+    }
+
+    if (count > 0) {
+        quat_decompress_batch(&_rot_index[0], &_rot_data[0], count, codec.rotation_bits, &_rot[0]);
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        uint8_t index = pending[i];
+        MovementResult result = movement.result(index);
+
+        if (result == MovementResult::Rejected) {
+            continue;
+        }
+
+        Net_pos& pos = _pending_pos[index];
+
+        if (result == MovementResult::Clamped) {
+            codec.quantize_position(movement.position(index), pos.transform);
+        }
+
+        // keeps the quantized data as well so we can forward it without encoding it again
+        Transform_entity* player = _players[index].get();
+
+        player->set_inc_pos(pos, _rot[i], codec);
+
+        history.record(index, movement.timestamp(index), player->pos, player->rot);
+        player_grid.update(index, player->pos);
+    }
+
+    movement.clear();
+}
+
+void World_instance::player_at(uint8_t index, uint32_t timestamp, glm::vec3& pos, glm::quat& rot) const {
+    if (history.sample(index, timestamp, pos, rot)) {
+        return;
+    }
+
+    auto player = _players_by_index.find(index);
+
+    if (player != _players_by_index.end()) {
+        pos = player->second->pos;
+        rot = player->second->rot;
+    }
+}
+
+void World_instance::rewind(uint32_t timestamp, std::vector<glm::vec3>& pos, std::vector<glm::quat>& rot) const {
+    pos.resize(_players.size());
+    rot.resize(_players.size());
+
+    for (uint32_t i = 0; i < _players.size(); ++i) {
+        player_at((uint8_t)i, timestamp, pos[i], rot[i]);
+    }
 }
 
 /// <summary>
@@ -28,7 +132,33 @@ void World_instance::on_player_pos(const Net_pos& pos) {
 /// </summary>
 void World_instance::start() {
     data_transforms.num_players = _players.size();
-    data_transforms.player_transforms.resize((size_t)data_transforms.num_players * (3 + 7));
+    data_transforms.player_transforms.resize(data_transforms.num_players);
+
+    // a copy of the states the level starts in, the graph is shared
+    scene.reset();
+
+    item_changes.resize(scene.num_items());
+
+    history.reset((uint32_t)_players.size());
+    movement.reset((uint32_t)_players.size());
+    _pending_pos.resize(_players.size());
+
+    _tick = 0;
+    inputs.reset((uint32_t)_players.size());
+
+    player_grid.reset((uint32_t)_players.size());
+    item_grid.reset(scene.num_items());
+    interactions_rejected = 0;
+
+    for (uint32_t i = 0; i < scene.num_items(); ++i) {
+        const float* pos = scene.level->item((uint16_t)i).pos;
+
+        item_grid.update((uint16_t)i, glm::vec3(pos[0], pos[1], pos[2]));
+    }
+
+    if (scene.num_items() > 0) {
+        memcpy(&item_changes.states[0], scene.circuit.states(), scene.num_items());
+    }
 }
 
 void World_instance::add_player(uint16_t player_id) {
@@ -42,35 +172,85 @@ void World_instance::add_player(uint16_t player_id) {
     _players_by_index[_players.size()-1] = _players[_players.size()-1].get();
 }
 
-void World_instance::update(double delta) {
-    _time += delta;
+void World_instance::clear_players() {
+    _players.clear();
+    _players_by_index.clear();
+
+    data_transforms.num_players = 0;
+    data_transforms.player_transforms.clear();
+}
+
+void World_instance::update_items() {
+    scene.circuit.propagate();
+
+    for (uint16_t index : scene.circuit.changes()) {
+        uint8_t states = scene.states(index);
+
+        item_changes.mark(index, states);
+
+        if (_on_item_states_updated != nullptr) {
+            _on_item_states_updated(scene.id(index), states);
+        }
+    }
+
+    scene.circuit.clear_changes();
 }
 
 double World_instance::get_time() const {
-    return _time;
+    return (double)_tick / _ticks_per_second;
 }
 
 void World_instance::fill_transform() {
-    int packet_size = (sizeof(uint16_t) * 3 + 7);
-    uint32_t offset = 0;
-
-    for (int i = 0; i < _players.size(); ++i) {
-        _players[i]->fill_data(data_transforms.player_transforms, offset);
-        offset += packet_size;
+    for (int i = 0; i < data_transforms.num_players; ++i) {
+        data_transforms.player_transforms[i] = _players[i]->q;
     }
+
+    interest.rebuild(_players);
 }
 
-bool World_instance::set_item_state(const Net_player_set_item_state_request& request, Net_player_set_item_state_response& resp) {
-    
-    
-    if (!scene.set_item_state(request.id, request.state, request.on)) {
+bool World_instance::set_item_state(uint8_t player_index, const Net_player_set_item_state_request& request, Net_player_set_item_state_response& resp) {
+    resp.id = request.id;
+    resp.success = 0;
+
+    uint16_t index = scene.find(request.id);
+
+    if (index == CIRCUIT_NO_ITEM) {
+        return false;
+    }
+
+    // without a known position the player cant be in range
+    if (!player_grid.contains(player_index)) {
+        interactions_rejected++;
+        return false;
+    }
+
+    glm::vec3 d = player_grid.position(player_index) - item_grid.position(index);
+
+    if (glm::dot(d, d) > ITEM_INTERACT_RANGE * ITEM_INTERACT_RANGE) {
+        interactions_rejected++;
+        return false;
+    }
+
+    if (!scene.circuit.set_state(index, request.state, request.on)) {
         return false;
     }
-     return true;
+
+    resp.success = 1;
+
+    return true;
+}
+
+void World_instance::set_level(std::shared_ptr<const Level> level) {
+    if (level != nullptr && level->has_bounds()) {
+        set_level_bounds(level->bounds_min(), level->bounds_max());
+    }
+
+    scene.set_level(std::move(level));
 }
 
-void World_instance::set_item_snapshot_data(uint8_t* data) {
-    //item_states.set_data(data);
+void World_instance::set_level_bounds(const glm::vec3& min, const glm::vec3& max) {
+    codec.set_bounds(min, max);
+    interest.set_bounds(min, max);
 }
 
 void World_instance::set_on_item_states_updated(std::function<void(uint16_t id, uint8_t state)> func) {
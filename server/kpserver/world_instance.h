@@ -9,130 +9,61 @@
 
 #include "trace.h"
 #include "transform_entity.h"
+#include "interest_filter.h"
+#include "item_delta.h"
+#include "transform_history.h"
+#include "movement_validator.h"
+#include "level.h"
+#include "spatial_grid.h"
+#include "input_buffer.h"
 
 #define CHECK_BIT(var,pos) ((var) & (1<<(pos)))
 
-enum class ItemType {
-    Junction = 1,
-    Switch = 2,
-    Openable = 4,
-    Hackable = 8,
-    Breakable = 16,
-    MustBePoweredForActivate = 32
-};
-
-enum class ItemState {
-    Power = 1,
-    Activated = 2,
-    Switch_AND = 4,
-    Switch_OR = 8, // require all incoming to be Activated to emit signal
-};
-
-enum class ItemPrefab {
-    HingedDoor = 0,
-    PoweredHingedDoor,
-    DoubleSlidingDoor,
-    SingleSlidingDoor,
-    PulleySwitch,
-    PathPuzzleSwitch,
-    NumPrefabs
-};
-
-struct Scene_item {
-    static std::vector<Scene_item> prefabs;
-
-    uint16_t    id;
-    uint8_t     types; // CircuitType
-    uint8_t     states; // CircuitState
+#define WORLD_TICKS_PER_SECOND  20      // unless the slave sets its ticks_per_second_internal
+#define WORLD_MAX_CATCHUP_STEPS 4       // ticks stepped in one update when the updates fall behind
 
-    uint16_t    inc[2];
-    uint16_t    out[2];
-
-    Scene_item() : id(0) {
-        types = 0;
-        states = 0;
-        memset(inc, 0, 2 * sizeof(uint16_t));
-        memset(out, 0, 2 * sizeof(uint16_t));
-    }
-};
+#define ITEM_INTERACT_RANGE 4.0f // meters from the item a player can set its state, with slack for the latency
 
+/// <summary>
+/// The items of a session, the level is shared and only the states in the circuit are per session
+/// </summary>
 struct Scene {
-    std::unordered_map<uint16_t, Scene_item*> items_by_id;
+    std::shared_ptr<const Level> level;
 
-    std::vector<std::unique_ptr<Scene_item>> items;
+    // the current states of the items, on top of the graph of the level
+    Circuit circuit;
 
-    Scene() {
-        on_item_states_updated = nullptr;
+    // the states go back to the ones the level starts in
+    void set_level(std::shared_ptr<const Level> new_level) {
+        level = std::move(new_level);
+        reset();
     }
 
-    bool set_item_state(uint16_t id, uint8_t state, uint8_t on) {
-        if (items_by_id.find(id) == items_by_id.end()) {
-            return false;
-        }
-
-        Scene_item* item = items_by_id[id];
-
-        item->states ^= (-on ^ item->states) & (1UL << state);
-
-        // power our outgoing items
-        if (state == (uint8_t)ItemState::Activated) {
-            for (int i = 0; i < 2; ++i) {
-                if (item->out[i] == 0) {
-                    continue;
-                }
-                Scene_item* out_item = items_by_id[item->out[i]];
-
-                if (check_item_in_state_ok(out_item)) {
-                    out_item->states ^= (-1 ^ out_item->states) & (1UL << (uint8_t)ItemState::Power);
-                    on_item_states_updated(out_item->id, out_item->states);
-                }
-            }
+    void reset() {
+        if (level != nullptr) {
+            circuit.reset(&level->graph(), level->initial_states());
         }
-        
-        on_item_states_updated(item->id, item->states);
-
-        return true;
     }
 
-    // perform item check when the connected items has had their state changed
-    bool check_item_in_state_ok(Scene_item* item) {
-        int count = 0;
-        int ok_count = 0;
-
-        for (int i = 0; i < 2; ++i) {
-            if (item->inc[i] == 0) {
-                continue;
-            }
-
-            count++;
+    uint32_t num_items() const { return circuit.num_items(); }
 
-            // check all incoming signals, add to ok_count for each incoming signal activated
-            if (CHECK_BIT(items_by_id[item->inc[i]]->states, (uint8_t)ItemState::Activated)) {
-                ok_count++;
-            }
-        }
+    uint16_t id(uint16_t index) const { return level->item(index).id; }
+    uint8_t types(uint16_t index) const { return level->item(index).types; }
+    uint8_t states(uint16_t index) const { return circuit.get_states(index); }
 
-        // if our state is AND, we require all switches to be activated
-        if (CHECK_BIT(item->states, (uint8_t)ItemState::Switch_AND)) {
-            if (ok_count == count) {
-                return true;
-            }
-            return false;
-        }
+    // the index of the item, CIRCUIT_NO_ITEM if there is none
+    uint16_t find(uint16_t id) const { return level != nullptr ? level->find(id) : (uint16_t)CIRCUIT_NO_ITEM; }
 
-        // if our state is OR, we require ONE switch to be activated
-        if (CHECK_BIT(item->states, (uint8_t)ItemState::Switch_OR)) {
-            if (ok_count > 0) {
-                return true;
-            }
+    // the change goes through the network with the next propagate
+    bool set_item_state(uint16_t id, uint8_t state, uint8_t on) {
+        uint16_t index = find(id);
 
+        if (index == CIRCUIT_NO_ITEM) {
             return false;
         }
 
-        return false;
+        return circuit.set_state(index, state, on);
     }
-
-    std::function<void(uint16_t id, uint8_t states)> on_item_states_updated;
 };
 
 
@@ -150,22 +81,56 @@ struct World_instance {
     // add a player to the world
     void add_player(uint16_t player_id);
 
-    // when player position has been updated
-    void on_player_pos(const Net_pos& pos);
+    // removes every player, before they are added again for a new game
+    void clear_players();
+
+    // when a player input has arrived, it waits in the input buffer for the tick it is stamped with
+    void on_player_input(const Net_pos& pos);
+
+    // validates the positions of the tick against max_speed (m/s) and applies them
+    void apply_player_pos(float max_speed);
+
+    // where the player was at the session timestamp, interpolated from the history
+    // the current transform when there is no history of the player yet
+    void player_at(uint8_t index, uint32_t timestamp, glm::vec3& pos, glm::quat& rot) const;
+
+    // every player at the session timestamp, indexed like _players
+    void rewind(uint32_t timestamp, std::vector<glm::vec3>& pos, std::vector<glm::quat>& rot) const;
 
     void start();
 
-    void update(double delta);
+    // the length of a tick, every tick is stepped the same however the updates fall
+    void set_tick_rate(uint32_t ticks_per_second);
+
+    // the inputs stamped with the next tick are applied and the items updated, then the tick moves on
+    // nothing here depends on when an input arrived, only on which tick it is for
+    void step(float max_speed);
+
+    // the next tick step() runs
+    uint32_t get_tick() const { return _tick; }
+
+    uint32_t get_tick_rate() const { return _ticks_per_second; }
+
+    // ms since the game started
+    uint32_t tick_timestamp(uint32_t tick) const;
+
+    // runs the item state changes of the tick through the circuit and collects what changed
+    void update_items();
 
     double get_time() const;
 
     void fill_transform();
 
-    bool set_item_state(const Net_player_set_item_state_request& request, Net_player_set_item_state_response& resp);
-
-    void set_item_snapshot_data(uint8_t* data);
+    // the player has to be within ITEM_INTERACT_RANGE of the item
+    bool set_item_state(uint8_t player_index, const Net_player_set_item_state_request& request, Net_player_set_item_state_response& resp);
 
     void set_on_item_states_updated(std::function<void(uint16_t id, uint8_t states)> func);
+
+    // every session on the level shares it, the item states start over
+    void set_level(std::shared_ptr<const Level> level);
+
+    // the level decides the position range of the transform quantization and the interest grid
+    void set_level_bounds(const glm::vec3& min, const glm::vec3& max);
     
     // All the entities in the world
     std::unordered_map<uint8_t, Transform_entity*> _players_by_index;
@@ -178,10 +143,43 @@ struct World_instance {
 
     Net_game_transforms_snapshot data_transforms;
 
+    Transform_codec codec;
+
+    Interest_filter interest;
+
     Scene scene;
+
+    // the item states that changed since the last item snapshot
+    Item_changes item_changes;
+
+    // the recent transforms of the players, for checks against what a client saw
+    Transform_history history;
+
+    Movement_validator movement;
+
+    // where the players are, indexed like _players, a player is in it once a position has been applied
+    Spatial_grid player_grid;
+
+    // where the items are, indexed like the items of the level
+    Spatial_grid item_grid;
+
+    // item state requests from too far away, or from a player without a position yet
+    uint64_t interactions_rejected;
+
+    // the jitter buffer of every player
+    Input_buffer inputs;
 private:
 
-    double _time;
+    uint32_t _tick;
+    uint32_t _ticks_per_second;
+
+    // the input of each player for the tick being stepped, indexed like _players
+    std::vector<Net_pos> _pending_pos;
+
+    // scratch for the batch decode of the pending rotations
+    std::vector<uint8_t>    _rot_index;
+    std::vector<uint16_t>   _rot_data;
+    std::vector<glm::quat>  _rot;
 
     std::function<void(uint16_t, uint8_t)> _on_item_states_updated;
 };
\ No newline at end of file